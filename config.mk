@@ -6,15 +6,17 @@ CXX=g++
 CXXFLAGS=\
 	-I$(DEP_DIR)/ \
 	-I$(DEP_DIR)/stb \
+	-I$(DEP_DIR)/octomap/octomap/include \
 	-I$(DEP_DIR)/imgui -I../deps/imgui/examples/example_glfw_opengl3
 
 LIBS=\
-	-L$(BIN_DIR) -lshow \
+	-L$(BIN_DIR) -lshow -lshow_shm \
 	-L$(DEP_DIR)/glfw/build/src -lglfw3 \
 	-L$(DEP_DIR)/assimp/build -lassimp \
 	-L$(DEP_DIR)/glad/ -lglad -ldl \
 	-L$(DEP_DIR)/imgui/ -limgui \
-	-lpthread
+	-L$(DEP_DIR)/octomap/lib -loctomap -loctomath \
+	-lpthread -lrt
 
 AR = ar
 ARFLAGS = rvs
@@ -0,0 +1,316 @@
+#include <chrono>
+
+#include <sys/wait.h>
+
+#include "show.hpp"
+
+static double time_now() {
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration<double>(t).count();
+}
+
+static void bench_report(const char *name,
+                         const size_t nb_items,
+                         const char *unit,
+                         const double elapsed) {
+  printf("%-28s %10zu %-8s %8.3f s  %14.0f %s/s\n",
+         name,
+         nb_items,
+         unit,
+         elapsed,
+         nb_items / elapsed,
+         unit);
+}
+
+/*****************************************************************************
+ *                                 VOXELS
+ ****************************************************************************/
+
+// Rolling terrain, 1024 x 1024 columns filled 4 voxels deep (~4M voxels)
+static void voxmap_fill_terrain(show::voxmap_t &map) {
+  for (int x = 0; x < 1024; x++) {
+    for (int z = 0; z < 1024; z++) {
+      const int h = 32 + 16 * sin(x * 0.02) * cos(z * 0.03);
+      for (int y = h - 4; y < h; y++) {
+        map.set(x, y, z, 1 + (y & 3));
+      }
+    }
+  }
+}
+
+void bench_voxmap_insert() {
+  show::voxmap_t map{0.1};
+  const double t0 = time_now();
+  voxmap_fill_terrain(map);
+  bench_report("voxmap insert", map.nb_voxels, "voxels", time_now() - t0);
+}
+
+void bench_voxmap_remesh() {
+  show::voxmap_t map{0.1};
+  voxmap_fill_terrain(map);
+
+  size_t nb_quads = 0;
+  std::vector<show::voxvertex_t> vertices;
+  const double t0 = time_now();
+  for (const auto &kv : map.chunks) {
+    vertices.clear();
+    map.mesh(*kv.second, vertices);
+    nb_quads += vertices.size() / 4;
+  }
+  const double elapsed = time_now() - t0;
+
+  bench_report("voxmap remesh (chunks)", map.chunks.size(), "chunks", elapsed);
+  bench_report("voxmap remesh (voxels)", map.nb_voxels, "voxels", elapsed);
+  printf("%-28s %10zu quads\n", "voxmap remesh output", nb_quads);
+}
+
+/*****************************************************************************
+ *                                  MESH
+ ****************************************************************************/
+
+// Weld and cache optimize every nanosuit sub-mesh as loaded by Assimp
+void bench_mesh_optimize() {
+  Assimp::Importer importer;
+  const auto options =
+      aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+  const char *path = "assets/nanosuit/nanosuit.obj";
+  const aiScene *scene = importer.ReadFile(path, options);
+  if (scene == nullptr) {
+    printf("Failed to load [%s]!\n", path);
+    return;
+  }
+
+  show::glmesh_optimize_stats_t total;
+  double elapsed = 0.0;
+  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+    std::vector<show::glvertex_t> vertices;
+    std::vector<unsigned int> indices;
+    show::glmodel_mesh_geometry(scene->mMeshes[i], vertices, indices);
+
+    const double t0 = time_now();
+    const auto stats = show::glmesh_optimize(vertices, indices);
+    elapsed += time_now() - t0;
+
+    total.nb_triangles += stats.nb_triangles;
+    total.nb_vertices_before += stats.nb_vertices_before;
+    total.nb_vertices_after += stats.nb_vertices_after;
+    total.acmr_before += stats.acmr_before * stats.nb_triangles;
+    total.acmr_after += stats.acmr_after * stats.nb_triangles;
+  }
+
+  bench_report("mesh optimize", total.nb_triangles, "tris", elapsed);
+  printf("%-28s %10zu -> %zu\n",
+         "mesh optimize vertices",
+         total.nb_vertices_before,
+         total.nb_vertices_after);
+  printf("%-28s %10.3f -> %.3f\n",
+         "mesh optimize ACMR",
+         total.acmr_before / total.nb_triangles,
+         total.acmr_after / total.nb_triangles);
+}
+
+void bench_model_stage() {
+  Assimp::Importer importer;
+  const auto options =
+      aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+  const char *path = "assets/nanosuit/nanosuit.obj";
+  const aiScene *scene = importer.ReadFile(path, options);
+  if (scene == nullptr) {
+    printf("Failed to load [%s]!\n", path);
+    return;
+  }
+
+  // CPU stage of glmodel_load(), on one thread and on the pool
+  const show::glmodel_options_t model_options;
+  const show::glarena_t arena;
+  std::vector<aiMesh *> meshes;
+  show::glmodel_collect_meshes(scene->mRootNode, scene, meshes);
+
+  std::vector<show::glmodel_staging_t> serial(meshes.size());
+  double t0 = time_now();
+  for (size_t i = 0; i < meshes.size(); i++) {
+    serial[i].mesh = meshes[i];
+    show::glmodel_stage_mesh(model_options, arena, serial[i]);
+  }
+  const double serial_elapsed = time_now() - t0;
+  bench_report("model stage serial", meshes.size(), "meshes", serial_elapsed);
+
+  std::vector<show::glmodel_staging_t> parallel(meshes.size());
+  t0 = time_now();
+  show::thread_pool().parallel_for(meshes.size(), [&](const size_t i) {
+    parallel[i].mesh = meshes[i];
+    show::glmodel_stage_mesh(model_options, arena, parallel[i]);
+  });
+  const double pool_elapsed = time_now() - t0;
+  bench_report("model stage pool", meshes.size(), "meshes", pool_elapsed);
+}
+
+/*****************************************************************************
+ *                                 POINTS
+ ****************************************************************************/
+
+// Streams 1M points per frame through `glpoints_t`, requires a display
+void bench_glpoints_stream() {
+  show::gui_t gui{"bench_show", 640, 480};
+  const size_t nb_points = 1000000;
+  const int nb_frames = 100;
+
+  std::vector<float> xyz(nb_points * 3);
+  std::vector<uint8_t> rgba(nb_points * 4, 255);
+  std::vector<float> intensity(nb_points, 1.0f);
+  std::vector<show::glpoint_t> points(nb_points);
+  for (size_t i = 0; i < nb_points; i++) {
+    xyz[i * 3 + 0] = (i % 1000) * 0.01f;
+    xyz[i * 3 + 1] = 0.0f;
+    xyz[i * 3 + 2] = (i / 1000) * 0.01f;
+    points[i].pos = {xyz[i * 3 + 0], xyz[i * 3 + 1], xyz[i * 3 + 2]};
+    memset(points[i].color, 255, 4);
+    points[i].intensity = 1.0f;
+  }
+
+  {
+    show::glpoints_t cloud{nb_points};
+    const double t0 = time_now();
+    for (int i = 0; i < nb_frames; i++) {
+      cloud.set(points.data(), nb_points);
+      cloud.draw(gui.camera);
+    }
+    glFinish();
+    bench_report("glpoints set (interleaved)",
+                 nb_points * nb_frames,
+                 "points",
+                 time_now() - t0);
+    cloud.print_stats();
+  }
+
+  {
+    show::glpoints_t cloud{nb_points};
+    const double t0 = time_now();
+    for (int i = 0; i < nb_frames; i++) {
+      cloud.set(xyz.data(), rgba.data(), intensity.data(), nb_points);
+      cloud.draw(gui.camera);
+    }
+    glFinish();
+    bench_report("glpoints set (soa)",
+                 nb_points * nb_frames,
+                 "points",
+                 time_now() - t0);
+    cloud.print_stats();
+  }
+
+  {
+    // Append-only stream, 10K points per batch
+    show::glpoints_t cloud;
+    const size_t batch = 10000;
+    const double t0 = time_now();
+    for (size_t i = 0; i < nb_points; i += batch) {
+      cloud.append(&points[i], batch);
+      cloud.draw(gui.camera);
+    }
+    glFinish();
+    bench_report("glpoints append", nb_points, "points", time_now() - t0);
+    cloud.print_stats();
+  }
+}
+
+void bench_imshow_stream() {
+  show::gui_t gui{"bench_show", 640, 480};
+  const int width = 3840;
+  const int height = 2160;
+  const int nb_frames = 100;
+  std::vector<uint8_t> frame(width * height * 3, 128);
+
+  {
+    show::gui_imshow_t imshow{"sync", width, height, 3, frame.data()};
+    const double t0 = time_now();
+    for (int i = 0; i < nb_frames; i++) {
+      imshow.update(frame.data());
+    }
+    glFinish();
+    bench_report("imshow update (sync)", nb_frames, "frames", time_now() - t0);
+  }
+
+  {
+    show::gui_imshow_t imshow{"stream", width, height, 3, frame.data()};
+    imshow.stream();
+    const double t0 = time_now();
+    for (int i = 0; i < nb_frames; i++) {
+      imshow.update(frame.data());
+    }
+    glFinish();
+    bench_report("imshow update (pbo)", nb_frames, "frames", time_now() - t0);
+    imshow.print_stats();
+  }
+}
+
+/*****************************************************************************
+ *                                  SHM
+ ****************************************************************************/
+
+// 1080p RGB frames from a forked producer process, latency from publish to
+// the consumer waking up and validating the frame in place
+void bench_shm_latency() {
+  const int width = 1920;
+  const int height = 1080;
+  const size_t size = width * height * 3;
+  const int nb_frames = 1000;
+
+  const pid_t pid = fork();
+  if (pid == 0) {
+    show::shm_producer_t producer{"bench_show_shm", width, height, 3, 0, size};
+    std::vector<uint8_t> frame(size, 128);
+    usleep(100000); // Let the consumer attach
+    for (int i = 0; i < nb_frames; i++) {
+      producer.write(frame.data());
+      usleep(1000);
+    }
+    usleep(100000);
+    _exit(0);
+  }
+
+  show::shm_consumer_t consumer;
+  while (consumer.open("bench_show_shm") != 0) {
+    usleep(1000);
+  }
+
+  std::vector<double> latencies;
+  show::shm_frame_t frame;
+  const double t0 = time_now();
+  while (consumer.nb_frames_ + consumer.nb_skipped_ < (size_t) nb_frames) {
+    if (consumer.wait(100) == false || consumer.poll(frame) == false) {
+      continue;
+    }
+    const uint64_t now = show::shm_time_now();
+    if (consumer.valid(frame)) {
+      latencies.push_back((now - frame.timestamp) * 1e-3);
+    }
+  }
+  const double elapsed = time_now() - t0;
+  waitpid(pid, NULL, 0);
+
+  std::sort(latencies.begin(), latencies.end());
+  bench_report("shm frames (1080p rgb)", latencies.size(), "frames", elapsed);
+  printf("  latency us: p50 %.1f, p99 %.1f, max %.1f, "
+         "%zu skipped, %zu torn\n",
+         latencies[latencies.size() / 2],
+         latencies[latencies.size() * 99 / 100],
+         latencies.back(),
+         consumer.nb_skipped_,
+         consumer.nb_torn_);
+}
+
+int main(int argc, char **argv) {
+  bench_voxmap_insert();
+  bench_voxmap_remesh();
+  bench_mesh_optimize();
+  bench_model_stage();
+  bench_shm_latency();
+
+  // GL benchmarks need a window
+  if (argc > 1 && strcmp(argv[1], "--gl") == 0) {
+    bench_glpoints_stream();
+    bench_imshow_stream();
+  }
+
+  return 0;
+}
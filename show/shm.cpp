@@ -0,0 +1,367 @@
+#include "shm.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace show {
+
+// Atomics live in memory shared between processes
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "");
+
+static std::string shm_path(const std::string &name) {
+  return (name.size() && name[0] == '/') ? name : "/" + name;
+}
+
+static size_t shm_align(const size_t size, const size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+static long shm_futex(std::atomic<uint32_t> *addr,
+                      const int op,
+                      const uint32_t value,
+                      const struct timespec *timeout) {
+  return syscall(SYS_futex, (uint32_t *) addr, op, value, timeout, NULL, 0);
+}
+
+// Chroma planes round up for odd sizes
+static int shm_chroma(const int size) { return (size + 1) / 2; }
+
+size_t gui_imshow_frame_size(const gui_imshow_format_t format,
+                             const int img_width,
+                             const int img_height,
+                             const int img_channels) {
+  const size_t luma = (size_t) img_width * img_height;
+  const size_t chroma = (size_t) shm_chroma(img_width) *
+                        shm_chroma(img_height);
+  switch (format) {
+  case IMSHOW_YUYV:
+    return (size_t) shm_chroma(img_width) * 4 * img_height;
+  case IMSHOW_NV12:
+  case IMSHOW_I420:
+    return luma + chroma * 2;
+  case IMSHOW_BAYER_RGGB:
+  case IMSHOW_BAYER_BGGR:
+    return luma;
+  case IMSHOW_DEPTH16:
+    return luma * sizeof(uint16_t);
+  case IMSHOW_FLOAT32:
+    return luma * sizeof(float);
+  default:
+    return luma * img_channels;
+  }
+}
+
+uint64_t shm_time_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*****************************************************************************
+ *                                PRODUCER
+ ****************************************************************************/
+
+shm_producer_t::shm_producer_t(const std::string &name,
+                               const int width,
+                               const int height,
+                               const int channels,
+                               const int format,
+                               const size_t frame_size,
+                               const int nb_slots)
+    : name_{shm_path(name)} {
+  if (nb_slots < 2 || nb_slots > SHM_MAX_SLOTS) {
+    fprintf(stderr, "[ERROR] shm [%s]: bad slot count!\n", name_.c_str());
+    return;
+  }
+  const size_t expected =
+      gui_imshow_frame_size((gui_imshow_format_t) format,
+                            width,
+                            height,
+                            channels);
+  if (frame_size == 0 || frame_size != expected) {
+    fprintf(stderr, "[ERROR] shm [%s]: bad frame size!\n", name_.c_str());
+    return;
+  }
+
+  // Slots are page aligned
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t data_offset = shm_align(sizeof(shm_header_t), page_size);
+  const size_t slot_stride = shm_align(frame_size, page_size);
+  mapped_size_ = data_offset + slot_stride * nb_slots;
+
+  // Replace a segment left over by a producer that crashed
+  shm_unlink(name_.c_str());
+  fd_ = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+  if (fd_ == -1 || ftruncate(fd_, mapped_size_) != 0) {
+    fprintf(stderr, "[ERROR] shm [%s]: %s\n", name_.c_str(), strerror(errno));
+    return;
+  }
+  void *mapped = mmap(NULL,
+                      mapped_size_,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      fd_,
+                      0);
+  if (mapped == MAP_FAILED) {
+    fprintf(stderr, "[ERROR] shm [%s]: %s\n", name_.c_str(), strerror(errno));
+    return;
+  }
+  mapped_ = (uint8_t *) mapped;
+
+  // Magic goes last, consumers ignore the segment until it is set
+  header_ = (shm_header_t *) mapped_;
+  header_->width = width;
+  header_->height = height;
+  header_->channels = channels;
+  header_->format = format;
+  header_->nb_slots = nb_slots;
+  header_->frame_size = frame_size;
+  header_->slot_stride = slot_stride;
+  header_->data_offset = data_offset;
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header_->magic, SHM_MAGIC, sizeof(header_->magic));
+}
+
+shm_producer_t::~shm_producer_t() {
+  if (mapped_) {
+    munmap(mapped_, mapped_size_);
+  }
+  if (fd_ != -1) {
+    close(fd_);
+    shm_unlink(name_.c_str());
+  }
+}
+
+bool shm_producer_t::ok() const { return header_ != nullptr; }
+
+uint8_t *shm_producer_t::begin() {
+  if (header_ == nullptr) {
+    return nullptr;
+  }
+
+  // Odd seqlock while the slot is written
+  slot_ = seq_ % header_->nb_slots;
+  shm_slot_t &slot = header_->slots[slot_];
+  if (writing_ == false) {
+    slot.seqlock.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    writing_ = true;
+  }
+
+  return mapped_ + header_->data_offset + slot_ * header_->slot_stride;
+}
+
+void shm_producer_t::publish(const uint64_t timestamp) {
+  if (writing_ == false) {
+    return;
+  }
+
+  shm_slot_t &slot = header_->slots[slot_];
+  seq_++;
+  slot.seq.store(seq_, std::memory_order_relaxed);
+  slot.timestamp.store((timestamp) ? timestamp : shm_time_now(),
+                       std::memory_order_relaxed);
+  slot.seqlock.fetch_add(1, std::memory_order_release);
+  header_->latest.store(seq_, std::memory_order_release);
+  writing_ = false;
+
+  // Ring the doorbell, the syscall only when a consumer sleeps on it
+  header_->doorbell.fetch_add(1);
+  if (header_->nb_waiters.load()) {
+    shm_futex(&header_->doorbell, FUTEX_WAKE, INT_MAX, NULL);
+  }
+}
+
+void shm_producer_t::write(const void *frame, const uint64_t timestamp) {
+  uint8_t *dst = begin();
+  if (dst) {
+    memcpy(dst, frame, header_->frame_size);
+    publish(timestamp);
+  }
+}
+
+/*****************************************************************************
+ *                                CONSUMER
+ ****************************************************************************/
+
+shm_consumer_t::~shm_consumer_t() { close(); }
+
+int shm_consumer_t::open(const std::string &name) {
+  close();
+  name_ = shm_path(name);
+
+  const int fd = shm_open(name_.c_str(), O_RDWR, 0);
+  if (fd == -1) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(shm_header_t)) {
+    ::close(fd);
+    return -1;
+  }
+
+  // Mapped writable for the futex waiter count, frames are only read
+  void *mapped = mmap(NULL,
+                      st.st_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      fd,
+                      0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    return -1;
+  }
+  mapped_ = (uint8_t *) mapped;
+  mapped_size_ = st.st_size;
+
+  // Producer still initializing or a foreign segment
+  const shm_header_t *header = (const shm_header_t *) mapped_;
+  const bool ready = memcmp(header->magic, SHM_MAGIC, 8) == 0;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (ready == false) {
+    close();
+    return -1;
+  }
+
+  // Slots must hold a whole frame of the format and fit in the mapping, a
+  // bad segment is not retried until the producer restarts
+  dev_ = st.st_dev;
+  ino_ = st.st_ino;
+  const size_t frame_size =
+      gui_imshow_frame_size((gui_imshow_format_t) header->format,
+                            header->width,
+                            header->height,
+                            header->channels);
+  const bool valid_dims = header->width && header->height &&
+                          header->width <= 65536 && header->height <= 65536 &&
+                          header->channels >= 1 && header->channels <= 4 &&
+                          header->format <= IMSHOW_FLOAT32;
+  const bool valid_slots = header->nb_slots >= 1 &&
+                           header->nb_slots <= SHM_MAX_SLOTS &&
+                           header->data_offset >= sizeof(shm_header_t) &&
+                           header->data_offset <= mapped_size_;
+  if (valid_dims == false || valid_slots == false ||
+      header->frame_size != frame_size ||
+      header->slot_stride < header->frame_size ||
+      header->slot_stride > (mapped_size_ - header->data_offset) /
+                                header->nb_slots) {
+    fprintf(stderr, "[ERROR] shm [%s]: bad segment layout!\n", name_.c_str());
+    close();
+    return -1;
+  }
+
+  header_ = header;
+  last_seq_ = 0;
+  return 0;
+}
+
+void shm_consumer_t::close() {
+  if (mapped_) {
+    munmap(mapped_, mapped_size_);
+  }
+  mapped_ = nullptr;
+  mapped_size_ = 0;
+  header_ = nullptr;
+}
+
+bool shm_consumer_t::ok() const { return header_ != nullptr; }
+
+bool shm_consumer_t::poll(shm_frame_t &frame) {
+  if (header_ == nullptr) {
+    return false;
+  }
+  const uint64_t latest = header_->latest.load(std::memory_order_acquire);
+  if (latest == last_seq_) {
+    return false;
+  }
+
+  // Slot already being rewritten, the producer lapped us
+  const uint32_t index = (latest - 1) % header_->nb_slots;
+  const shm_slot_t &slot = header_->slots[index];
+  const uint64_t seqlock = slot.seqlock.load(std::memory_order_acquire);
+  if (seqlock & 1) {
+    nb_torn_++;
+    return false;
+  }
+
+  frame.slot = index;
+  frame.seqlock = seqlock;
+  frame.seq = slot.seq.load(std::memory_order_relaxed);
+  frame.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+  frame.data = mapped_ + header_->data_offset + index * header_->slot_stride;
+  if (frame.seq <= last_seq_) {
+    return false;
+  }
+
+  nb_skipped_ += frame.seq - last_seq_ - 1;
+  nb_frames_++;
+  last_seq_ = frame.seq;
+  return true;
+}
+
+bool shm_consumer_t::valid(const shm_frame_t &frame) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const shm_slot_t &slot = header_->slots[frame.slot];
+  if (slot.seqlock.load(std::memory_order_relaxed) != frame.seqlock) {
+    nb_torn_++;
+    return false;
+  }
+  return true;
+}
+
+bool shm_consumer_t::wait(const int timeout_ms) {
+  if (header_ == nullptr) {
+    return false;
+  }
+
+  // The doorbell value read before checking closes the race with publish
+  shm_header_t *header = (shm_header_t *) header_;
+  const uint32_t bell = header->doorbell.load();
+  if (header->latest.load(std::memory_order_acquire) != last_seq_) {
+    return true;
+  }
+
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (timeout_ms % 1000) * 1000000l;
+  header->nb_waiters.fetch_add(1);
+  shm_futex(&header->doorbell, FUTEX_WAIT, bell, &timeout);
+  header->nb_waiters.fetch_sub(1);
+
+  return header->latest.load(std::memory_order_acquire) != last_seq_;
+}
+
+bool shm_consumer_t::restarted() {
+  const uint64_t now = shm_time_now();
+  if (name_.empty() || now < check_time_) {
+    return false;
+  }
+  check_time_ = now + SHM_CHECK_PERIOD;
+
+  // The name now points at another segment, or one appeared after a failed
+  // open, the mapping still held keeps the old segment alive
+  const int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat st;
+  const bool changed =
+      fstat(fd, &st) == 0 &&
+      ((uint64_t) st.st_dev != dev_ || (uint64_t) st.st_ino != ino_);
+  ::close(fd);
+
+  return changed;
+}
+
+} // namespace show
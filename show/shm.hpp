@@ -0,0 +1,151 @@
+#ifndef SHOW_SHM_HPP
+#define SHOW_SHM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace show {
+
+/**
+ * Pixel formats `gui_imshow_t` converts on the GPU. `IMSHOW_DIRECT` is 8-bit
+ * gray, RGB or RGBA by channel count. YUV formats are BT.601 limited range,
+ * YUYV packed 4:2:2, NV12 and I420 planar 4:2:0 with chroma planes rounded
+ * up for odd sizes. Bayer formats are 8-bit mosaics, demosaiced bilinearly.
+ * `IMSHOW_DEPTH16` and `IMSHOW_FLOAT32` are single channel, normalized to a
+ * range and drawn through a `gui_colormap_t`. Zero depths and non-finite
+ * floats are treated as invalid and drawn black.
+ */
+enum gui_imshow_format_t {
+  IMSHOW_DIRECT = 0,
+  IMSHOW_YUYV = 1,
+  IMSHOW_NV12 = 2,
+  IMSHOW_I420 = 3,
+  IMSHOW_BAYER_RGGB = 4,
+  IMSHOW_BAYER_BGGR = 5,
+  IMSHOW_DEPTH16 = 6,
+  IMSHOW_FLOAT32 = 7,
+};
+
+size_t gui_imshow_frame_size(const gui_imshow_format_t format,
+                             const int img_width,
+                             const int img_height,
+                             const int img_channels);
+
+/**
+ * Shared memory frame ring between processes on one machine, free of GL so
+ * camera and SLAM binaries only link `libshow_shm.a`.
+ *
+ * The producer creates a POSIX shm object `name` holding a header and
+ * `nb_slots` frame slots. Each slot is guarded by a seqlock, odd while being
+ * written, and `latest` holds the sequence number of the newest complete
+ * frame. Publishing bumps the `doorbell` futex word and wakes consumers only
+ * if one is sleeping in `wait()`.
+ *
+ * Consumers map the object and read frames in place: `poll()` returns a
+ * view of the newest frame not seen yet and `valid()` tells, after the frame
+ * has been used, whether the producer lapped the slot meanwhile.
+ * Timestamps are CLOCK_MONOTONIC nanoseconds so they compare across
+ * processes.
+ *
+ * `open()` rejects segments whose slots cannot hold a frame of the format
+ * and size in the header. A restarted producer unlinks the segment and
+ * creates a new one under the same name, `restarted()` notices through the
+ * inode, checked at most every `SHM_CHECK_PERIOD` nanoseconds.
+ */
+#define SHM_MAGIC "SHOWSHM1"
+#define SHM_MAX_SLOTS 16
+#define SHM_CHECK_PERIOD 100000000ull
+
+struct shm_slot_t {
+  std::atomic<uint64_t> seqlock;
+  std::atomic<uint64_t> seq;
+  std::atomic<uint64_t> timestamp;
+  uint64_t pad[5];
+};
+
+struct shm_header_t {
+  char magic[8];
+  uint32_t width;
+  uint32_t height;
+  uint32_t channels;
+  uint32_t format; // gui_imshow_format_t
+  uint32_t nb_slots;
+  uint32_t pad0;
+  uint64_t frame_size;
+  uint64_t slot_stride;
+  uint64_t data_offset;
+  std::atomic<uint64_t> latest;
+  std::atomic<uint32_t> doorbell;
+  std::atomic<uint32_t> nb_waiters;
+  uint64_t pad1[6];
+  shm_slot_t slots[SHM_MAX_SLOTS];
+};
+
+struct shm_frame_t {
+  const uint8_t *data = nullptr;
+  uint64_t seq = 0;
+  uint64_t timestamp = 0;
+  uint32_t slot = 0;
+  uint64_t seqlock = 0;
+};
+
+uint64_t shm_time_now();
+
+struct shm_producer_t {
+  std::string name_;
+  int fd_ = -1;
+  uint8_t *mapped_ = nullptr;
+  size_t mapped_size_ = 0;
+  shm_header_t *header_ = nullptr;
+  uint64_t seq_ = 0;
+  uint32_t slot_ = 0;
+  bool writing_ = false;
+
+  shm_producer_t(const std::string &name,
+                 const int width,
+                 const int height,
+                 const int channels,
+                 const int format,
+                 const size_t frame_size,
+                 const int nb_slots = 4);
+  ~shm_producer_t();
+  shm_producer_t(const shm_producer_t &) = delete;
+  shm_producer_t &operator=(const shm_producer_t &) = delete;
+
+  bool ok() const;
+  uint8_t *begin();
+  void publish(const uint64_t timestamp = 0);
+  void write(const void *frame, const uint64_t timestamp = 0);
+};
+
+struct shm_consumer_t {
+  std::string name_;
+  uint8_t *mapped_ = nullptr;
+  size_t mapped_size_ = 0;
+  const shm_header_t *header_ = nullptr;
+  uint64_t last_seq_ = 0;
+  uint64_t dev_ = 0;
+  uint64_t ino_ = 0;
+  uint64_t check_time_ = 0;
+
+  size_t nb_frames_ = 0;
+  size_t nb_skipped_ = 0;
+  size_t nb_torn_ = 0;
+
+  shm_consumer_t() = default;
+  ~shm_consumer_t();
+  shm_consumer_t(const shm_consumer_t &) = delete;
+  shm_consumer_t &operator=(const shm_consumer_t &) = delete;
+
+  int open(const std::string &name);
+  void close();
+  bool ok() const;
+  bool poll(shm_frame_t &frame);
+  bool valid(const shm_frame_t &frame);
+  bool wait(const int timeout_ms);
+  bool restarted();
+};
+
+} // namespace show
+#endif // SHOW_SHM_HPP
@@ -41,1315 +41,5946 @@ void print_mat4(const std::string &title, const glm::mat4 &m) {
   printf("%f, %f, %f, %f\n", c1.w, c2.w, c3.w, c4.w);
 }
 
+uint64_t hash_fnv1a(const void *data, const size_t size, const uint64_t seed) {
+  const unsigned char *bytes = (const unsigned char *) data;
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+int file_read(const std::string &path, std::string &contents) {
+  std::ifstream file{path, std::ios::binary};
+  if (file.good() == false) {
+    return -1;
+  }
+
+  std::stringstream ss;
+  ss << file.rdbuf();
+  contents = ss.str();
+  return 0;
+}
+
+thread_pool_t::thread_pool_t(const size_t nb_threads) {
+  size_t n = (nb_threads) ? nb_threads : std::thread::hardware_concurrency();
+  n = std::max(n, (size_t) 1);
+
+  for (size_t i = 0; i < n; i++) {
+    workers_.emplace_back([this]() {
+      while (true) {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          cv_.wait(lock, [this]() { return stop_ || jobs_.size(); });
+          if (stop_ && jobs_.empty()) {
+            return;
+          }
+          job = std::move(jobs_.front());
+          jobs_.pop_front();
+        }
+        job();
+      }
+    });
+  }
+}
+
+thread_pool_t::~thread_pool_t() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void thread_pool_t::push(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  cv_.notify_one();
+}
+
+void thread_pool_t::parallel_for(const size_t n,
+                                 const std::function<void(size_t)> &fn) {
+  // Workers and the caller pull indices until there are none left
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      fn(i);
+    }
+  };
+
+  const size_t nb_jobs = std::min(n, workers_.size());
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  size_t nb_done = 0;
+  for (size_t j = 0; j < nb_jobs; j++) {
+    push([&]() {
+      work();
+      std::lock_guard<std::mutex> lock(done_mutex);
+      nb_done++;
+      done_cv.notify_one();
+    });
+  }
+  work();
+
+  std::unique_lock<std::mutex> lock(done_mutex);
+  done_cv.wait(lock, [&]() { return nb_done == nb_jobs; });
+}
+
+thread_pool_t &thread_pool() {
+  static thread_pool_t pool;
+  return pool;
+}
+
 /*****************************************************************************
  *                                SHADER
  ****************************************************************************/
 
-int shader_compile(const char *shader_src, const int type) {
+int shader_submit(const char *shader_src, const int type) {
   assert(shader_src != nullptr);
 
   int shader = glCreateShader(type);
   glShaderSource(shader, 1, &shader_src, NULL);
   glCompileShader(shader);
 
+  return shader;
+}
+
+int shader_check(const int shader) {
   int success = 0;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
     char log[512];
     glGetShaderInfoLog(shader, 512, NULL, log);
-    printf("Failed to compile fragment shader:\n%s\n", log);
+    printf("Failed to compile shader:\n%s\n", log);
+    glDeleteShader(shader);
     return -1;
   }
 
   return shader;
 }
 
+int shader_compile(const char *shader_src, const int type) {
+  return shader_check(shader_submit(shader_src, type));
+}
+
 int shader_compile(const std::string &shader_path, const int type) {
-  // Open shader file
-  std::ifstream shader_file{shader_path};
-  if (shader_file.good() == false) {
+  std::string str;
+  if (file_read(shader_path, str) != 0) {
     return -1;
   }
 
-  // Parse file to string
-  std::stringstream ss;
-  ss << shader_file.rdbuf();
-  shader_file.close();
-  const std::string str = ss.str();
-  const char *shader_src = str.c_str();
-
-  return shader_compile(shader_src, type);
+  return shader_compile(str.c_str(), type);
 }
 
-int shaders_link(const int vertex_shader,
-                 const int fragment_shader,
-                 const int geometry_shader) {
-  assert(vertex_shader != -1);
-  assert(fragment_shader != -1);
-
-  // Attach shaders to link
-  int program = glCreateProgram();
+static void shaders_attach(const int program,
+                           const int vertex_shader,
+                           const int fragment_shader,
+                           const int geometry_shader) {
   glAttachShader(program, vertex_shader);
   glAttachShader(program, fragment_shader);
   if (geometry_shader != -1) {
     glAttachShader(program, geometry_shader);
   }
-  glLinkProgram(program);
+}
 
-  // Link program
+static void shaders_delete(const int vertex_shader,
+                           const int fragment_shader,
+                           const int geometry_shader) {
+  glDeleteShader(vertex_shader);
+  glDeleteShader(fragment_shader);
+  if (geometry_shader != -1) {
+    glDeleteShader(geometry_shader);
+  }
+}
+
+static int program_check(const int program) {
   int success = 0;
   char log[1024];
   glGetProgramiv(program, GL_LINK_STATUS, &success);
   if (!success) {
     glGetProgramInfoLog(program, 1024, NULL, log);
     printf("Failed to link shaders:\nReason: %s\n", log);
+    return -1;
+  }
+
+  return 0;
+}
+
+int shaders_link(const int vertex_shader,
+                 const int fragment_shader,
+                 const int geometry_shader) {
+  assert(vertex_shader != -1);
+  assert(fragment_shader != -1);
+
+  // Attach shaders to link
+  const int program = glCreateProgram();
+  shaders_attach(program, vertex_shader, fragment_shader, geometry_shader);
+  glLinkProgram(program);
+
+  // Link program
+  if (program_check(program) != 0) {
     exit(-1);
   }
 
   // Delete shaders
-  glDeleteShader(vertex_shader);
-  glDeleteShader(fragment_shader);
-  if (geometry_shader == -1) {
-    glDeleteShader(geometry_shader);
-  }
+  shaders_delete(vertex_shader, fragment_shader, geometry_shader);
 
   return program;
 }
 
-glprog_t::glprog_t(const std::string &vs_path, const std::string &fs_path) {
-  const int vs = shader_compile(vs_path, GL_VERTEX_SHADER);
-  const int fs = shader_compile(fs_path, GL_FRAGMENT_SHADER);
-  program_id = shaders_link(vs, fs);
+bool shaders_parallel_supported() {
+  return GLAD_GL_KHR_parallel_shader_compile ||
+         GLAD_GL_ARB_parallel_shader_compile;
 }
 
-glprog_t::glprog_t(const std::string &vs_path,
-                   const std::string &fs_path,
-                   const std::string &gs_path) {
-  const int vs = shader_compile(vs_path, GL_VERTEX_SHADER);
-  const int fs = shader_compile(fs_path, GL_FRAGMENT_SHADER);
-  const int gs = shader_compile(gs_path, GL_GEOMETRY_SHADER);
-  program_id = shaders_link(vs, fs, gs);
+void shaders_parallel_init() {
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+  } else if (GLAD_GL_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+  }
 }
 
-glprog_t::glprog_t(const char *vs_src, const char *fs_src) {
-  assert(vs_src != nullptr);
-  assert(fs_src != nullptr);
-  const int vs = shader_compile(vs_src, GL_VERTEX_SHADER);
-  const int fs = shader_compile(fs_src, GL_FRAGMENT_SHADER);
-  program_id = shaders_link(vs, fs);
+glprog_cache_t &glprog_cache() {
+  static glprog_cache_t cache;
+  return cache;
 }
 
-void glprog_t::use() const { glUseProgram(program_id); }
+void glprog_cache_enable(const std::string &dir) {
+  glprog_cache_t &cache = glprog_cache();
+  cache.enabled = true;
+  cache.dir = dir;
+  mkdir(dir.c_str(), 0755);
+}
 
-int glprog_t::set(const std::string &key, const bool value) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
-  }
+void glprog_cache_disable() { glprog_cache().enabled = false; }
 
-  glUniform1i(location, (int) value);
-  return 0;
+void glprog_cache_print_stats() {
+  const glprog_cache_t &cache = glprog_cache();
+  LOG_INFO("Program cache [%s]: %zu hits, %zu misses",
+           cache.dir.c_str(),
+           cache.hits,
+           cache.misses);
 }
 
-int glprog_t::set(const std::string &key, const int value) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+static bool glprog_cache_supported() {
+  if (!GLAD_GL_ARB_get_program_binary && !GLAD_GL_VERSION_4_1) {
+    return false;
   }
 
-  glUniform1i(location, value);
-  return 0;
+  int nb_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nb_formats);
+  return nb_formats > 0;
 }
 
-int glprog_t::set(const std::string &key, const float value) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+static uint64_t glprog_cache_key(const char *vs_src,
+                                 const char *fs_src,
+                                 const char *gs_src) {
+  // Driver strings are part of the key, binaries are not portable
+  glprog_cache_t &cache = glprog_cache();
+  if (cache.driver.empty()) {
+    const GLenum names[4] = {GL_VENDOR,
+                             GL_RENDERER,
+                             GL_VERSION,
+                             GL_SHADING_LANGUAGE_VERSION};
+    for (const auto name : names) {
+      const char *str = (const char *) glGetString(name);
+      cache.driver += (str) ? str : "";
+      cache.driver += '\n';
+    }
   }
 
-  glUniform1f(location, value);
-  return 0;
+  const char *srcs[3] = {vs_src, fs_src, (gs_src) ? gs_src : ""};
+  uint64_t key = hash_fnv1a(cache.driver.data(), cache.driver.size());
+  for (const auto src : srcs) {
+    key = hash_fnv1a(src, strlen(src) + 1, key);
+  }
+
+  return key;
 }
 
-int glprog_t::set(const std::string &key, const glm::vec2 &value) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
+struct glprog_cache_header_t {
+  char magic[8];
+  uint64_t key;
+  uint32_t format;
+  uint32_t length;
+};
+
+static std::string glprog_cache_path(const uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+  return glprog_cache().dir + "/" + name;
+}
+
+static int glprog_cache_load(const uint64_t key) {
+  std::string data;
+  if (file_read(glprog_cache_path(key), data) != 0) {
     return -1;
   }
 
-  glUniform2fv(location, 1, &value[0]);
-  return 0;
-}
+  // Check header
+  glprog_cache_header_t header;
+  if (data.size() < sizeof(header)) {
+    return -1;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (memcmp(header.magic, "SHOWPRG1", 8) != 0 || header.key != key ||
+      data.size() != sizeof(header) + header.length) {
+    return -1;
+  }
 
-int glprog_t::set(const std::string &key,
-                  const float x,
-                  const float y) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
+  // Drivers reject binaries from other versions, in which case recompile
+  const int program = glCreateProgram();
+  glProgramBinary(program,
+                  header.format,
+                  data.data() + sizeof(header),
+                  header.length);
+  int success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glDeleteProgram(program);
     return -1;
   }
 
-  glUniform2f(location, x, y);
-  return 0;
+  return program;
 }
 
-int glprog_t::set(const std::string &key, const glm::vec3 &value) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+static void glprog_cache_save(const uint64_t key, const int program) {
+  int length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
   }
 
-  glUniform3fv(location, 1, &value[0]);
-  return 0;
+  glprog_cache_header_t header;
+  memcpy(header.magic, "SHOWPRG1", 8);
+  header.key = key;
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, NULL, &format, binary.data());
+  header.format = format;
+  header.length = length;
+
+  // Write to a temporary file first so readers never see partial binaries
+  const std::string path = glprog_cache_path(key);
+  const std::string tmp_path = path + ".tmp";
+  FILE *fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == NULL) {
+    LOG_WARN("Failed to write program cache [%s]!", tmp_path.c_str());
+    return;
+  }
+  const bool written =
+      fwrite(&header, sizeof(header), 1, fp) == 1 &&
+      fwrite(binary.data(), 1, binary.size(), fp) == binary.size();
+  if (fclose(fp) != 0 || written == false) {
+    LOG_WARN("Failed to write program cache [%s]!", tmp_path.c_str());
+    remove(tmp_path.c_str());
+    return;
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG_WARN("Failed to write program cache [%s]!", path.c_str());
+    remove(tmp_path.c_str());
+  }
 }
 
-int glprog_t::set(const std::string &key,
-                  const float x,
-                  const float y,
-                  const float z) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+glprog_job_t glprog_submit(const char *vs_src,
+                           const char *fs_src,
+                           const char *gs_src) {
+  assert(vs_src != nullptr);
+  assert(fs_src != nullptr);
+  glprog_job_t job;
+
+  // Try the program binary cache first
+  glprog_cache_t &cache = glprog_cache();
+  job.use_cache = cache.enabled && glprog_cache_supported();
+  if (job.use_cache) {
+    job.cache_key = glprog_cache_key(vs_src, fs_src, gs_src);
+    job.program = glprog_cache_load(job.cache_key);
+    if (job.program != -1) {
+      cache.hits++;
+      job.done = true;
+      return job;
+    }
+    cache.misses++;
   }
 
-  glUniform3f(location, x, y, z);
-  return 0;
+  // Hand shaders to the driver, statuses are only queried when finishing
+  job.vs = shader_submit(vs_src, GL_VERTEX_SHADER);
+  job.fs = shader_submit(fs_src, GL_FRAGMENT_SHADER);
+  job.gs = (gs_src) ? shader_submit(gs_src, GL_GEOMETRY_SHADER) : -1;
+  job.program = glCreateProgram();
+  if (job.use_cache) {
+    glProgramParameteri(job.program,
+                        GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
+  shaders_attach(job.program, job.vs, job.fs, job.gs);
+  glLinkProgram(job.program);
+
+  return job;
 }
 
-int glprog_t::set(const std::string &key, const glm::vec4 &value) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+bool glprog_ready(const glprog_job_t &job) {
+  if (job.done || job.program == -1) {
+    return true;
   }
 
-  glUniform4fv(location, 1, &value[0]);
-  return 0;
+  // Without parallel compile support finishing may block
+  if (!shaders_parallel_supported()) {
+    return true;
+  }
+
+  int done = 0;
+  glGetProgramiv(job.program, GL_COMPLETION_STATUS_KHR, &done);
+  return done;
 }
 
-int glprog_t::set(const std::string &key,
-                  const float x,
-                  const float y,
-                  const float z,
-                  const float w) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+int glprog_finish(glprog_job_t &job) {
+  if (job.done || job.program == -1) {
+    return job.program;
   }
 
-  glUniform4f(location, x, y, z, w);
-  return 0;
-}
+  // Check compile status first to report the offending stage
+  int retval = 0;
+  const int shaders[3] = {job.vs, job.fs, job.gs};
+  for (const auto shader : shaders) {
+    if (shader == -1) {
+      continue;
+    }
 
-int glprog_t::set(const std::string &key, const glm::mat2 &mat) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
+    int success = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+      char log[512];
+      glGetShaderInfoLog(shader, 512, NULL, log);
+      printf("Failed to compile shader:\n%s\n", log);
+      retval = -1;
+    }
+  }
+  if (retval == 0) {
+    retval = program_check(job.program);
+  }
+  shaders_delete(job.vs, job.fs, job.gs);
+  job.vs = -1;
+  job.fs = -1;
+  job.gs = -1;
+
+  if (retval != 0) {
+    glDeleteProgram(job.program);
+    job.program = -1;
     return -1;
   }
 
-  glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
-  return 0;
+  if (job.use_cache) {
+    glprog_cache_save(job.cache_key, job.program);
+  }
+  job.done = true;
+
+  return job.program;
 }
 
-int glprog_t::set(const std::string &key, const glm::mat3 &mat) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+size_t glprog_batch_add(glprog_batch_t &batch,
+                        const char *vs_src,
+                        const char *fs_src,
+                        const char *gs_src) {
+  batch.jobs.push_back(glprog_submit(vs_src, fs_src, gs_src));
+  return batch.jobs.size() - 1;
+}
+
+bool glprog_batch_ready(const glprog_batch_t &batch) {
+  for (const auto &job : batch.jobs) {
+    if (glprog_ready(job) == false) {
+      return false;
+    }
   }
 
-  glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
-  return 0;
+  return true;
 }
 
-int glprog_t::set(const std::string &key, const glm::mat4 &mat) const {
-  const auto location = glGetUniformLocation(program_id, key.c_str());
-  if (location == -1) {
-    return -1;
+int glprog_batch_finish(glprog_batch_t &batch,
+                        std::vector<unsigned int> &programs) {
+  int retval = 0;
+  programs.clear();
+  for (auto &job : batch.jobs) {
+    // Failed programs are left as 0, the "no program" name in GL
+    const int program = glprog_finish(job);
+    if (program == -1) {
+      retval = -1;
+      programs.push_back(0);
+      continue;
+    }
+    programs.push_back(program);
   }
 
-  glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
-  return 0;
+  return retval;
 }
 
-/*****************************************************************************
- *                                 TEXTURE
- ****************************************************************************/
+struct glprog_library_entry_t {
+  glprog_job_t job;
+  std::unique_ptr<glprog_t> program;
+};
 
-unsigned int load_texture(int img_width,
-                          int img_height,
-                          int img_channels,
-                          const unsigned char *data) {
-  unsigned int texture_id;
+static std::unordered_map<uint64_t, glprog_library_entry_t> &glprog_library() {
+  static std::unordered_map<uint64_t, glprog_library_entry_t> library;
+  return library;
+}
 
-  glGenTextures(1, &texture_id);
+static uint64_t glprog_library_key(const char *vs_src, const char *fs_src) {
+  const uint64_t key = hash_fnv1a(vs_src, strlen(vs_src) + 1);
+  return hash_fnv1a(fs_src, strlen(fs_src) + 1, key);
+}
 
-  GLenum format;
-  switch (img_channels) {
-  case 1: format = GL_RED; break;
-  case 3: format = GL_RGB; break;
-  case 4: format = GL_RGBA; break;
+void glprog_library_prefetch(const char *vs_src, const char *fs_src) {
+  auto &library = glprog_library();
+  const uint64_t key = glprog_library_key(vs_src, fs_src);
+  if (library.count(key)) {
+    return;
   }
 
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-  glTexImage2D(GL_TEXTURE_2D,
-               0,
-               format,
-               img_width,
-               img_height,
-               0,
-               format,
-               GL_UNSIGNED_BYTE,
-               data);
-  glGenerateMipmap(GL_TEXTURE_2D);
+  library[key].job = glprog_submit(vs_src, fs_src);
+}
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D,
-                  GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+void glprog_library_prefetch_builtin() {
+  glprog_library_prefetch(shaders::glcf_vs, shaders::glcf_fs);
+  glprog_library_prefetch(shaders::glcube_vs, shaders::glcube_fs);
+  glprog_library_prefetch(shaders::glcubes_vs, shaders::glcube_fs);
+  glprog_library_prefetch(shaders::glframe_vs, shaders::glframe_fs);
+  glprog_library_prefetch(shaders::glgrid_vs, shaders::glgrid_fs);
+  glprog_library_prefetch(shaders::glpoints_vs, shaders::glpoints_fs);
+  glprog_library_prefetch(shaders::glplane_vs, shaders::glplane_fs);
+  glprog_library_prefetch(shaders::glvoxel_vs, shaders::glvoxel_fs);
+}
 
-  return texture_id;
+glprog_t *glprog_library_get(const char *vs_src, const char *fs_src) {
+  auto &library = glprog_library();
+  const uint64_t key = glprog_library_key(vs_src, fs_src);
+  auto it = library.find(key);
+  if (it == library.end()) {
+    glprog_library_prefetch(vs_src, fs_src);
+    it = library.find(key);
+  }
+
+  // Finish the program on first use
+  glprog_library_entry_t &entry = it->second;
+  if (entry.program == nullptr) {
+    const int program_id = glprog_finish(entry.job);
+    if (program_id == -1) {
+      exit(-1);
+    }
+    entry.program = std::make_unique<glprog_t>(program_id);
+  }
+
+  return entry.program.get();
 }
 
-unsigned int load_texture(const std::string &texture_file,
-                          int &img_width,
-                          int &img_height,
-                          int &img_channels) {
-  unsigned char *data = stbi_load(texture_file.c_str(),
-                                  &img_width,
-                                  &img_height,
-                                  &img_channels,
-                                  0);
-  if (!data) {
-    printf("Failed to load texture at path [%s]!\n", texture_file.c_str());
+static unsigned int glprog_build(const char *vs_src,
+                                 const char *fs_src,
+                                 const char *gs_src) {
+  glprog_job_t job = glprog_submit(vs_src, fs_src, gs_src);
+  const int program = glprog_finish(job);
+  if (program == -1) {
+    exit(-1);
   }
 
-  unsigned int texture_id =
-      load_texture(img_width, img_height, img_channels, data);
-  stbi_image_free(data);
+  return program;
+}
 
-  return texture_id;
+glprog_t::glprog_t(const unsigned int program_id_) : program_id{program_id_} {
+  reflect();
 }
 
-unsigned int load_texture(const std::string &texture_file) {
-  int img_width = 0;
-  int img_height = 0;
-  int img_channels = 0;
-  return load_texture(texture_file, img_width, img_height, img_channels);
+glprog_t::glprog_t(const std::string &vs_path, const std::string &fs_path) {
+  std::string vs;
+  std::string fs;
+  if (file_read(vs_path, vs) != 0 || file_read(fs_path, fs) != 0) {
+    FATAL("Failed to read shaders [%s, %s]!",
+          vs_path.c_str(),
+          fs_path.c_str());
+  }
+  program_id = glprog_build(vs.c_str(), fs.c_str(), nullptr);
+  reflect();
 }
 
-/*****************************************************************************
- *                                 MESH
- ****************************************************************************/
+glprog_t::glprog_t(const std::string &vs_path,
+                   const std::string &fs_path,
+                   const std::string &gs_path) {
+  std::string vs;
+  std::string fs;
+  std::string gs;
+  if (file_read(vs_path, vs) != 0 || file_read(fs_path, fs) != 0 ||
+      file_read(gs_path, gs) != 0) {
+    FATAL("Failed to read shaders [%s, %s, %s]!",
+          vs_path.c_str(),
+          fs_path.c_str(),
+          gs_path.c_str());
+  }
+  program_id = glprog_build(vs.c_str(), fs.c_str(), gs.c_str());
+  reflect();
+}
 
-glmesh_t::glmesh_t(const std::vector<glvertex_t> &vertices_,
-                   const std::vector<unsigned int> &indices_,
-                   const std::vector<gltexture_t> &textures_) {
-  vertices = vertices_;
-  indices = indices_;
-  textures = textures_;
-  glmesh_init(*this);
+glprog_t::glprog_t(const char *vs_src, const char *fs_src) {
+  assert(vs_src != nullptr);
+  assert(fs_src != nullptr);
+  program_id = glprog_build(vs_src, fs_src, nullptr);
+  reflect();
 }
 
-void glmesh_init(glmesh_t &mesh) {
-  // Load data into vertex buffers
-  // -- VAO
-  glGenVertexArrays(1, &mesh.VAO);
-  glBindVertexArray(mesh.VAO);
+void glprog_t::reflect() {
+  uniforms.clear();
+
+  int nb_uniforms = 0;
+  int max_name_len = 0;
+  glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &nb_uniforms);
+  glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_len);
+  std::vector<char> name(max_name_len + 1);
+
+  for (int i = 0; i < nb_uniforms; i++) {
+    gluniform_t uniform;
+    GLsizei name_len = 0;
+    glGetActiveUniform(program_id,
+                       i,
+                       name.size(),
+                       &name_len,
+                       &uniform.size,
+                       &uniform.type,
+                       name.data());
+
+    // Uniform block members do not have a location, skip them
+    uniform.location = glGetUniformLocation(program_id, name.data());
+    if (uniform.location == -1) {
+      continue;
+    }
 
-  // -- VBO
-  glGenBuffers(1, &mesh.VBO);
-  glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
-  // A great thing about structs is that their memory layout is sequential for
-  // all its items.  The effect is that we can simply pass a pointer to the
-  // struct and it translates perfectly to a glm::vec3/2 array which again
-  // translates to 3/2 floats which translates to a byte array.
-  glBufferData(GL_ARRAY_BUFFER,
-               mesh.vertices.size() * sizeof(glvertex_t),
-               &mesh.vertices[0],
-               GL_STATIC_DRAW);
+    // Arrays are reported as "name[0]", store them under "name". Members of
+    // struct arrays, e.g. "lights[0].color", keep their full name.
+    uniform.name = std::string(name.data(), name_len);
+    const size_t len = uniform.name.size();
+    if (len > 3 && uniform.name.compare(len - 3, 3, "[0]") == 0) {
+      uniform.name.resize(len - 3);
+    }
+    uniforms.push_back(uniform);
+  }
 
-  // -- EBO
-  glGenBuffers(1, &mesh.EBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               mesh.indices.size() * sizeof(unsigned int),
-               &mesh.indices[0],
-               GL_STATIC_DRAW);
+  std::sort(uniforms.begin(),
+            uniforms.end(),
+            [](const gluniform_t &a, const gluniform_t &b) {
+              return a.name < b.name;
+            });
 
-  // Set vertex attribute pointers
-  // Vertex positions
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        sizeof(glvertex_t),
-                        (void *) 0);
+  // Bind the shared camera block, if the program declares one
+  const GLuint camera_block = glGetUniformBlockIndex(program_id, "camera");
+  if (camera_block != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program_id, camera_block, GLCAMERA_UBO_BINDING);
+  }
+}
 
-  // Vertex normals
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        sizeof(glvertex_t),
-                        (void *) offsetof(glvertex_t, normal));
+gluniform_handle_t glprog_t::uniform(const std::string &key) const {
+  const auto it = std::lower_bound(uniforms.begin(),
+                                   uniforms.end(),
+                                   key,
+                                   [](const gluniform_t &u,
+                                      const std::string &k) {
+                                     return u.name < k;
+                                   });
+
+  gluniform_handle_t handle;
+  if (it != uniforms.end() && it->name == key) {
+    handle.location = it->location;
+    return handle;
+  }
 
-  // Vertex texture coords
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2,
-                        2,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        sizeof(glvertex_t),
-                        (void *) offsetof(glvertex_t, texcoords));
+  // Other array elements and struct members, e.g. "arr[2]", are resolved by
+  // GL and cached, misses included
+  gluniform_t uniform;
+  uniform.name = key;
+  uniform.location = glGetUniformLocation(program_id, key.c_str());
+  uniforms.insert(it, uniform);
+  handle.location = uniform.location;
+  return handle;
+}
 
-  // Vertex tangent
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        sizeof(glvertex_t),
-                        (void *) offsetof(glvertex_t, tangent));
+void glprog_t::use() const { glUseProgram(program_id); }
 
-  // Vertex bitangent
-  glEnableVertexAttribArray(4);
-  glVertexAttribPointer(4,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        sizeof(glvertex_t),
-                        (void *) offsetof(glvertex_t, bitangent));
+int glprog_t::set(const std::string &key, const bool value) const {
+  return set(uniform(key), value);
+}
 
-  glBindVertexArray(0);
+int glprog_t::set(const std::string &key, const int value) const {
+  return set(uniform(key), value);
 }
 
-void glmesh_draw(const glmesh_t &mesh, const glprog_t &program) {
-  // bind appropriate textures
-  unsigned int diffuse_counter = 1;
-  unsigned int specular_counter = 1;
-  unsigned int normal_counter = 1;
-  unsigned int height_counter = 1;
+int glprog_t::set(const std::string &key, const float value) const {
+  return set(uniform(key), value);
+}
 
-  for (size_t i = 0; i < mesh.textures.size(); i++) {
-    // Acitivate proper texture unit before binding
-    glActiveTexture(GL_TEXTURE0 + i);
+int glprog_t::set(const std::string &key, const glm::vec2 &value) const {
+  return set(uniform(key), value);
+}
 
-    // Retrieve texture number (the N in diffuse_textureN)
-    std::string number;
-    std::string name = mesh.textures[i].type;
-    if (name == "texture_diffuse") {
-      number = std::to_string(diffuse_counter++);
-    } else if (name == "texture_specular") {
-      // Transfer unsigned int to stream
-      number = std::to_string(specular_counter++);
-    } else if (name == "texture_normal") {
-      // Transfer unsigned int to stream
-      number = std::to_string(normal_counter++);
-    } else if (name == "texture_height") {
-      // Transfer unsigned int to stream
-      number = std::to_string(height_counter++);
-    }
+int glprog_t::set(const std::string &key,
+                  const float x,
+                  const float y) const {
+  return set(uniform(key), x, y);
+}
 
-    // Set the sampler to the correct texture unit and bind texture
-    program.set((name + number), (int) i);
-    // glUniform1i(glGetUniformLocation(program.program_id, (name +
-    // number).c_str()), i);
-    glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
-  }
+int glprog_t::set(const std::string &key, const glm::vec3 &value) const {
+  return set(uniform(key), value);
+}
 
-  // Draw mesh
-  glBindVertexArray(mesh.VAO);
-  glDrawElements(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0);
+int glprog_t::set(const std::string &key,
+                  const float x,
+                  const float y,
+                  const float z) const {
+  return set(uniform(key), x, y, z);
+}
 
-  // Set everything back to defaults once configured
-  glActiveTexture(GL_TEXTURE0);
+int glprog_t::set(const std::string &key, const glm::vec4 &value) const {
+  return set(uniform(key), value);
 }
 
-/*****************************************************************************
- *                                MODEL
- ****************************************************************************/
+int glprog_t::set(const std::string &key,
+                  const float x,
+                  const float y,
+                  const float z,
+                  const float w) const {
+  return set(uniform(key), x, y, z, w);
+}
 
-glmodel_t::glmodel_t(const std::string &path,
-                     const std::string &vs,
-                     const std::string &fs,
-                     const bool gamma)
-    : program{vs, fs}, gamma_correction(gamma) {
-  glmodel_load(*this, path);
+int glprog_t::set(const std::string &key, const glm::mat2 &mat) const {
+  return set(uniform(key), mat);
 }
 
-glmodel_t::glmodel_t(const std::string &path,
-                     const char *vs,
-                     const char *fs,
-                     const bool gamma)
-    : program{vs, fs}, gamma_correction(gamma) {
-  glmodel_load(*this, path);
+int glprog_t::set(const std::string &key, const glm::mat3 &mat) const {
+  return set(uniform(key), mat);
 }
 
-void glmodel_draw(glmodel_t &model, const glcamera_t &camera) {
-  // Set projection and view
-  model.program.use();
-  model.program.set("projection", camera.projection());
-  model.program.set("view", camera.view());
-  model.program.set("model", model.T_SM);
+int glprog_t::set(const std::string &key, const glm::mat4 &mat) const {
+  return set(uniform(key), mat);
+}
 
-  for (unsigned int i = 0; i < model.meshes.size(); i++) {
-    glmesh_draw(model.meshes[i], model.program);
+int glprog_t::set(const gluniform_handle_t handle, const bool value) const {
+  if (handle.valid() == false) {
+    return -1;
   }
-}
 
-void glmodel_load(glmodel_t &model, const std::string &path) {
-  // Read
-  Assimp::Importer importer;
-  const auto options =
-      aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
-  const aiScene *scene = importer.ReadFile(path, options);
+  glUniform1i(handle.location, (int) value);
+  return 0;
+}
 
-  // Check for errors
-  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-      !scene->mRootNode) {
-    std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-    return;
+int glprog_t::set(const gluniform_handle_t handle, const int value) const {
+  if (handle.valid() == false) {
+    return -1;
   }
 
-  // Retrieve the directory path of the filepath
-  model.directory = path.substr(0, path.find_last_of('/'));
+  glUniform1i(handle.location, value);
+  return 0;
+}
+
+int glprog_t::set(const gluniform_handle_t handle, const float value) const {
+  if (handle.valid() == false) {
+    return -1;
+  }
 
-  // Process ASSIMP's root node recursively
-  glmodel_process_node(model, scene->mRootNode, scene);
+  glUniform1f(handle.location, value);
+  return 0;
 }
 
-void glmodel_process_node(glmodel_t &model,
-                          aiNode *node,
-                          const aiScene *scene) {
-  // Process each mesh located at the current node
-  for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-    // The node object only contains indices to index the actual objects in the
-    // scene.  the scene contains all the data, node is just to keep stuff
-    // organized (like relations between nodes).
-    aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-    model.meshes.push_back(glmodel_process_mesh(model, mesh, scene));
+int glprog_t::set(const gluniform_handle_t handle,
+                  const glm::vec2 &value) const {
+  if (handle.valid() == false) {
+    return -1;
   }
 
-  // After we've processed all of the meshes (if any) we then recursively
-  // process each of the children nodes
-  for (unsigned int i = 0; i < node->mNumChildren; i++) {
-    glmodel_process_node(model, node->mChildren[i], scene);
+  glUniform2fv(handle.location, 1, &value[0]);
+  return 0;
+}
+
+int glprog_t::set(const gluniform_handle_t handle,
+                  const float x,
+                  const float y) const {
+  if (handle.valid() == false) {
+    return -1;
   }
+
+  glUniform2f(handle.location, x, y);
+  return 0;
 }
 
-glmesh_t glmodel_process_mesh(glmodel_t &model,
-                              aiMesh *mesh,
-                              const aiScene *scene) {
-  // Data to fill
-  std::vector<glvertex_t> vertices;
-  std::vector<unsigned int> indices;
-  std::vector<gltexture_t> textures;
+int glprog_t::set(const gluniform_handle_t handle,
+                  const glm::vec3 &value) const {
+  if (handle.valid() == false) {
+    return -1;
+  }
 
-  // Walk through each of the mesh's vertices
-  for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-    glvertex_t vertex;
-    glm::vec3 vector;
-    // Placeholder vector since assimp uses its own vector class that doesn't
-    // directly convert to glm's vec3 class so we transfer the data to this
-    // placeholder glm::vec3 first.
+  glUniform3fv(handle.location, 1, &value[0]);
+  return 0;
+}
 
-    // Positions
-    vector.x = mesh->mVertices[i].x;
-    vector.y = mesh->mVertices[i].y;
-    vector.z = mesh->mVertices[i].z;
-    vertex.position = vector;
+int glprog_t::set(const gluniform_handle_t handle,
+                  const float x,
+                  const float y,
+                  const float z) const {
+  if (handle.valid() == false) {
+    return -1;
+  }
 
-    // Normals
-    vector.x = mesh->mNormals[i].x;
-    vector.y = mesh->mNormals[i].y;
-    vector.z = mesh->mNormals[i].z;
-    vertex.normal = vector;
+  glUniform3f(handle.location, x, y, z);
+  return 0;
+}
 
-    // Texture coordinates
-    if (mesh->mTextureCoords[0]) {
-      // Does the mesh contain texture coordinates? A vertex can contain up to
-      // 8 different texture coordinates. We thus make the assumption that we
-      // won't use models where a vertex can have multiple texture coordinates
-      // so we always take the first set (0).
-      glm::vec2 vec;
-      vec.x = mesh->mTextureCoords[0][i].x;
-      vec.y = mesh->mTextureCoords[0][i].y;
-      vertex.texcoords = vec;
-    } else {
-      vertex.texcoords = glm::vec2(0.0f, 0.0f);
-    }
+int glprog_t::set(const gluniform_handle_t handle,
+                  const glm::vec4 &value) const {
+  if (handle.valid() == false) {
+    return -1;
+  }
 
-    // Tangent
-    vector.x = mesh->mTangents[i].x;
-    vector.y = mesh->mTangents[i].y;
-    vector.z = mesh->mTangents[i].z;
-    vertex.tangent = vector;
+  glUniform4fv(handle.location, 1, &value[0]);
+  return 0;
+}
 
-    // Bi-tangent
-    vector.x = mesh->mBitangents[i].x;
-    vector.y = mesh->mBitangents[i].y;
-    vector.z = mesh->mBitangents[i].z;
-    vertex.bitangent = vector;
-    vertices.push_back(vertex);
+int glprog_t::set(const gluniform_handle_t handle,
+                  const float x,
+                  const float y,
+                  const float z,
+                  const float w) const {
+  if (handle.valid() == false) {
+    return -1;
   }
 
-  // Now walk through each of the mesh's faces (a face is a mesh its triangle)
-  // and retrieve the corresponding vertex indices.
-  for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-    aiFace face = mesh->mFaces[i];
+  glUniform4f(handle.location, x, y, z, w);
+  return 0;
+}
 
-    // Retrieve all indices of the face and store them in the indices vector
-    for (unsigned int j = 0; j < face.mNumIndices; j++)
-      indices.push_back(face.mIndices[j]);
+int glprog_t::set(const gluniform_handle_t handle,
+                  const glm::mat2 &mat) const {
+  if (handle.valid() == false) {
+    return -1;
   }
 
-  // Process materials
-  aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-  // we assume a convention for sampler names in the shaders. Each diffuse
-  // texture should be named as 'texture_diffuseN' where N is a sequential
-  // number ranging from 1 to MAX_SAMPLER_NUMBER.  Same applies to other
-  // texture as the following list summarizes:
-  // - diffuse: texture_diffuseN
-  // - specular: texture_specularN
-  // - normal: texture_normalN
+  glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+  return 0;
+}
 
-  // clang-format off
-  // 1. Diffuse maps
-  const auto diffuse_maps = glmodel_load_textures(
-    model,
-    material,
-    aiTextureType_DIFFUSE,
-    "texture_diffuse"
-  );
-  textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
+int glprog_t::set(const gluniform_handle_t handle,
+                  const glm::mat3 &mat) const {
+  if (handle.valid() == false) {
+    return -1;
+  }
 
-  // 2. Specular maps
-  const auto specularMaps = glmodel_load_textures(
-    model,
-    material,
-    aiTextureType_SPECULAR,
-    "texture_specular"
-  );
-  textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-  // 3. Normal maps
-  const auto normalMaps = glmodel_load_textures(
-    model,
-    material,
-    aiTextureType_HEIGHT,
-    "texture_normal"
-  );
-  textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+  glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+  return 0;
+}
 
-  // 4. Height maps
-  const auto heightMaps = glmodel_load_textures(
-    model,
-    material,
-    aiTextureType_AMBIENT,
-    "texture_height"
-  );
-  textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-  // clang-format on
+int glprog_t::set(const gluniform_handle_t handle,
+                  const glm::mat4 &mat) const {
+  if (handle.valid() == false) {
+    return -1;
+  }
 
-  // Return a mesh object created from the extracted mesh data
-  return glmesh_t{vertices, indices, textures};
+  glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+  return 0;
 }
 
-// checks all material textures of a given type and loads the textures if
-// they're not loaded yet. the required info is returned as a Texture struct.
-std::vector<gltexture_t> glmodel_load_textures(glmodel_t &model,
-                                               aiMaterial *mat,
-                                               aiTextureType type,
-                                               std::string typeName) {
-  std::vector<gltexture_t> textures;
+/*****************************************************************************
+ *                                 TEXTURE
+ ****************************************************************************/
 
-  for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-    aiString str;
-    mat->GetTexture(type, i, &str);
+static GLenum texture_format(const int channels) {
+  switch (channels) {
+  case 1: return GL_RED;
+  case 2: return GL_RG;
+  case 3: return GL_RGB;
+  default: return GL_RGBA;
+  }
+}
 
-    // check if texture was loaded before and if so, continue to next
-    // iteration: skip loading a new texture
-    bool skip = false;
-    for (unsigned int j = 0; j < model.textures_loaded.size(); j++) {
-      if (std::strcmp(model.textures_loaded[j].path.data(), str.C_Str()) == 0) {
-        textures.push_back(model.textures_loaded[j]);
-        skip = true;
-        // a texture with the same filepath has already been
-        // loaded, continue to next one. (optimization)
-        break;
-      }
-    }
+void texture_upload(const unsigned int texture_id,
+                    const int img_width,
+                    const int img_height,
+                    const int img_channels,
+                    const unsigned char *data) {
+  const GLenum format = texture_format(img_channels);
 
-    if (!skip) { // if texture hasn't been loaded already, load it
-      gltexture_t texture;
-      // const std::string texture_path = model.directory + '/' + str.C_Str();
-      texture.id = texture_from_file(model.directory, str.C_Str());
-      // texture.id = load_texture(texture_path);
-      texture.type = typeName;
-      texture.path = str.C_Str();
-      textures.push_back(texture);
-      model.textures_loaded.push_back(texture);
-      // store it as texture loaded for entire model, to ensure we won't
-      // unnecesery load duplicate textures.
-    }
-  }
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               format,
+               img_width,
+               img_height,
+               0,
+               format,
+               GL_UNSIGNED_BYTE,
+               data);
+  glGenerateMipmap(GL_TEXTURE_2D);
 
-  return textures;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D,
+                  GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
-unsigned int texture_from_file(const std::string &dir,
-                               const char *fp,
-                               bool /*gamma*/) {
-  const std::string filename = dir + '/' + std::string(fp);
+unsigned int load_texture(int img_width,
+                          int img_height,
+                          int img_channels,
+                          const unsigned char *data) {
   unsigned int texture_id;
   glGenTextures(1, &texture_id);
+  texture_upload(texture_id, img_width, img_height, img_channels, data);
+  return texture_id;
+}
 
-  int width, height, nb_components;
-  unsigned char *data =
-      stbi_load(filename.c_str(), &width, &height, &nb_components, 0);
-
-  if (data) {
-    GLenum format;
-    switch (nb_components) {
-    case 1: format = GL_RED; break;
-    case 3: format = GL_RGB; break;
-    case 4: format = GL_RGBA; break;
-    }
-
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 format,
-                 width,
-                 height,
-                 0,
-                 format,
-                 GL_UNSIGNED_BYTE,
-                 data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D,
-                    GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  } else {
-    LOG_ERROR("Texture failed to load at path: %s", fp);
+unsigned int load_texture(const std::string &texture_file,
+                          int &img_width,
+                          int &img_height,
+                          int &img_channels) {
+  unsigned char *data = stbi_load(texture_file.c_str(),
+                                  &img_width,
+                                  &img_height,
+                                  &img_channels,
+                                  0);
+  if (!data) {
+    printf("Failed to load texture at path [%s]!\n", texture_file.c_str());
   }
 
+  unsigned int texture_id =
+      load_texture(img_width, img_height, img_channels, data);
   stbi_image_free(data);
+
   return texture_id;
 }
 
-/*****************************************************************************
- *                                DRAW
- ****************************************************************************/
+unsigned int load_texture(const std::string &texture_file) {
+  int img_width = 0;
+  int img_height = 0;
+  int img_channels = 0;
+  return load_texture(texture_file, img_width, img_height, img_channels);
+}
 
-globj_t::globj_t(const char *vs, const char *fs) : program_{vs, fs} {}
+// DDS file layout, see the DirectDraw Surface programming guide
+struct dds_pixel_format_t {
+  uint32_t size;
+  uint32_t flags;
+  uint32_t fourcc;
+  uint32_t rgb_bit_count;
+  uint32_t masks[4];
+};
+
+struct dds_header_t {
+  uint32_t size;
+  uint32_t flags;
+  uint32_t height;
+  uint32_t width;
+  uint32_t pitch_or_linear_size;
+  uint32_t depth;
+  uint32_t mip_map_count;
+  uint32_t reserved1[11];
+  dds_pixel_format_t pixel_format;
+  uint32_t caps[4];
+  uint32_t reserved2;
+};
+
+struct dds_header_dx10_t {
+  uint32_t dxgi_format;
+  uint32_t resource_dimension;
+  uint32_t misc_flag;
+  uint32_t array_size;
+  uint32_t misc_flags2;
+};
+
+static constexpr uint32_t dds_fourcc(const char *s) {
+  return (uint32_t) s[0] | ((uint32_t) s[1] << 8) | ((uint32_t) s[2] << 16) |
+         ((uint32_t) s[3] << 24);
+}
 
-void globj_t::pos(const glm::vec3 &pos) { T_SM_ = glm::translate(T_SM_, pos); }
+size_t texture_block_size(const GLenum format) {
+  switch (format) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RED_RGTC1:
+    return 8;
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+  case GL_COMPRESSED_RG_RGTC2:
+  case GL_COMPRESSED_RGBA_BPTC_UNORM:
+  case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    return 16;
+  default:
+    return 0;
+  }
+}
 
-glm::vec3 globj_t::pos() { return glm::vec3(T_SM_[3]); }
+size_t texture_level_size(const GLenum format,
+                          const int width,
+                          const int height) {
+  const size_t blocks_x = std::max(1, (width + 3) / 4);
+  const size_t blocks_y = std::max(1, (height + 3) / 4);
+  return blocks_x * blocks_y * texture_block_size(format);
+}
 
-glm::mat3 globj_t::rot() {
-  glm::vec3 col_0(T_SM_[0]);
-  glm::vec3 col_1(T_SM_[1]);
-  glm::vec3 col_2(T_SM_[2]);
-  glm::mat3 R(col_0, col_1, col_2);
-  return R;
+static int texture_nb_levels(const int width, const int height) {
+  int nb_levels = 1;
+  for (int size = std::max(width, height); size > 1; size /= 2) {
+    nb_levels++;
+  }
+  return nb_levels;
 }
 
-glcf_t::glcf_t() : globj_t{shaders::glcf_vs, shaders::glcf_fs} {
-  // Form the camera fov frame
-  float hfov = fov_ / 2.0f;
-  float z = scale_;
-  float hwidth = z * glm::tan(hfov);
-  const glm::vec3 lb{-hwidth, hwidth, z};  // Left bottom
-  const glm::vec3 lt{-hwidth, -hwidth, z}; // Left top
-  const glm::vec3 rt{hwidth, -hwidth, z};  // Right top
-  const glm::vec3 rb{hwidth, hwidth, z};   // Right bottom
+bool texture_compressed_supported(const GLenum format) {
+  switch (format) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    return GLAD_GL_EXT_texture_compression_s3tc;
+  case GL_COMPRESSED_RED_RGTC1:
+  case GL_COMPRESSED_RG_RGTC2:
+    return true; // Core since GL 3.0
+  case GL_COMPRESSED_RGBA_BPTC_UNORM:
+  case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    return GLAD_GL_ARB_texture_compression_bptc || GLAD_GL_VERSION_4_2;
+  default:
+    return false;
+  }
+}
 
-  // Rectangle frame
-  // clang-format off
-  static const GLfloat vertices[] = {
-    // -- Left bottom to left top
-    lb.x, lb.y, lb.z, lt.x, lt.y, lt.z,
-    // -- Left top to right top
-    lt.x, lt.y, lt.z, rt.x, rt.y, rt.z,
-    // -- Right top to right bottom
-    rt.x, rt.y, rt.z, rb.x, rb.y, rb.z,
-    // -- Right bottom to left bottom
-    rb.x, rb.y, rb.z, lb.x, lb.y, lb.z,
-    // Rectangle frame to origin
-    // -- Origin to left bottom
-    0.0f, 0.0f, 0.0f, lb.x, lb.y, lb.z,
-    // -- Origin to left top
-    0.0f, 0.0f, 0.0f, lt.x, lt.y, lt.z,
-    // -- Origin to right top
-    0.0f, 0.0f, 0.0f, rt.x, rt.y, rt.z,
-    // -- Origin to right bottom
-    0.0f, 0.0f, 0.0f, rb.x, rb.y, rb.z
-  };
-  // clang-format on
-  const size_t nb_lines = 8;
-  const size_t nb_vertices = nb_lines * 2;
-  const size_t buffer_size = sizeof(GLfloat) * nb_vertices * 3;
+std::string texture_compressed_path(const std::string &path) {
+  const size_t len = path.size();
+  if (len >= 4 && path.compare(len - 4, 4, ".dds") == 0) {
+    return path;
+  }
+  return path + ".dds";
+}
 
-  // VAO
-  glGenVertexArrays(1, &VAO_);
-  glBindVertexArray(VAO_);
+std::string texture_compressed_sibling(const std::string &path) {
+  const std::string dds_path = texture_compressed_path(path);
+  if (dds_path == path) {
+    return "";
+  }
 
-  // VBO
-  glGenBuffers(1, &VBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-  glBufferData(GL_ARRAY_BUFFER, buffer_size, vertices, GL_STATIC_DRAW);
-  glVertexAttribPointer(0,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        3 * sizeof(float),
-                        (void *) 0);
-  glEnableVertexAttribArray(0);
+  // Older than its source means the image was edited since it was encoded
+  struct stat dds_st;
+  struct stat src_st;
+  if (stat(dds_path.c_str(), &dds_st) != 0) {
+    return "";
+  }
+  if (stat(path.c_str(), &src_st) == 0 && dds_st.st_mtime < src_st.st_mtime) {
+    return "";
+  }
+  return dds_path;
+}
 
-  // Clean up
-  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-  glBindVertexArray(0);             // Unbind VAO
+int dds_load(const std::string &path, gltexture_compressed_t &texture) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  // Magic and headers
+  uint32_t magic = 0;
+  dds_header_t header;
+  bool ok = fread(&magic, sizeof(magic), 1, fp) == 1;
+  ok = ok && magic == dds_fourcc("DDS ");
+  ok = ok && fread(&header, sizeof(header), 1, fp) == 1;
+  ok = ok && header.size == sizeof(dds_header_t);
+  if (ok == false) {
+    fclose(fp);
+    return -1;
+  }
+
+  GLenum format = 0;
+  const uint32_t fourcc = header.pixel_format.fourcc;
+  if (fourcc == dds_fourcc("DXT1")) {
+    format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  } else if (fourcc == dds_fourcc("DXT5")) {
+    format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  } else if (fourcc == dds_fourcc("ATI1") || fourcc == dds_fourcc("BC4U")) {
+    format = GL_COMPRESSED_RED_RGTC1;
+  } else if (fourcc == dds_fourcc("ATI2") || fourcc == dds_fourcc("BC5U")) {
+    format = GL_COMPRESSED_RG_RGTC2;
+  } else if (fourcc == dds_fourcc("DX10")) {
+    dds_header_dx10_t dx10;
+    if (fread(&dx10, sizeof(dx10), 1, fp) != 1) {
+      fclose(fp);
+      return -1;
+    }
+    switch (dx10.dxgi_format) {
+    case 71: format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+    case 77: format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+    case 80: format = GL_COMPRESSED_RED_RGTC1; break;
+    case 83: format = GL_COMPRESSED_RG_RGTC2; break;
+    case 98: format = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+    case 99: format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; break;
+    }
+  }
+  const uint32_t max_size = 65536;
+  if (format == 0 || header.width == 0 || header.height == 0 ||
+      header.width > max_size || header.height > max_size) {
+    LOG_ERROR("Unsupported DDS format [%s]!", path.c_str());
+    fclose(fp);
+    return -1;
+  }
+
+  // Mip chain, never more levels than down to 1x1
+  const int max_levels = texture_nb_levels(header.width, header.height);
+  const int nb_levels =
+      std::min(std::max((int) std::min(header.mip_map_count, 32u), 1),
+               max_levels);
+  int width = header.width;
+  int height = header.height;
+  size_t offset = 0;
+  std::vector<size_t> level_offsets;
+  std::vector<size_t> level_sizes;
+  for (int i = 0; i < nb_levels; i++) {
+    const size_t size = texture_level_size(format, width, height);
+    level_offsets.push_back(offset);
+    level_sizes.push_back(size);
+    offset += size;
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+
+  // Data must be in the file before allocating for it
+  const long data_start = ftell(fp);
+  fseek(fp, 0, SEEK_END);
+  const long file_size = ftell(fp);
+  fseek(fp, data_start, SEEK_SET);
+  if (data_start < 0 || file_size < data_start ||
+      offset > (size_t) (file_size - data_start)) {
+    LOG_ERROR("Truncated DDS file [%s]!", path.c_str());
+    fclose(fp);
+    return -1;
+  }
+
+  texture = gltexture_compressed_t();
+  texture.format = format;
+  texture.width = header.width;
+  texture.height = header.height;
+  texture.level_offsets = std::move(level_offsets);
+  texture.level_sizes = std::move(level_sizes);
+  texture.data.resize(offset);
+  ok = fread(texture.data.data(), offset, 1, fp) == 1;
+  fclose(fp);
+  if (ok == false) {
+    LOG_ERROR("Truncated DDS file [%s]!", path.c_str());
+    texture = gltexture_compressed_t();
+    return -1;
+  }
+
+  return 0;
 }
 
-glcf_t::~glcf_t() {
-  glDeleteVertexArrays(1, &VAO_);
-  glDeleteBuffers(1, &VBO_);
+int dds_save(const std::string &path, const gltexture_compressed_t &texture) {
+  // Legacy FourCC where there is one, BC7 needs the DX10 header
+  uint32_t fourcc = 0;
+  uint32_t dxgi_format = 0;
+  switch (texture.format) {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: fourcc = dds_fourcc("DXT1"); break;
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: fourcc = dds_fourcc("DXT5"); break;
+  case GL_COMPRESSED_RED_RGTC1: fourcc = dds_fourcc("ATI1"); break;
+  case GL_COMPRESSED_RG_RGTC2: fourcc = dds_fourcc("ATI2"); break;
+  case GL_COMPRESSED_RGBA_BPTC_UNORM: dxgi_format = 98; break;
+  case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM: dxgi_format = 99; break;
+  default:
+    LOG_ERROR("Unsupported compressed format [0x%x]!", texture.format);
+    return -1;
+  }
+
+  const uint32_t DDSD_CAPS = 0x1;
+  const uint32_t DDSD_HEIGHT = 0x2;
+  const uint32_t DDSD_WIDTH = 0x4;
+  const uint32_t DDSD_PIXELFORMAT = 0x1000;
+  const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+  const uint32_t DDSD_LINEARSIZE = 0x80000;
+  const uint32_t DDPF_FOURCC = 0x4;
+  const uint32_t DDSCAPS_COMPLEX = 0x8;
+  const uint32_t DDSCAPS_TEXTURE = 0x1000;
+  const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+  dds_header_t header = {};
+  header.size = sizeof(dds_header_t);
+  header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                 DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+  header.height = texture.height;
+  header.width = texture.width;
+  header.pitch_or_linear_size =
+      (texture.level_sizes.size()) ? texture.level_sizes[0] : 0;
+  header.mip_map_count = texture.level_sizes.size();
+  header.pixel_format.size = sizeof(dds_pixel_format_t);
+  header.pixel_format.flags = DDPF_FOURCC;
+  header.pixel_format.fourcc = (fourcc) ? fourcc : dds_fourcc("DX10");
+  header.caps[0] = DDSCAPS_TEXTURE;
+  if (texture.level_sizes.size() > 1) {
+    header.caps[0] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+  }
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == NULL) {
+    LOG_ERROR("Failed to open [%s] for writing!", path.c_str());
+    return -1;
+  }
+
+  const uint32_t magic = dds_fourcc("DDS ");
+  bool ok = fwrite(&magic, sizeof(magic), 1, fp) == 1;
+  ok = ok && fwrite(&header, sizeof(header), 1, fp) == 1;
+  if (fourcc == 0) {
+    dds_header_dx10_t dx10 = {};
+    dx10.dxgi_format = dxgi_format;
+    dx10.resource_dimension = 3; // Texture 2D
+    dx10.array_size = 1;
+    ok = ok && fwrite(&dx10, sizeof(dx10), 1, fp) == 1;
+  }
+  ok = ok && (texture.data.empty() ||
+              fwrite(texture.data.data(), texture.data.size(), 1, fp) == 1);
+  fclose(fp);
+
+  if (ok == false) {
+    LOG_ERROR("Failed to write [%s]!", path.c_str());
+    return -1;
+  }
+  return 0;
 }
 
-void glcf_t::draw(const glcamera_t &camera) {
-  program_.use();
-  program_.set("projection", camera.projection());
-  program_.set("view", camera.view());
-  program_.set("model", T_SM_);
+void texture_upload_compressed(const unsigned int texture_id,
+                               const gltexture_compressed_t &texture) {
+  const int nb_levels = texture.level_sizes.size();
+  int width = texture.width;
+  int height = texture.height;
 
-  // Store original line width
-  float original_line_width = 0.0f;
-  glGetFloatv(GL_LINE_WIDTH, &original_line_width);
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  for (int i = 0; i < nb_levels; i++) {
+    glCompressedTexImage2D(GL_TEXTURE_2D,
+                           i,
+                           texture.format,
+                           width,
+                           height,
+                           0,
+                           texture.level_sizes[i],
+                           texture.data.data() + texture.level_offsets[i]);
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
 
-  // Set line width
-  glLineWidth(line_width_);
+  // Only the levels present in the file are sampled
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, nb_levels - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D,
+                  GL_TEXTURE_MIN_FILTER,
+                  (nb_levels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-  // Draw frame
-  const size_t nb_lines = 8;
-  const size_t nb_vertices = nb_lines * 2;
-  glBindVertexArray(VAO_);
-  glDrawArrays(GL_LINES, 0, nb_vertices);
-  glBindVertexArray(0); // Unbind VAO
+gltexture_loader_t &gltexture_loader() {
+  static gltexture_loader_t loader;
+  return loader;
+}
 
-  // Restore original line width
-  glLineWidth(original_line_width);
+thread_pool_t &gltexture_decode_pool() {
+  static thread_pool_t pool{
+      std::max(std::thread::hardware_concurrency() / 2, 1u)};
+  return pool;
 }
 
-glcube_t::glcube_t() : glcube_t{0.5} {}
+void gltexture_loader_cancel(const unsigned int texture_id) {
+  gltexture_loader().requests.erase(texture_id);
+}
 
-glcube_t::glcube_t(const float cube_size)
-	: globj_t{shaders::glcube_vs, shaders::glcube_fs},
-		cube_size_{cube_size} {
-  // Vertices
-  // clang-format off
-  const float r = color_.x;
-  const float g = color_.y;
-  const float b = color_.z;
-  static const GLfloat vertices[] = {
-    // Triangle 1
-    -cube_size, -cube_size, -cube_size, r, g, b,
-    -cube_size, -cube_size, cube_size, r, g, b,
-    -cube_size, cube_size, cube_size, r, g, b,
-    // Triangle 2
-    cube_size, cube_size, -cube_size, r, g, b,
-    -cube_size, -cube_size, -cube_size, r, g, b,
-    -cube_size, cube_size, -cube_size, r, g, b,
-    // Triangle 3
-    cube_size, -cube_size, cube_size, r, g, b,
-    -cube_size, -cube_size, -cube_size, r, g, b,
-    cube_size, -cube_size, -cube_size, r, g, b,
-    // Triangle 4
-    cube_size, cube_size, -cube_size, r, g, b,
-    cube_size, -cube_size, -cube_size, r, g, b,
-    -cube_size, -cube_size, -cube_size, r, g, b,
-    // Triangle 5
-    -cube_size, -cube_size, -cube_size, r, g, b,
-    -cube_size, cube_size, cube_size, r, g, b,
-    -cube_size, cube_size, -cube_size, r, g, b,
-    // Triangle 6
-    cube_size, -cube_size, cube_size, r, g, b,
-    -cube_size, -cube_size, cube_size, r, g, b,
-    -cube_size, -cube_size, -cube_size, r, g, b,
-    // Triangle 7
-    -cube_size, cube_size, cube_size, r, g, b,
-    -cube_size, -cube_size, cube_size, r, g, b,
-    cube_size, -cube_size, cube_size, r, g, b,
-    // Triangle 8
-    cube_size, cube_size, cube_size, r, g, b,
-    cube_size, -cube_size, -cube_size, r, g, b,
-    cube_size, cube_size, -cube_size, r, g, b,
-    // Triangle 9
-    cube_size, -cube_size, -cube_size, r, g, b,
-    cube_size, cube_size, cube_size, r, g, b,
-    cube_size, -cube_size, cube_size, r, g, b,
-    // Triangle 10
-    cube_size, cube_size, cube_size, r, g, b,
-    cube_size, cube_size, -cube_size, r, g, b,
-    -cube_size, cube_size, -cube_size, r, g, b,
-    // Triangle 11
-    cube_size, cube_size, cube_size, r, g, b,
-    -cube_size, cube_size, -cube_size, r, g, b,
-    -cube_size, cube_size, cube_size, r, g, b,
-    // Triangle 12
-    cube_size, cube_size, cube_size, r, g, b,
-    -cube_size, cube_size, cube_size, r, g, b,
-    cube_size, -cube_size, cube_size, r, g, b
-    // Triangle 12 : end
-  };
-  const size_t nb_triangles = 12;
-  const size_t vertices_per_triangle = 3;
-  const size_t nb_vertices = vertices_per_triangle * nb_triangles;
-  const size_t vertex_buffer_size = sizeof(float) * 6 * nb_vertices;
-  // clang-format on
-
-  // VAO
-  glGenVertexArrays(1, &VAO_);
-  glBindVertexArray(VAO_);
-
-  // VBO
-  glGenBuffers(1, &VBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-  glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, vertices, GL_STATIC_DRAW);
-  // -- Position attribute
-  size_t vertex_size = 6 * sizeof(float);
-  void *pos_offset = (void *) 0;
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, pos_offset);
-  glEnableVertexAttribArray(0);
-  // -- Color attribute
-  void *color_offset = (void *) (3 * sizeof(float));
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, color_offset);
-  glEnableVertexAttribArray(1);
+void texture_placeholder(const unsigned int texture_id) {
+  const unsigned char white[4] = {255, 255, 255, 255};
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+  glTexImage2D(GL_TEXTURE_2D,
+               0,
+               GL_RGBA,
+               1,
+               1,
+               0,
+               GL_RGBA,
+               GL_UNSIGNED_BYTE,
+               white);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
 
-  // Clean up
-  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-  glBindVertexArray(0);             // Unbind VAO
+size_t texture_mip_chain_size(const int width,
+                              const int height,
+                              const int bytes_per_pixel) {
+  size_t size = 0;
+  int w = width;
+  int h = height;
+  while (true) {
+    size += (size_t) w * h * bytes_per_pixel;
+    if (w == 1 && h == 1) {
+      return size;
+    }
+    w = std::max(w / 2, 1);
+    h = std::max(h / 2, 1);
+  }
 }
 
-glcube_t::~glcube_t() {
-  glDeleteVertexArrays(1, &VAO_);
-  glDeleteBuffers(1, &VBO_);
+// Decode an image, or its precompressed sibling if the context can sample
+// it. Safe to call from worker threads.
+static void texture_decode(const std::string &path,
+                           gltexture_decode_t &decode) {
+  decode.path = path;
+
+  const std::string dds_path = texture_compressed_sibling(path);
+  gltexture_compressed_t &compressed = decode.compressed;
+  if (dds_path.size() && dds_load(dds_path, compressed) == 0 &&
+      texture_compressed_supported(compressed.format) == false) {
+    compressed = gltexture_compressed_t();
+  }
+  if (compressed.format == 0) {
+    decode.data = stbi_load(path.c_str(),
+                            &decode.width,
+                            &decode.height,
+                            &decode.channels,
+                            0);
+  }
 }
 
-void glcube_t::draw(const glcamera_t &camera) {
-  program_.use();
-  program_.set("projection", camera.projection());
-  program_.set("view", camera.view());
-  program_.set("model", T_SM_);
+// Upload a decoded image and record its residency in the texture cache
+static void texture_upload_decoded(const gltexture_decode_t &decode) {
+  const gltexture_compressed_t &compressed = decode.compressed;
+  gltexture_cache_t &cache = gltexture_cache();
+  auto it = cache.entries.find(decode.id);
+  gltexture_entry_t *entry = (it != cache.entries.end()) ? &it->second : NULL;
 
-  // 12 x 3 indices starting at 0 -> 12 triangles -> 6 squares
-  glBindVertexArray(VAO_);
-  glDrawArrays(GL_TRIANGLES, 0, 36);
-  glBindVertexArray(0); // Unbind VAO
-}
+  if (entry) {
+    cache.reload_bytes -= entry->reload_bytes;
+    entry->reload_bytes = 0;
+  }
 
-glvoxels_t::glvoxels_t(const float voxel_size, const size_t nb_voxels)
-    : globj_t{shaders::glcube_vs, shaders::glcube_fs} {
-  // Vertices
-  // clang-format off
-  glm::vec3 color{0.9, 0.4, 0.2};
-  const float r = color.x;
-  const float g = color.y;
-  const float b = color.z;
-
-  for (size_t i = 0; i < nb_voxels; i++) {
-    static const GLfloat voxel_vertices[18 * 12] = {
-      // Triangle 1
-      -voxel_size, -voxel_size, -voxel_size, r, g, b,
-      -voxel_size, -voxel_size, voxel_size, r, g, b,
-      -voxel_size, voxel_size, voxel_size, r, g, b,
-      // Triangle 2
-      voxel_size, voxel_size, -voxel_size, r, g, b,
-      -voxel_size, -voxel_size, -voxel_size, r, g, b,
-      -voxel_size, voxel_size, -voxel_size, r, g, b,
-      // Triangle 3
-      voxel_size, -voxel_size, voxel_size, r, g, b,
-      -voxel_size, -voxel_size, -voxel_size, r, g, b,
-      voxel_size, -voxel_size, -voxel_size, r, g, b,
-      // Triangle 4
-      voxel_size, voxel_size, -voxel_size, r, g, b,
-      voxel_size, -voxel_size, -voxel_size, r, g, b,
-      -voxel_size, -voxel_size, -voxel_size, r, g, b,
-      // Triangle 5
-      -voxel_size, -voxel_size, -voxel_size, r, g, b,
-      -voxel_size, voxel_size, voxel_size, r, g, b,
-      -voxel_size, voxel_size, -voxel_size, r, g, b,
-      // Triangle 6
-      voxel_size, -voxel_size, voxel_size, r, g, b,
-      -voxel_size, -voxel_size, voxel_size, r, g, b,
-      -voxel_size, -voxel_size, -voxel_size, r, g, b,
-      // Triangle 7
-      -voxel_size, voxel_size, voxel_size, r, g, b,
-      -voxel_size, -voxel_size, voxel_size, r, g, b,
-      voxel_size, -voxel_size, voxel_size, r, g, b,
-      // Triangle 8
-      voxel_size, voxel_size, voxel_size, r, g, b,
-      voxel_size, -voxel_size, -voxel_size, r, g, b,
-      voxel_size, voxel_size, -voxel_size, r, g, b,
-      // Triangle 9
-      voxel_size, -voxel_size, -voxel_size, r, g, b,
-      voxel_size, voxel_size, voxel_size, r, g, b,
-      voxel_size, -voxel_size, voxel_size, r, g, b,
-      // Triangle 10
-      voxel_size, voxel_size, voxel_size, r, g, b,
-      voxel_size, voxel_size, -voxel_size, r, g, b,
-      -voxel_size, voxel_size, -voxel_size, r, g, b,
-      // Triangle 11
-      voxel_size, voxel_size, voxel_size, r, g, b,
-      -voxel_size, voxel_size, -voxel_size, r, g, b,
-      -voxel_size, voxel_size, voxel_size, r, g, b,
-      // Triangle 12
-      voxel_size, voxel_size, voxel_size, r, g, b,
-      -voxel_size, voxel_size, voxel_size, r, g, b,
-      voxel_size, -voxel_size, voxel_size, r, g, b
-    };
-
-    for (size_t j = 0; j < (18 * 12); j++) {
-      vertices.push_back(voxel_vertices[j]);
-    }
-  }
-
-  const size_t nb_triangles = 12 * nb_voxels;
-  const size_t vertices_per_triangle = 3;
-  const size_t nb_vertices = vertices_per_triangle * nb_triangles;
-  const size_t vertex_buffer_size = sizeof(float) * 6 * nb_vertices;
-  // clang-format on
+  if (decode.data == nullptr && compressed.format == 0) {
+    LOG_ERROR("Texture failed to load at path: %s", decode.path.c_str());
+    if (entry) {
+      // Keep what is resident, still evictable, and stop reload attempts
+      entry->failed = true;
+      entry->loading = false;
+    }
+    return;
+  }
 
-  // VAO
-  glGenVertexArrays(1, &VAO_);
-  glBindVertexArray(VAO_);
+  size_t bytes = 0;
+  if (compressed.format) {
+    texture_upload_compressed(decode.id, compressed);
+    bytes = compressed.data.size();
+  } else {
+    texture_upload(decode.id,
+                   decode.width,
+                   decode.height,
+                   decode.channels,
+                   decode.data);
+    bytes = texture_mip_chain_size(decode.width,
+                                   decode.height,
+                                   decode.channels);
+  }
 
-  // VBO
-  glGenBuffers(1, &VBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-  glBufferData(GL_ARRAY_BUFFER,
-               vertex_buffer_size,
-               vertices.data(),
-               GL_STATIC_DRAW);
-  // -- Position attribute
-  size_t vertex_size = 6 * sizeof(float);
-  void *pos_offset = (void *) 0;
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, pos_offset);
-  glEnableVertexAttribArray(0);
-  // -- Color attribute
-  void *color_offset = (void *) (3 * sizeof(float));
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, color_offset);
-  glEnableVertexAttribArray(1);
+  if (entry == NULL) {
+    return;
+  }
+  cache.resident_bytes = cache.resident_bytes - entry->bytes + bytes;
+  entry->format = compressed.format;
+  if (compressed.format) {
+    entry->width = compressed.width;
+    entry->height = compressed.height;
+    entry->channels = 0;
+    entry->nb_levels = compressed.level_sizes.size();
+  } else {
+    entry->width = decode.width;
+    entry->height = decode.height;
+    entry->channels = decode.channels;
+    entry->nb_levels = texture_nb_levels(decode.width, decode.height);
+  }
+  entry->dropped = 0;
+  entry->bytes = bytes;
+  entry->loading = false;
+  entry->failed = false;
+}
 
-  // Clean up
-  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-  glBindVertexArray(0);             // Unbind VAO
+int texture_load_file(const unsigned int texture_id, const std::string &path) {
+  gltexture_loader_cancel(texture_id);
+  gltexture_decode_t decode;
+  decode.id = texture_id;
+  texture_decode(path, decode);
+  texture_upload_decoded(decode);
+  stbi_image_free(decode.data);
+
+  return (decode.data || decode.compressed.format) ? 0 : -1;
 }
 
-glvoxels_t::~glvoxels_t() {}
+void texture_load_file_async(const unsigned int texture_id,
+                             const std::string &path) {
+  gltexture_loader_t &loader = gltexture_loader();
+  const uint64_t generation = ++loader.generation;
+  loader.requests[texture_id] = generation;
+  {
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    loader.nb_pending++;
+  }
 
-void glvoxels_t::draw(const glcamera_t &camera) {
-  program_.use();
-  program_.set("projection", camera.projection());
-  program_.set("view", camera.view());
-  program_.set("model", T_SM_);
+  gltexture_decode_pool().push([texture_id, generation, path]() {
+    gltexture_decode_t decode;
+    decode.id = texture_id;
+    decode.generation = generation;
+    texture_decode(path, decode);
+
+    gltexture_loader_t &loader = gltexture_loader();
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    loader.decoded.push_back(decode);
+    loader.cv.notify_all();
+  });
+}
 
-  // 12 x 3 indices starting at 0 -> 12 triangles -> 6 squares
-  glBindVertexArray(VAO_);
-  glDrawArrays(GL_TRIANGLES, 0, 36);
-  glBindVertexArray(0); // Unbind VAO
+unsigned int texture_from_file_async(const std::string &path) {
+  unsigned int texture_id;
+  glGenTextures(1, &texture_id);
+  texture_placeholder(texture_id);
+  texture_load_file_async(texture_id, path);
+
+  return texture_id;
 }
 
+size_t gltexture_loader_poll(const size_t max_uploads) {
+  gltexture_loader_t &loader = gltexture_loader();
+  std::vector<gltexture_decode_t> ready;
+  {
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    while (ready.size() < max_uploads && loader.decoded.size()) {
+      ready.push_back(loader.decoded.front());
+      loader.decoded.pop_front();
+    }
+  }
 
-glframe_t::glframe_t() : globj_t{shaders::glframe_vs, shaders::glframe_fs} {
-  // Vertices
-  // clang-format off
-  static const GLfloat vertices[] = {
-    // Line 1 : x-axis + color
-    0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-    1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-    // Line 2 : y-axis + color
-    0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-    0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-    // Line 3 : z-axis + color
-    0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
-    0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f
-  };
-  const size_t nb_vertices = 6;
-  const size_t buffer_size = sizeof(GLfloat) * 6 * nb_vertices;
-  // clang-format on
+  // Only the latest request for a texture uploads, requests cancelled or
+  // superseded while in flight are dropped even if GL reused the id
+  for (const auto &decode : ready) {
+    auto request = loader.requests.find(decode.id);
+    if (request != loader.requests.end() &&
+        request->second == decode.generation) {
+      loader.requests.erase(request);
+      texture_upload_decoded(decode);
+    }
+    stbi_image_free(decode.data);
+  }
 
-  // VAO
-  glGenVertexArrays(1, &VAO_);
-  glBindVertexArray(VAO_);
+  {
+    std::lock_guard<std::mutex> lock(loader.mutex);
+    loader.nb_pending -= ready.size();
+    loader.nb_uploaded += ready.size();
+  }
+  loader.cv.notify_all();
 
-  // VBO
-  glGenBuffers(1, &VBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-  glBufferData(GL_ARRAY_BUFFER, buffer_size, vertices, GL_STATIC_DRAW);
-  // -- Position attribute
-  size_t vertex_size = 6 * sizeof(float);
-  void *pos_offset = (void *) 0;
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, pos_offset);
-  glEnableVertexAttribArray(0);
-  // -- Color attribute
-  void *color_offset = (void *) (3 * sizeof(float));
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, color_offset);
-  glEnableVertexAttribArray(1);
+  return ready.size();
+}
 
-  // Clean up
-  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-  glBindVertexArray(0);             // Unbind VAO
+void gltexture_loader_finish() {
+  gltexture_loader_t &loader = gltexture_loader();
+  while (true) {
+    gltexture_loader_poll();
+
+    std::unique_lock<std::mutex> lock(loader.mutex);
+    if (loader.nb_pending == 0) {
+      return;
+    }
+    loader.cv.wait(lock, [&]() {
+      return loader.decoded.size() || loader.nb_pending == 0;
+    });
+  }
 }
 
-glframe_t::~glframe_t() {
-  glDeleteVertexArrays(1, &VAO_);
-  glDeleteBuffers(1, &VBO_);
+gltexture_cache_t &gltexture_cache() {
+  static gltexture_cache_t cache;
+  return cache;
 }
 
-void glframe_t::draw(const glcamera_t &camera) {
-  program_.use();
-  program_.set("projection", camera.projection());
-  program_.set("view", camera.view());
-  program_.set("model", T_SM_);
+unsigned int gltexture_acquire(const std::string &path, const bool async) {
+  gltexture_cache_t &cache = gltexture_cache();
 
-  // Store original line width
-  float original_line_width = 0.0f;
-  glGetFloatv(GL_LINE_WIDTH, &original_line_width);
+  // Canonical path, missing files keep theirs and fail to load once
+  std::string key = path;
+  char *resolved = realpath(path.c_str(), nullptr);
+  if (resolved) {
+    key = resolved;
+    free(resolved);
+  }
 
-  // Set line width
-  glLineWidth(line_width_);
+  auto path_it = cache.paths.find(key);
+  if (path_it != cache.paths.end()) {
+    cache.entries[path_it->second].refs++;
+    cache.hits++;
+    return path_it->second;
+  }
 
-  // Draw frame
-  glBindVertexArray(VAO_);
-  glDrawArrays(GL_LINES, 0, 6);
-  glBindVertexArray(0); // Unbind VAO
+  // Same bytes under another path
+  uint64_t hash = 0;
+  if (cache.hash_contents) {
+    std::string contents;
+    if (file_read(key, contents) == 0) {
+      hash = hash_fnv1a(contents.data(), contents.size());
+      auto hash_it = cache.hashes.find(hash);
+      if (hash_it != cache.hashes.end()) {
+        cache.paths[key] = hash_it->second;
+        cache.entries[hash_it->second].refs++;
+        cache.hits++;
+        return hash_it->second;
+      }
+    }
+  }
 
-  // Restore original line width
-  glLineWidth(original_line_width);
+  // Load on first use, the entry goes in first so the upload accounts it
+  unsigned int texture_id = 0;
+  glGenTextures(1, &texture_id);
+  texture_placeholder(texture_id);
+  cache.misses++;
+
+  gltexture_entry_t &entry = cache.entries[texture_id];
+  entry.id = texture_id;
+  entry.refs = 1;
+  entry.path = key;
+  entry.hash = hash;
+  entry.bytes = texture_mip_chain_size(1, 1, 4);
+  entry.last_used = cache.frame;
+  entry.loading = true;
+  cache.resident_bytes += entry.bytes;
+  cache.paths[key] = texture_id;
+  if (hash) {
+    cache.hashes[hash] = texture_id;
+  }
+
+  if (async) {
+    texture_load_file_async(texture_id, key);
+  } else {
+    texture_load_file(texture_id, key);
+  }
+
+  return texture_id;
 }
 
-static GLfloat *glgrid_create_vertices(int grid_size) {
-  // Allocate memory for vertices
-  int nb_lines = (grid_size + 1) * 2;
-  int nb_vertices = nb_lines * 2;
-  const size_t buffer_size = sizeof(GLfloat) * nb_vertices * 3;
-  GLfloat *vertices = (GLfloat *) malloc(buffer_size);
+void gltexture_release(const unsigned int texture_id) {
+  gltexture_cache_t &cache = gltexture_cache();
+  auto it = cache.entries.find(texture_id);
+  if (it == cache.entries.end()) {
+    return;
+  }
 
-  // Setup
-  const float min_x = -1.0f * (float) grid_size / 2.0f;
-  const float max_x = (float) grid_size / 2.0f;
-  const float min_z = -1.0f * (float) grid_size / 2.0f;
-  const float max_z = (float) grid_size / 2.0f;
+  gltexture_entry_t &entry = it->second;
+  if (--entry.refs) {
+    return;
+  }
 
-  // Row vertices
-  float z = min_z;
-  int vert_idx = 0;
-  for (int i = 0; i < ((grid_size + 1) * 2); i++) {
-    if ((i % 2) == 0) {
-      vertices[(vert_idx * 3)] = min_x;
-      vertices[(vert_idx * 3) + 1] = 0.0f;
-      vertices[(vert_idx * 3) + 2] = z;
+  // Drop every path and the hash resolving to this texture
+  for (auto path_it = cache.paths.begin(); path_it != cache.paths.end();) {
+    if (path_it->second == texture_id) {
+      path_it = cache.paths.erase(path_it);
     } else {
-      vertices[(vert_idx * 3)] = max_x;
-      vertices[(vert_idx * 3) + 1] = 0.0f;
-      vertices[(vert_idx * 3) + 2] = z;
-      z += 1.0f;
+      ++path_it;
     }
-    vert_idx++;
   }
+  if (entry.hash) {
+    cache.hashes.erase(entry.hash);
+  }
+  cache.resident_bytes -= entry.bytes;
+  cache.reload_bytes -= entry.reload_bytes;
+  cache.entries.erase(it);
+  gltexture_loader_cancel(texture_id);
+  glDeleteTextures(1, &texture_id);
+}
 
-  // Column vertices
-  float x = min_x;
-  for (int j = 0; j < ((grid_size + 1) * 2); j++) {
-    if ((j % 2) == 0) {
-      vertices[(vert_idx * 3)] = x;
-      vertices[(vert_idx * 3) + 1] = 0.0f;
-      vertices[(vert_idx * 3) + 2] = min_z;
-    } else {
-      vertices[(vert_idx * 3)] = x;
-      vertices[(vert_idx * 3) + 1] = 0.0f;
-      vertices[(vert_idx * 3) + 2] = max_z;
-      x += 1.0f;
-    }
-    vert_idx++;
+// GPU bytes of a texture with its full mip chain resident
+static size_t gltexture_full_bytes(const gltexture_entry_t &entry) {
+  if (entry.format == 0) {
+    return texture_mip_chain_size(entry.width, entry.height, entry.channels);
   }
 
-  return vertices;
+  size_t bytes = 0;
+  for (int i = 0; i < entry.nb_levels; i++) {
+    bytes += texture_level_size(entry.format,
+                                std::max(entry.width >> i, 1),
+                                std::max(entry.height >> i, 1));
+  }
+  return bytes;
 }
 
-glgrid_t::glgrid_t() : globj_t{shaders::glgrid_vs, shaders::glgrid_fs} {
-  // Create vertices
-  const int nb_lines = (grid_size_ + 1) * 2;
-  const int nb_vertices = nb_lines * 2;
-  GLfloat *vertices = glgrid_create_vertices(grid_size_);
-  const size_t buffer_size = sizeof(GLfloat) * nb_vertices * 3;
+void gltexture_bind(const unsigned int texture_id) {
+  glBindTexture(GL_TEXTURE_2D, texture_id);
 
-  // VAO
-  glGenVertexArrays(1, &VAO_);
-  glBindVertexArray(VAO_);
+  gltexture_cache_t &cache = gltexture_cache();
+  auto it = cache.entries.find(texture_id);
+  if (it == cache.entries.end()) {
+    return;
+  }
 
-  // VBO
-  glGenBuffers(1, &VBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-  glBufferData(GL_ARRAY_BUFFER, buffer_size, vertices, GL_STATIC_DRAW);
-  glVertexAttribPointer(0,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        3 * sizeof(float),
-                        (void *) 0);
-  glEnableVertexAttribArray(0);
+  // Evicted textures keep drawing what is left until the reload lands
+  gltexture_entry_t &entry = it->second;
+  entry.last_used = cache.frame;
+  if (entry.dropped == 0 || entry.loading || entry.failed) {
+    return;
+  }
 
-  // Clean up
-  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
-  glBindVertexArray(0);             // Unbind VAO
-  free(vertices);
+  // Reload only if the full texture fits next to what is resident and what
+  // other reloads will add, otherwise the next trim would evict it again
+  const size_t full_bytes = gltexture_full_bytes(entry);
+  const size_t growth = full_bytes - std::min(full_bytes, entry.bytes);
+  if (cache.budget &&
+      cache.resident_bytes + cache.reload_bytes + growth > cache.budget) {
+    return;
+  }
+  entry.loading = true;
+  entry.reload_bytes = growth;
+  cache.reload_bytes += growth;
+  cache.reloads++;
+  texture_load_file_async(entry.id, entry.path);
 }
 
-glgrid_t::~glgrid_t() {
-  glDeleteVertexArrays(1, &VAO_);
-  glDeleteBuffers(1, &VBO_);
+// Re-specify a texture from its own lower mips, dropping the top `levels`
+static void gltexture_drop_levels(gltexture_entry_t &entry, const int levels) {
+  const int width = std::max(entry.width >> entry.dropped, 1);
+  const int height = std::max(entry.height >> entry.dropped, 1);
+  const int nb_resident = entry.nb_levels - entry.dropped;
+  const int w = std::max(width >> levels, 1);
+  const int h = std::max(height >> levels, 1);
+
+  size_t bytes = 0;
+  glBindTexture(GL_TEXTURE_2D, entry.id);
+  if (entry.format) {
+    gltexture_compressed_t reduced;
+    reduced.format = entry.format;
+    reduced.width = w;
+    reduced.height = h;
+    for (int i = levels; i < nb_resident; i++) {
+      const int lw = std::max(width >> i, 1);
+      const int lh = std::max(height >> i, 1);
+      const size_t offset = reduced.data.size();
+      const size_t size = texture_level_size(entry.format, lw, lh);
+      reduced.level_offsets.push_back(offset);
+      reduced.level_sizes.push_back(size);
+      reduced.data.resize(offset + size);
+      glGetCompressedTexImage(GL_TEXTURE_2D, i, reduced.data.data() + offset);
+    }
+    texture_upload_compressed(entry.id, reduced);
+    bytes = reduced.data.size();
+  } else {
+    const GLenum format = texture_format(entry.channels);
+    std::vector<uint8_t> pixels(w * h * entry.channels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D,
+                  levels,
+                  format,
+                  GL_UNSIGNED_BYTE,
+                  pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    texture_upload(entry.id, w, h, entry.channels, pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    bytes = texture_mip_chain_size(w, h, entry.channels);
+  }
+
+  gltexture_cache_t &cache = gltexture_cache();
+  cache.resident_bytes = cache.resident_bytes - entry.bytes + bytes;
+  entry.bytes = bytes;
+  entry.dropped += levels;
 }
 
-void glgrid_t::draw(const glcamera_t &camera) {
-  program_.use();
-  program_.set("projection", camera.projection());
-  program_.set("view", camera.view());
-  program_.set("model", T_SM_);
+void gltexture_cache_trim() {
+  gltexture_cache_t &cache = gltexture_cache();
+  const uint64_t frame = cache.frame++;
+  if (cache.budget == 0 || cache.resident_bytes <= cache.budget) {
+    return;
+  }
 
-  const int nb_lines = (grid_size_ + 1) * 2;
-  const int nb_vertices = nb_lines * 2;
+  // Least recently bound first, skipping textures bound this frame, in
+  // flight or already down to the placeholder
+  std::vector<gltexture_entry_t *> lru;
+  for (auto &kv : cache.entries) {
+    gltexture_entry_t &entry = kv.second;
+    if (entry.last_used < frame && entry.loading == false &&
+        entry.dropped >= 0 && entry.width > 0) {
+      lru.push_back(&entry);
+    }
+  }
+  std::sort(lru.begin(),
+            lru.end(),
+            [](const gltexture_entry_t *a, const gltexture_entry_t *b) {
+              return a->last_used < b->last_used;
+            });
+
+  // Lower mips first, placeholders only if that is not enough
+  const int levels = std::max(cache.evict_levels, 1);
+  for (auto entry : lru) {
+    if (cache.resident_bytes <= cache.budget) {
+      return;
+    }
+    if (entry->nb_levels - entry->dropped > levels) {
+      gltexture_drop_levels(*entry, levels);
+      cache.evictions++;
+    }
+  }
+  for (auto entry : lru) {
+    if (cache.resident_bytes <= cache.budget) {
+      return;
+    }
+    const size_t bytes = texture_mip_chain_size(1, 1, 4);
+    texture_placeholder(entry->id);
+    cache.resident_bytes = cache.resident_bytes - entry->bytes + bytes;
+    entry->bytes = bytes;
+    entry->dropped = -1;
+    cache.evictions++;
+  }
+}
 
-  glBindVertexArray(VAO_);
-  glDrawArrays(GL_LINES, 0, nb_vertices);
-  glBindVertexArray(0); // Unbind VAO
+gltexture_residency_t gltexture_cache_residency() {
+  const gltexture_cache_t &cache = gltexture_cache();
+  gltexture_residency_t residency;
+  residency.nb_textures = cache.entries.size();
+  residency.resident_bytes = cache.resident_bytes;
+  residency.budget = cache.budget;
+  residency.evictions = cache.evictions;
+  residency.reloads = cache.reloads;
+
+  for (const auto &kv : cache.entries) {
+    const gltexture_entry_t &entry = kv.second;
+    residency.nb_loading += entry.loading;
+    if (entry.dropped < 0) {
+      residency.nb_placeholder++;
+    } else if (entry.dropped > 0) {
+      residency.nb_reduced++;
+    } else if (entry.width > 0) {
+      residency.nb_full++;
+    }
+
+    residency.full_bytes += gltexture_full_bytes(entry);
+  }
+
+  return residency;
 }
 
-glplane_t::glplane_t(const std::string &image_path)
-    : globj_t{shaders::glplane_vs, shaders::glplane_fs}, image_path_{
-                                                             image_path} {
-  // clang-format off
-  const float vertices[] = {
-    // Positions         // Colors           // Texture coords
-    0.5f,  0.5f,  0.0f,  1.0f, 1.0f, 1.0f,   1.0f, 1.0f,  // Top right
-    0.5f, -0.5f,  0.0f,  1.0f, 1.0f, 1.0f,   1.0f, 0.0f,  // Bottom right
-    -0.5f, -0.5f, 0.0f,  1.0f, 1.0f, 1.0f,   0.0f, 0.0f,  // Bottom left
-    -0.5f,  0.5f, 0.0f,  1.0f, 1.0f, 1.0f,   0.0f, 1.0f   // Top left
-  };
-  const unsigned int indices[] = {
-    0, 1, 3, // first triangle
-    1, 2, 3  // second triangle
-  };
-  // clang-format on
+void gltexture_cache_print_stats() {
+  const gltexture_cache_t &cache = gltexture_cache();
+  LOG_INFO("Texture cache: %zu textures, %zu hits, %zu misses",
+           cache.entries.size(),
+           cache.hits,
+           cache.misses);
+
+  const gltexture_residency_t r = gltexture_cache_residency();
+  const double MB = 1024.0 * 1024.0;
+  LOG_INFO("Texture residency: %zu full, %zu reduced, %zu placeholder, "
+           "%zu loading, %.1f / %.1f MB resident (budget %.1f MB), "
+           "%zu evictions, %zu reloads",
+           r.nb_full,
+           r.nb_reduced,
+           r.nb_placeholder,
+           r.nb_loading,
+           r.resident_bytes / MB,
+           r.full_bytes / MB,
+           r.budget / MB,
+           r.evictions,
+           r.reloads);
+}
 
-  // VAO
-  glGenVertexArrays(1, &VAO_);
-  glBindVertexArray(VAO_);
+/*****************************************************************************
+ *                                 MESH
+ ****************************************************************************/
 
-  // VBO
-  glGenBuffers(1, &VBO_);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  // -- Position attribute
-  const void *pos_offset = (void *) 0;
+size_t glvertex_size(const glvertex_layout_t layout) {
+  switch (layout) {
+    case GLVERTEX_COMPACT: return sizeof(glvertex_compact_t);
+    case GLVERTEX_COMPACT_QPOS: return sizeof(glvertex_qpos_t);
+    default: return sizeof(glvertex_t);
+  }
+}
+
+static GLshort snorm16(const float v) {
+  return (GLshort) std::round(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+}
+
+// Octahedral encoding of a direction into [-1, 1]^2
+static glm::vec2 oct_encode(const glm::vec3 &v) {
+  const float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+  if (l1 == 0.0f) {
+    return glm::vec2(0.0f);
+  }
+
+  glm::vec2 e{v.x / l1, v.y / l1};
+  if (v.z < 0.0f) {
+    e = glm::vec2{(1.0f - std::fabs(e.y)) * ((e.x >= 0.0f) ? 1.0f : -1.0f),
+                  (1.0f - std::fabs(e.x)) * ((e.y >= 0.0f) ? 1.0f : -1.0f)};
+  }
+  return e;
+}
+
+static glm::vec3 oct_decode(const glm::vec2 &e) {
+  glm::vec3 n{e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y)};
+  const float t = std::max(-n.z, 0.0f);
+  n.x += (n.x >= 0.0f) ? -t : t;
+  n.y += (n.y >= 0.0f) ? -t : t;
+  return glm::normalize(n);
+}
+
+// Normal and tangent of a compact vertex, the bitangent sign replaces the
+// sign of the tangent's second component
+template <typename T>
+static void glvertex_pack_tbn(const glvertex_t &src, T &dst) {
+  const glm::vec2 n = oct_encode(src.normal);
+  const glm::vec2 t = oct_encode(src.tangent);
+  const glm::vec3 b = glm::cross(src.normal, src.tangent);
+  const bool flip = glm::dot(b, src.bitangent) < 0.0f;
+  const float t_y = std::max((t.y + 1.0f) * 0.5f, 1.0f / 32767.0f);
+
+  dst.normal[0] = snorm16(n.x);
+  dst.normal[1] = snorm16(n.y);
+  dst.tangent[0] = snorm16(t.x);
+  dst.tangent[1] = snorm16((flip) ? -t_y : t_y);
+  dst.texcoords[0] = glm::packHalf1x16(src.texcoords.x);
+  dst.texcoords[1] = glm::packHalf1x16(src.texcoords.y);
+}
+
+template <typename T>
+static void glvertex_unpack_tbn(const T &src, glvertex_t &dst) {
+  const glm::vec2 n{src.normal[0] / 32767.0f, src.normal[1] / 32767.0f};
+  const float t_y = src.tangent[1] / 32767.0f;
+  const glm::vec2 t{src.tangent[0] / 32767.0f, std::fabs(t_y) * 2.0f - 1.0f};
+
+  dst.normal = oct_decode(n);
+  dst.tangent = oct_decode(t);
+  dst.bitangent = glm::cross(dst.normal, dst.tangent);
+  dst.bitangent *= (t_y < 0.0f) ? -1.0f : 1.0f;
+  dst.texcoords.x = glm::unpackHalf1x16(src.texcoords[0]);
+  dst.texcoords.y = glm::unpackHalf1x16(src.texcoords[1]);
+}
+
+void glvertices_pack(const std::vector<glvertex_t> &src,
+                     const glvertex_layout_t layout,
+                     glvertices_t &dst) {
+  // Quantize positions against the mesh bounds
+  glm::vec3 min{FLT_MAX};
+  glm::vec3 max{-FLT_MAX};
+  if (layout == GLVERTEX_COMPACT_QPOS) {
+    for (const auto &v : src) {
+      min = glm::min(min, v.position);
+      max = glm::max(max, v.position);
+    }
+  }
+  if (src.empty()) {
+    min = glm::vec3(0.0f);
+    max = glm::vec3(0.0f);
+  }
+  glvertices_pack(src, layout, min, max, dst);
+}
+
+void glvertices_pack(const std::vector<glvertex_t> &src,
+                     const glvertex_layout_t layout,
+                     const glm::vec3 &bounds_min,
+                     const glm::vec3 &bounds_max,
+                     glvertices_t &dst) {
+  dst.layout = layout;
+  dst.size = src.size();
+  dst.data.resize(src.size() * glvertex_size(layout));
+  dst.pos_offset = glm::vec3(0.0f);
+  dst.pos_scale = glm::vec3(1.0f);
+
+  switch (layout) {
+    case GLVERTEX_FULL: {
+      memcpy(dst.data.data(), src.data(), dst.data.size());
+      break;
+    }
+
+    case GLVERTEX_COMPACT: {
+      glvertex_compact_t *vertices = (glvertex_compact_t *) dst.data.data();
+      for (size_t i = 0; i < src.size(); i++) {
+        vertices[i].position = src[i].position;
+        glvertex_pack_tbn(src[i], vertices[i]);
+      }
+      break;
+    }
+
+    case GLVERTEX_COMPACT_QPOS: {
+      // Positions relative to the bounds
+      dst.pos_offset = bounds_min;
+      dst.pos_scale = bounds_max - bounds_min;
+
+      glvertex_qpos_t *vertices = (glvertex_qpos_t *) dst.data.data();
+      for (size_t i = 0; i < src.size(); i++) {
+        for (int j = 0; j < 3; j++) {
+          const float scale = dst.pos_scale[j];
+          const float r = (src[i].position[j] - bounds_min[j]) / scale;
+          const float c = std::min(std::max(r, 0.0f), 1.0f);
+          const float q = (scale > 0.0f) ? std::round(c * 65535.0f) : 0.0f;
+          vertices[i].position[j] = (GLushort) q;
+        }
+        vertices[i].position[3] = 0;
+        glvertex_pack_tbn(src[i], vertices[i]);
+      }
+      break;
+    }
+  }
+}
+
+void glvertices_unpack(const glvertices_t &src, std::vector<glvertex_t> &dst) {
+  dst.resize(src.size);
+
+  switch (src.layout) {
+    case GLVERTEX_FULL: {
+      memcpy(dst.data(), src.data.data(), src.size * sizeof(glvertex_t));
+      break;
+    }
+
+    case GLVERTEX_COMPACT: {
+      const auto *vertices = (const glvertex_compact_t *) src.data.data();
+      for (size_t i = 0; i < src.size; i++) {
+        dst[i].position = vertices[i].position;
+        glvertex_unpack_tbn(vertices[i], dst[i]);
+      }
+      break;
+    }
+
+    case GLVERTEX_COMPACT_QPOS: {
+      const auto *vertices = (const glvertex_qpos_t *) src.data.data();
+      for (size_t i = 0; i < src.size; i++) {
+        const glm::vec3 q{vertices[i].position[0] / 65535.0f,
+                          vertices[i].position[1] / 65535.0f,
+                          vertices[i].position[2] / 65535.0f};
+        dst[i].position = src.pos_offset + q * src.pos_scale;
+        glvertex_unpack_tbn(vertices[i], dst[i]);
+      }
+      break;
+    }
+  }
+}
+
+size_t glindex_size(const GLenum type) {
+  return (type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+// 32-bit indices, a single range
+static void glindices_pack_uint(const std::vector<unsigned int> &src,
+                                glindices_t &dst) {
+  dst.type = GL_UNSIGNED_INT;
+  dst.data.resize(src.size() * sizeof(GLuint));
+  memcpy(dst.data.data(), src.data(), dst.data.size());
+  dst.ranges.clear();
+  dst.ranges.push_back({0, src.size(), 0});
+}
+
+void glindices_pack(const std::vector<unsigned int> &src,
+                    const size_t nb_vertices,
+                    const bool split,
+                    glindices_t &dst) {
+  const size_t max_vertices = 65536;
+  dst.size = src.size();
+  dst.ranges.clear();
+
+  if (nb_vertices > max_vertices && split == false) {
+    glindices_pack_uint(src, dst);
+    return;
+  }
+
+  // Group whole triangles while the vertices they reference fit in 16 bits,
+  // optimized meshes reference vertices in order so the ranges stay few
+  if (nb_vertices > max_vertices) {
+    glindex_range_t range;
+    unsigned int lo = 0;
+    unsigned int hi = 0;
+    for (size_t i = 0; i + 2 < src.size(); i += 3) {
+      const unsigned int tri_lo = std::min({src[i], src[i + 1], src[i + 2]});
+      const unsigned int tri_hi = std::max({src[i], src[i + 1], src[i + 2]});
+      if (tri_hi - tri_lo >= max_vertices) {
+        // A single triangle spans more than 16 bits, no split can hold it
+        glindices_pack_uint(src, dst);
+        return;
+      }
+      const unsigned int span = std::max(hi, tri_hi) - std::min(lo, tri_lo);
+      if (range.count && span >= max_vertices) {
+        range.base_vertex = lo;
+        dst.ranges.push_back(range);
+        range.offset = i;
+        range.count = 0;
+      }
+      lo = (range.count) ? std::min(lo, tri_lo) : tri_lo;
+      hi = (range.count) ? std::max(hi, tri_hi) : tri_hi;
+      range.count += 3;
+    }
+    if (range.count) {
+      range.base_vertex = lo;
+      dst.ranges.push_back(range);
+    }
+  } else {
+    dst.ranges.push_back({0, src.size(), 0});
+  }
+
+  // 16-bit indices relative to each range's base vertex
+  dst.type = GL_UNSIGNED_SHORT;
+  dst.data.resize(src.size() * sizeof(GLushort));
+  GLushort *data = (GLushort *) dst.data.data();
+  for (const auto &range : dst.ranges) {
+    for (size_t i = range.offset; i < range.offset + range.count; i++) {
+      data[i] = src[i] - range.base_vertex;
+    }
+  }
+}
+
+void glindices_unpack(const glindices_t &src, std::vector<unsigned int> &dst) {
+  dst.resize(src.size);
+  if (src.type == GL_UNSIGNED_INT) {
+    memcpy(dst.data(), src.data.data(), src.size * sizeof(GLuint));
+    return;
+  }
+
+  const GLushort *data = (const GLushort *) src.data.data();
+  for (const auto &range : src.ranges) {
+    for (size_t i = range.offset; i < range.offset + range.count; i++) {
+      dst[i] = data[i] + range.base_vertex;
+    }
+  }
+}
+
+glmesh_t::glmesh_t(const std::vector<glvertex_t> &vertices_,
+                   const std::vector<unsigned int> &indices_,
+                   std::vector<gltexture_t> textures_,
+                   const bool split_indices,
+                   const bool keep_geometry)
+    : textures{std::move(textures_)} {
+  glvertices_pack(vertices_, GLVERTEX_FULL, vertices);
+  glindices_pack(indices_, vertices.size, split_indices, indices);
+  glmesh_init(*this);
+  if (keep_geometry == false) {
+    glmesh_release_geometry(*this);
+  }
+}
+
+glmesh_t::glmesh_t(glvertices_t vertices_,
+                   const std::vector<unsigned int> &indices_,
+                   std::vector<gltexture_t> textures_,
+                   const bool split_indices,
+                   const bool keep_geometry)
+    : vertices{std::move(vertices_)}, textures{std::move(textures_)} {
+  glindices_pack(indices_, vertices.size, split_indices, indices);
+  glmesh_init(*this);
+  if (keep_geometry == false) {
+    glmesh_release_geometry(*this);
+  }
+}
+
+glmesh_t::glmesh_t(glvertices_t vertices_,
+                   glindices_t indices_,
+                   std::vector<gltexture_t> textures_,
+                   const bool keep_geometry)
+    : vertices{std::move(vertices_)}, indices{std::move(indices_)},
+      textures{std::move(textures_)} {
+  glmesh_init(*this);
+  if (keep_geometry == false) {
+    glmesh_release_geometry(*this);
+  }
+}
+
+glmesh_t::glmesh_t(glmesh_t &&other) noexcept {
+  *this = std::move(other);
+}
+
+glmesh_t::~glmesh_t() {
+  // Moved from meshes no longer own any GL objects
+  if (VAO) {
+    glDeleteVertexArrays(1, &VAO);
+  }
+  if (VBO) {
+    glDeleteBuffers(1, &VBO);
+  }
+  if (EBO) {
+    glDeleteBuffers(1, &EBO);
+  }
+}
+
+glmesh_t &glmesh_t::operator=(glmesh_t &&other) noexcept {
+  // Swap so that our previous GL objects are freed with `other`
+  std::swap(vertices, other.vertices);
+  std::swap(indices, other.indices);
+  std::swap(textures, other.textures);
+  std::swap(sampler_locs, other.sampler_locs);
+  std::swap(pos_offset_loc, other.pos_offset_loc);
+  std::swap(pos_scale_loc, other.pos_scale_loc);
+  std::swap(program_id, other.program_id);
+  std::swap(VAO, other.VAO);
+  std::swap(VBO, other.VBO);
+  std::swap(EBO, other.EBO);
+  return *this;
+}
+
+static void glmesh_full_attributes() {
+  // Vertex positions
+  glEnableVertexAttribArray(0);
   glVertexAttribPointer(0,
                         3,
                         GL_FLOAT,
                         GL_FALSE,
-                        8 * sizeof(float),
-                        pos_offset);
-  glEnableVertexAttribArray(0);
-  // -- Color attribute
-  void *color_offset = (void *) (3 * sizeof(float));
+                        sizeof(glvertex_t),
+                        (void *) 0);
+
+  // Vertex normals
+  glEnableVertexAttribArray(1);
   glVertexAttribPointer(1,
                         3,
                         GL_FLOAT,
                         GL_FALSE,
-                        8 * sizeof(float),
-                        color_offset);
-  glEnableVertexAttribArray(1);
-  // -- Texture coord attribute
-  void *texture_offset = (void *) (6 * sizeof(float));
+                        sizeof(glvertex_t),
+                        (void *) offsetof(glvertex_t, normal));
+
+  // Vertex texture coords
+  glEnableVertexAttribArray(2);
   glVertexAttribPointer(2,
                         2,
                         GL_FLOAT,
                         GL_FALSE,
-                        8 * sizeof(float),
-                        texture_offset);
+                        sizeof(glvertex_t),
+                        (void *) offsetof(glvertex_t, texcoords));
+
+  // Vertex tangent
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        sizeof(glvertex_t),
+                        (void *) offsetof(glvertex_t, tangent));
+
+  // Vertex bitangent
+  glEnableVertexAttribArray(4);
+  glVertexAttribPointer(4,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        sizeof(glvertex_t),
+                        (void *) offsetof(glvertex_t, bitangent));
+}
+
+template <typename T>
+static void glmesh_compact_attributes() {
+  // Vertex positions, normalized to the mesh bounds when quantized
+  const bool qpos = std::is_same<T, glvertex_qpos_t>::value;
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0,
+                        3,
+                        (qpos) ? GL_UNSIGNED_SHORT : GL_FLOAT,
+                        (qpos) ? GL_TRUE : GL_FALSE,
+                        sizeof(T),
+                        (void *) offsetof(T, position));
+
+  // Vertex normals (octahedral)
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1,
+                        2,
+                        GL_SHORT,
+                        GL_TRUE,
+                        sizeof(T),
+                        (void *) offsetof(T, normal));
+
+  // Vertex texture coords
   glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2,
+                        2,
+                        GL_HALF_FLOAT,
+                        GL_FALSE,
+                        sizeof(T),
+                        (void *) offsetof(T, texcoords));
+
+  // Vertex tangent (octahedral) and bitangent sign
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3,
+                        2,
+                        GL_SHORT,
+                        GL_TRUE,
+                        sizeof(T),
+                        (void *) offsetof(T, tangent));
+}
+
+static void glmesh_attributes(const glvertex_layout_t layout) {
+  switch (layout) {
+    case GLVERTEX_FULL:
+      glmesh_full_attributes();
+      break;
+    case GLVERTEX_COMPACT:
+      glmesh_compact_attributes<glvertex_compact_t>();
+      break;
+    case GLVERTEX_COMPACT_QPOS:
+      glmesh_compact_attributes<glvertex_qpos_t>();
+      break;
+  }
+}
+
+void glmesh_init(glmesh_t &mesh) {
+  // Load data into vertex buffers
+  // -- VAO
+  glGenVertexArrays(1, &mesh.VAO);
+  glBindVertexArray(mesh.VAO);
+
+  // -- VBO
+  glGenBuffers(1, &mesh.VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+  glBufferData(GL_ARRAY_BUFFER,
+               mesh.vertices.data.size(),
+               mesh.vertices.data.data(),
+               GL_STATIC_DRAW);
+
+  // -- EBO
+  glGenBuffers(1, &mesh.EBO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               mesh.indices.data.size(),
+               mesh.indices.data.data(),
+               GL_STATIC_DRAW);
+
+  // Set vertex attribute pointers
+  glmesh_attributes(mesh.vertices.layout);
+
+  glBindVertexArray(0);
+}
+
+void glmesh_release_geometry(glmesh_t &mesh) {
+  // Sizes, layout and draw ranges are kept, only the bytes are released
+  std::vector<uint8_t>().swap(mesh.vertices.data);
+  std::vector<uint8_t>().swap(mesh.indices.data);
+}
+
+static std::vector<std::string>
+glmesh_sampler_names(const std::vector<gltexture_t> &textures) {
+  // Samplers follow the naming convention "<type>N", e.g. texture_diffuse1
+  unsigned int diffuse_counter = 1;
+  unsigned int specular_counter = 1;
+  unsigned int normal_counter = 1;
+  unsigned int height_counter = 1;
+
+  std::vector<std::string> names;
+  for (size_t i = 0; i < textures.size(); i++) {
+    // Retrieve texture number (the N in diffuse_textureN)
+    std::string number;
+    std::string name = textures[i].type;
+    if (name == "texture_diffuse") {
+      number = std::to_string(diffuse_counter++);
+    } else if (name == "texture_specular") {
+      number = std::to_string(specular_counter++);
+    } else if (name == "texture_normal") {
+      number = std::to_string(normal_counter++);
+    } else if (name == "texture_height") {
+      number = std::to_string(height_counter++);
+    }
+    names.push_back(name + number);
+  }
+
+  return names;
+}
+
+void glmesh_bind(glmesh_t &mesh, const glprog_t &program) {
+  mesh.sampler_locs.clear();
+  for (const auto &name : glmesh_sampler_names(mesh.textures)) {
+    mesh.sampler_locs.push_back(program.uniform(name));
+  }
+  mesh.pos_offset_loc = program.uniform("pos_offset");
+  mesh.pos_scale_loc = program.uniform("pos_scale");
+  mesh.program_id = program.program_id;
+}
+
+void glmesh_draw(const glmesh_t &mesh, const glprog_t &program) {
+  // Resolve uniform locations if the mesh was not bound to this program
+  const std::vector<gluniform_handle_t> *sampler_locs = &mesh.sampler_locs;
+  gluniform_handle_t pos_offset_loc = mesh.pos_offset_loc;
+  gluniform_handle_t pos_scale_loc = mesh.pos_scale_loc;
+  std::vector<gluniform_handle_t> resolved;
+  if (mesh.program_id != program.program_id) {
+    for (const auto &name : glmesh_sampler_names(mesh.textures)) {
+      resolved.push_back(program.uniform(name));
+    }
+    sampler_locs = &resolved;
+    pos_offset_loc = program.uniform("pos_offset");
+    pos_scale_loc = program.uniform("pos_scale");
+  }
+
+  // Quantized positions are restored in the vertex shader
+  program.set(pos_offset_loc, mesh.vertices.pos_offset);
+  program.set(pos_scale_loc, mesh.vertices.pos_scale);
+
+  for (size_t i = 0; i < mesh.textures.size(); i++) {
+    // Acitivate proper texture unit before binding
+    glActiveTexture(GL_TEXTURE0 + i);
+
+    // Set the sampler to the correct texture unit and bind texture
+    program.set((*sampler_locs)[i], (int) i);
+    gltexture_bind(mesh.textures[i].id);
+  }
+
+  // Draw mesh
+  const size_t index_size = glindex_size(mesh.indices.type);
+  glBindVertexArray(mesh.VAO);
+  for (const auto &range : mesh.indices.ranges) {
+    const void *offset = (void *) (range.offset * index_size);
+    if (range.base_vertex == 0) {
+      glDrawElements(GL_TRIANGLES, range.count, mesh.indices.type, offset);
+    } else {
+      glDrawElementsBaseVertex(GL_TRIANGLES,
+                               range.count,
+                               mesh.indices.type,
+                               offset,
+                               range.base_vertex);
+    }
+  }
+  glBindVertexArray(0);
+
+  // Set everything back to defaults once configured
+  glActiveTexture(GL_TEXTURE0);
+}
+
+float glmesh_acmr(const std::vector<unsigned int> &indices,
+                  const size_t nb_vertices,
+                  const int cache_size) {
+  if (indices.size() < 3) {
+    return 0.0f;
+  }
+
+  // FIFO cache, a vertex is cached if it entered within the last N misses
+  std::vector<size_t> entered(nb_vertices, 0);
+  size_t nb_misses = 0;
+  for (const auto v : indices) {
+    if (entered[v] == 0 || nb_misses - entered[v] + 1 > (size_t) cache_size) {
+      nb_misses++;
+      entered[v] = nb_misses;
+    }
+  }
+
+  return nb_misses / (float) (indices.size() / 3);
+}
+
+void glmesh_weld(std::vector<glvertex_t> &vertices,
+                 std::vector<unsigned int> &indices) {
+  std::unordered_map<uint64_t, std::vector<unsigned int>> buckets;
+  buckets.reserve(vertices.size());
+  std::vector<unsigned int> remap(vertices.size());
+  std::vector<glvertex_t> welded;
+  welded.reserve(vertices.size());
+
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const glvertex_t &v = vertices[i];
+    auto &bucket = buckets[hash_fnv1a(&v, sizeof(glvertex_t))];
+
+    // Hash collisions are resolved by comparing the vertex bytes
+    bool found = false;
+    for (const auto idx : bucket) {
+      if (memcmp(&welded[idx], &v, sizeof(glvertex_t)) == 0) {
+        remap[i] = idx;
+        found = true;
+        break;
+      }
+    }
+    if (found == false) {
+      remap[i] = welded.size();
+      bucket.push_back(welded.size());
+      welded.push_back(v);
+    }
+  }
+
+  for (auto &idx : indices) {
+    idx = remap[idx];
+  }
+  vertices.swap(welded);
+}
+
+// Next fanning vertex of Tipsify: the candidate that stays longest in the
+// cache while its remaining triangles are emitted, else the most recent
+// dead-end or the next vertex with triangles left
+static int glmesh_tipsify_next(const std::vector<unsigned int> &candidates,
+                               const std::vector<int> &live,
+                               const std::vector<size_t> &timestamps,
+                               const size_t time,
+                               const int cache_size,
+                               std::vector<unsigned int> &dead_ends,
+                               size_t &cursor) {
+  int best = -1;
+  int best_priority = -1;
+  for (const auto v : candidates) {
+    if (live[v] <= 0) {
+      continue;
+    }
+    int priority = 0;
+    if (time - timestamps[v] + 2 * live[v] <= (size_t) cache_size) {
+      priority = time - timestamps[v];
+    }
+    if (priority > best_priority) {
+      best = v;
+      best_priority = priority;
+    }
+  }
+  if (best != -1) {
+    return best;
+  }
+
+  while (dead_ends.size()) {
+    const unsigned int v = dead_ends.back();
+    dead_ends.pop_back();
+    if (live[v] > 0) {
+      return v;
+    }
+  }
+  for (; cursor < live.size(); cursor++) {
+    if (live[cursor] > 0) {
+      return cursor;
+    }
+  }
+
+  return -1;
+}
+
+std::vector<size_t> glmesh_tipsify(std::vector<unsigned int> &indices,
+                                   const size_t nb_vertices,
+                                   const int cache_size) {
+  std::vector<size_t> clusters;
+  const size_t nb_triangles = indices.size() / 3;
+  if (nb_triangles == 0) {
+    return clusters;
+  }
+
+  // Vertex to triangle adjacency
+  std::vector<int> live(nb_vertices, 0);
+  for (const auto v : indices) {
+    live[v]++;
+  }
+  std::vector<size_t> offsets(nb_vertices + 1, 0);
+  for (size_t v = 0; v < nb_vertices; v++) {
+    offsets[v + 1] = offsets[v] + live[v];
+  }
+  std::vector<unsigned int> adjacency(indices.size());
+  std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t t = 0; t < nb_triangles; t++) {
+    for (int j = 0; j < 3; j++) {
+      adjacency[fill[indices[t * 3 + j]]++] = t;
+    }
+  }
+
+  std::vector<size_t> timestamps(nb_vertices, 0);
+  std::vector<bool> emitted(nb_triangles, false);
+  std::vector<unsigned int> dead_ends;
+  std::vector<unsigned int> candidates;
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  size_t time = cache_size + 1;
+  size_t cursor = 0;
+
+  int fan = indices[0];
+  while (fan >= 0) {
+    // Clusters start wherever the fanning vertex is no longer cached
+    if (time - timestamps[fan] > (size_t) cache_size) {
+      clusters.push_back(output.size() / 3);
+    }
+
+    // Emit all remaining triangles around the fanning vertex
+    candidates.clear();
+    for (size_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+      const unsigned int t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (int j = 0; j < 3; j++) {
+        const unsigned int v = indices[t * 3 + j];
+        output.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - timestamps[v] > (size_t) cache_size) {
+          timestamps[v] = time;
+          time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    fan = glmesh_tipsify_next(candidates,
+                              live,
+                              timestamps,
+                              time,
+                              cache_size,
+                              dead_ends,
+                              cursor);
+  }
+  indices.swap(output);
+
+  return clusters;
+}
+
+void glmesh_sort_clusters(const std::vector<glvertex_t> &vertices,
+                          std::vector<unsigned int> &indices,
+                          const std::vector<size_t> &clusters) {
+  const size_t nb_triangles = indices.size() / 3;
+  if (clusters.size() < 2) {
+    return;
+  }
+
+  // Area weighted centroid and normal of the mesh and every cluster
+  struct cluster_t {
+    size_t begin;
+    size_t end;
+    glm::vec3 centroid;
+    glm::vec3 normal;
+    float sort_key;
+  };
+  std::vector<cluster_t> sorted;
+  glm::vec3 mesh_centroid{0.0f};
+  float mesh_area = 0.0f;
+  for (size_t c = 0; c < clusters.size(); c++) {
+    cluster_t cluster;
+    cluster.begin = clusters[c];
+    cluster.end = (c + 1 < clusters.size()) ? clusters[c + 1] : nb_triangles;
+    cluster.centroid = glm::vec3{0.0f};
+    cluster.normal = glm::vec3{0.0f};
+
+    float area = 0.0f;
+    for (size_t t = cluster.begin; t < cluster.end; t++) {
+      const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].position;
+      const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+      const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      const float a = glm::length(n) * 0.5f;
+      cluster.centroid += (p0 + p1 + p2) * (a / 3.0f);
+      cluster.normal += n;
+      area += a;
+    }
+    mesh_centroid += cluster.centroid;
+    mesh_area += area;
+    if (area > 0.0f) {
+      cluster.centroid /= area;
+    } else {
+      cluster.centroid = vertices[indices[cluster.begin * 3]].position;
+    }
+    sorted.push_back(cluster);
+  }
+  if (mesh_area <= 0.0f) {
+    return;
+  }
+  mesh_centroid /= mesh_area;
+
+  // Clusters facing away from the mesh centre are drawn first, they are the
+  // most likely to occlude the rest
+  for (auto &cluster : sorted) {
+    const float length = std::max(glm::length(cluster.normal), 1e-12f);
+    const glm::vec3 n = cluster.normal / length;
+    cluster.sort_key = glm::dot(cluster.centroid - mesh_centroid, n);
+  }
+  std::stable_sort(sorted.begin(),
+                   sorted.end(),
+                   [](const cluster_t &a, const cluster_t &b) {
+                     return a.sort_key > b.sort_key;
+                   });
+
+  std::vector<unsigned int> output;
+  output.reserve(indices.size());
+  for (const auto &cluster : sorted) {
+    output.insert(output.end(),
+                  indices.begin() + cluster.begin * 3,
+                  indices.begin() + cluster.end * 3);
+  }
+  indices.swap(output);
+}
+
+void glmesh_optimize_fetch(std::vector<glvertex_t> &vertices,
+                           std::vector<unsigned int> &indices) {
+  // Renumber vertices in order of first use, unused vertices are dropped
+  const unsigned int unused = -1;
+  std::vector<unsigned int> remap(vertices.size(), unused);
+  std::vector<glvertex_t> reordered;
+  reordered.reserve(vertices.size());
+  for (auto &idx : indices) {
+    if (remap[idx] == unused) {
+      remap[idx] = reordered.size();
+      reordered.push_back(vertices[idx]);
+    }
+    idx = remap[idx];
+  }
+  vertices.swap(reordered);
+}
+
+glmesh_optimize_stats_t glmesh_optimize(std::vector<glvertex_t> &vertices,
+                                        std::vector<unsigned int> &indices,
+                                        const int cache_size) {
+  glmesh_optimize_stats_t stats;
+  stats.nb_vertices_before = vertices.size();
+  stats.nb_triangles = indices.size() / 3;
+  stats.acmr_before = glmesh_acmr(indices, vertices.size(), cache_size);
+
+  glmesh_weld(vertices, indices);
+  const auto clusters = glmesh_tipsify(indices, vertices.size(), cache_size);
+  glmesh_sort_clusters(vertices, indices, clusters);
+  glmesh_optimize_fetch(vertices, indices);
+
+  stats.nb_vertices_after = vertices.size();
+  stats.acmr_after = glmesh_acmr(indices, vertices.size(), cache_size);
+
+  return stats;
+}
+
+/*****************************************************************************
+ *                                CAMERA
+ ****************************************************************************/
+
+GLuint glcamera_ubo_create() {
+  GLuint ubo;
+  glGenBuffers(1, &ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferData(GL_UNIFORM_BUFFER,
+               sizeof(glcamera_ubo_t),
+               NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, GLCAMERA_UBO_BINDING, ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  return ubo;
+}
+
+// Buffer bound to the camera block and the camera state last written to it
+static GLuint glcamera_ubo_bound = 0;
+static const glcamera_t *glcamera_ubo_camera = nullptr;
+static uint64_t glcamera_ubo_version = 0;
+static int glcamera_ubo_width = 0;
+static int glcamera_ubo_height = 0;
+
+void glcamera_ubo_delete(GLuint &ubo) {
+  if (ubo == glcamera_ubo_bound) {
+    glcamera_ubo_bound = 0;
+    glcamera_ubo_camera = nullptr;
+  }
+  glDeleteBuffers(1, &ubo);
+  ubo = 0;
+}
+
+void glcamera_ubo_update(const GLuint ubo, const glcamera_t &camera) {
+  glcamera_ubo_t data;
+  data.projection = camera.projection();
+  data.view = camera.view();
+
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glcamera_ubo_t), &data);
+  glBindBufferBase(GL_UNIFORM_BUFFER, GLCAMERA_UBO_BINDING, ubo);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  glcamera_ubo_bound = ubo;
+  glcamera_ubo_camera = &camera;
+  glcamera_ubo_version = camera.version;
+  glcamera_ubo_width = camera.screen_width;
+  glcamera_ubo_height = camera.screen_height;
+}
+
+void glcamera_ubo_use(const glcamera_t &camera) {
+  if (glcamera_ubo_bound == 0) {
+    return;
+  }
+
+  // Objects drawn with the frame camera skip the upload
+  if (&camera == glcamera_ubo_camera &&
+      camera.version == glcamera_ubo_version &&
+      camera.screen_width == glcamera_ubo_width &&
+      camera.screen_height == glcamera_ubo_height) {
+    return;
+  }
+  glcamera_ubo_update(glcamera_ubo_bound, camera);
+}
+
+glfrustum_t::glfrustum_t(const glm::mat4 &M) {
+  for (int i = 0; i < 3; i++) {
+    const glm::vec4 row{M[0][i], M[1][i], M[2][i], M[3][i]};
+    const glm::vec4 row_w{M[0][3], M[1][3], M[2][3], M[3][3]};
+    planes[i * 2] = row_w + row;
+    planes[i * 2 + 1] = row_w - row;
+  }
+}
+
+bool glfrustum_t::visible(const glm::vec3 &min, const glm::vec3 &max) const {
+  // Outside if the box corner furthest along a plane normal is behind it
+  for (const auto &plane : planes) {
+    const glm::vec4 corner{(plane.x > 0) ? max.x : min.x,
+                           (plane.y > 0) ? max.y : min.y,
+                           (plane.z > 0) ? max.z : min.z,
+                           1.0f};
+    if (glm::dot(plane, corner) < 0.0f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+glarena_t::glarena_t(const glvertex_layout_t layout_,
+                     const glm::vec3 &bounds_min_,
+                     const glm::vec3 &bounds_max_)
+    : layout{layout_}, bounds_min{bounds_min_}, bounds_max{bounds_max_} {}
+
+glarena_t::glarena_t(glarena_t &&other) noexcept {
+  *this = std::move(other);
+}
+
+glarena_t::~glarena_t() {
+  if (VAO) {
+    glDeleteVertexArrays(1, &VAO);
+  }
+  if (VBO) {
+    glDeleteBuffers(1, &VBO);
+  }
+  if (EBO) {
+    glDeleteBuffers(1, &EBO);
+  }
+  if (DIBO) {
+    glDeleteBuffers(1, &DIBO);
+  }
+}
+
+glarena_t &glarena_t::operator=(glarena_t &&other) noexcept {
+  // Swap so that our previous GL objects are freed with `other`
+  std::swap(layout, other.layout);
+  std::swap(bounds_min, other.bounds_min);
+  std::swap(bounds_max, other.bounds_max);
+  std::swap(pos_offset, other.pos_offset);
+  std::swap(pos_scale, other.pos_scale);
+  std::swap(vertex_data, other.vertex_data);
+  std::swap(index_data, other.index_data);
+  std::swap(nb_vertices, other.nb_vertices);
+  std::swap(nb_indices, other.nb_indices);
+  std::swap(batches, other.batches);
+  std::swap(indirect, other.indirect);
+  std::swap(pos_offset_loc, other.pos_offset_loc);
+  std::swap(pos_scale_loc, other.pos_scale_loc);
+  std::swap(program_id, other.program_id);
+  std::swap(VAO, other.VAO);
+  std::swap(VBO, other.VBO);
+  std::swap(EBO, other.EBO);
+  std::swap(DIBO, other.DIBO);
+  return *this;
+}
+
+int glarena_add(glarena_t &arena,
+                const std::vector<glvertex_t> &vertices,
+                const std::vector<unsigned int> &indices,
+                const std::vector<gltexture_t> &textures) {
+  // Vertices quantized against the arena bounds, 16-bit indices split where
+  // the mesh exceeds 65536 vertices
+  glvertices_t packed_vertices;
+  glvertices_pack(vertices,
+                  arena.layout,
+                  arena.bounds_min,
+                  arena.bounds_max,
+                  packed_vertices);
+  glindices_t packed_indices;
+  glindices_pack(indices, vertices.size(), true, packed_indices);
+  return glarena_add(arena, packed_vertices, packed_indices, textures);
+}
+
+int glarena_add(glarena_t &arena,
+                const glvertices_t &vertices,
+                const glindices_t &indices,
+                const std::vector<gltexture_t> &textures) {
+  if (arena.VAO) {
+    LOG_ERROR("Cannot add meshes to an uploaded arena!");
+    return -1;
+  }
+  if (vertices.layout != arena.layout) {
+    LOG_ERROR("Mesh is not packed for this arena!");
+    return -1;
+  }
+  if (indices.type != GL_UNSIGNED_SHORT) {
+    // Also triangles spanning more than 65536 vertices
+    LOG_WARN("Mesh indices are not 16-bit, not added to the arena!");
+    return -1;
+  }
+
+  // Append vertices and indices
+  arena.pos_offset = vertices.pos_offset;
+  arena.pos_scale = vertices.pos_scale;
+  arena.vertex_data.insert(arena.vertex_data.end(),
+                           vertices.data.begin(),
+                           vertices.data.end());
+  arena.index_data.insert(arena.index_data.end(),
+                          indices.data.begin(),
+                          indices.data.end());
+
+  // Draws sharing the same textures are issued together
+  glarena_batch_t *batch = nullptr;
+  for (auto &b : arena.batches) {
+    bool same = (b.textures.size() == textures.size());
+    for (size_t i = 0; same && i < textures.size(); i++) {
+      same = (b.textures[i].id == textures[i].id);
+      same = same && (b.textures[i].type == textures[i].type);
+      same = same && (b.textures[i].path == textures[i].path);
+    }
+    if (same) {
+      batch = &b;
+      break;
+    }
+  }
+  if (batch == nullptr) {
+    arena.batches.emplace_back();
+    batch = &arena.batches.back();
+    batch->textures = textures;
+  }
+
+  for (const auto &range : indices.ranges) {
+    gldraw_elements_indirect_t cmd;
+    cmd.count = range.count;
+    cmd.first_index = arena.nb_indices + range.offset;
+    cmd.base_vertex = arena.nb_vertices + range.base_vertex;
+    batch->commands.push_back(cmd);
+  }
+
+  arena.nb_vertices += vertices.size;
+  arena.nb_indices += indices.size;
+
+  return 0;
+}
+
+void glarena_upload(glarena_t &arena) {
+  if (arena.VAO || arena.nb_indices == 0) {
+    return;
+  }
+  glarena_upload(arena,
+                 arena.vertex_data.data(),
+                 arena.vertex_data.size(),
+                 arena.index_data.data(),
+                 arena.index_data.size());
+
+  // The geometry only lives on the GPU from here on
+  std::vector<uint8_t>().swap(arena.vertex_data);
+  std::vector<uint8_t>().swap(arena.index_data);
+}
+
+void glarena_upload(glarena_t &arena,
+                    const void *vertex_data,
+                    const size_t vertex_size,
+                    const void *index_data,
+                    const size_t index_size) {
+  if (arena.VAO || arena.nb_indices == 0) {
+    return;
+  }
+
+  // -- VAO
+  glGenVertexArrays(1, &arena.VAO);
+  glBindVertexArray(arena.VAO);
+
+  // -- VBO
+  glGenBuffers(1, &arena.VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, arena.VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertex_size, vertex_data, GL_STATIC_DRAW);
+
+  // -- EBO
+  glGenBuffers(1, &arena.EBO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_size, index_data, GL_STATIC_DRAW);
+
+  glmesh_attributes(arena.layout);
+  glBindVertexArray(0);
+
+  // Lay the commands out batch after batch
+  std::vector<gldraw_elements_indirect_t> commands;
+  for (auto &batch : arena.batches) {
+    batch.first_command = commands.size();
+    commands.insert(commands.end(),
+                    batch.commands.begin(),
+                    batch.commands.end());
+
+    batch.counts.clear();
+    batch.offsets.clear();
+    batch.base_vertices.clear();
+    for (const auto &cmd : batch.commands) {
+      const size_t offset = cmd.first_index * sizeof(GLushort);
+      batch.counts.push_back(cmd.count);
+      batch.offsets.push_back((const void *) offset);
+      batch.base_vertices.push_back(cmd.base_vertex);
+    }
+  }
+
+  // -- DIBO
+  arena.indirect = GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect;
+  if (arena.indirect) {
+    glGenBuffers(1, &arena.DIBO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arena.DIBO);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 commands.size() * sizeof(gldraw_elements_indirect_t),
+                 commands.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
+}
+
+void glarena_bind(glarena_t &arena, const glprog_t &program) {
+  for (auto &batch : arena.batches) {
+    batch.sampler_locs.clear();
+    for (const auto &name : glmesh_sampler_names(batch.textures)) {
+      batch.sampler_locs.push_back(program.uniform(name));
+    }
+  }
+  arena.pos_offset_loc = program.uniform("pos_offset");
+  arena.pos_scale_loc = program.uniform("pos_scale");
+  arena.program_id = program.program_id;
+}
+
+void glarena_draw(const glarena_t &arena, const glprog_t &program) {
+  if (arena.VAO == 0) {
+    return;
+  }
+
+  // Resolve uniform locations if the arena was not bound to this program
+  const bool bound = (arena.program_id == program.program_id);
+  gluniform_handle_t pos_offset_loc = arena.pos_offset_loc;
+  gluniform_handle_t pos_scale_loc = arena.pos_scale_loc;
+  if (bound == false) {
+    pos_offset_loc = program.uniform("pos_offset");
+    pos_scale_loc = program.uniform("pos_scale");
+  }
+
+  // Quantized positions are restored in the vertex shader
+  program.set(pos_offset_loc, arena.pos_offset);
+  program.set(pos_scale_loc, arena.pos_scale);
+
+  glBindVertexArray(arena.VAO);
+  if (arena.indirect) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, arena.DIBO);
+  }
+
+  for (const auto &batch : arena.batches) {
+    // Bind the batch's textures once
+    std::vector<gluniform_handle_t> resolved;
+    if (bound == false) {
+      for (const auto &name : glmesh_sampler_names(batch.textures)) {
+        resolved.push_back(program.uniform(name));
+      }
+    }
+    const auto &sampler_locs = (bound) ? batch.sampler_locs : resolved;
+    for (size_t i = 0; i < batch.textures.size(); i++) {
+      glActiveTexture(GL_TEXTURE0 + i);
+      program.set(sampler_locs[i], (int) i);
+      gltexture_bind(batch.textures[i].id);
+    }
+
+    // Draw every mesh in the batch
+    const GLsizei nb_draws = batch.commands.size();
+    if (arena.indirect) {
+      const size_t offset =
+          batch.first_command * sizeof(gldraw_elements_indirect_t);
+      glMultiDrawElementsIndirect(GL_TRIANGLES,
+                                  GL_UNSIGNED_SHORT,
+                                  (const void *) offset,
+                                  nb_draws,
+                                  0);
+    } else {
+      glMultiDrawElementsBaseVertex(GL_TRIANGLES,
+                                    batch.counts.data(),
+                                    GL_UNSIGNED_SHORT,
+                                    batch.offsets.data(),
+                                    nb_draws,
+                                    batch.base_vertices.data());
+    }
+  }
+
+  if (arena.indirect) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
+  glBindVertexArray(0);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+/*****************************************************************************
+ *                                MODEL
+ ****************************************************************************/
+
+glmodel_t::glmodel_t(const std::string &path,
+                     const std::string &vs,
+                     const std::string &fs,
+                     const bool gamma,
+                     const glmodel_options_t &options_)
+    : program{vs, fs}, gamma_correction(gamma), options(options_) {
+  projection_loc = program.uniform("projection");
+  view_loc = program.uniform("view");
+  model_loc = program.uniform("model");
+  glmodel_load(*this, path);
+}
+
+glmodel_t::glmodel_t(const std::string &path,
+                     const char *vs,
+                     const char *fs,
+                     const bool gamma,
+                     const glmodel_options_t &options_)
+    : program{vs, fs}, gamma_correction(gamma), options(options_) {
+  projection_loc = program.uniform("projection");
+  view_loc = program.uniform("view");
+  model_loc = program.uniform("model");
+  glmodel_load(*this, path);
+}
+
+glmodel_t::~glmodel_t() {
+  for (const auto &texture : textures_loaded) {
+    gltexture_release(texture.id);
+  }
+}
+
+void glmodel_draw(glmodel_t &model, const glcamera_t &camera) {
+  // Replace placeholders with decoded textures, a few per frame
+  gltexture_loader_poll(4);
+
+  // Set projection and view
+  // Built-in shaders read projection and view from the camera block, only
+  // custom shaders with plain uniforms need them set here
+  glcamera_ubo_use(camera);
+  model.program.use();
+  if (model.projection_loc.valid()) {
+    model.program.set(model.projection_loc, camera.projection());
+  }
+  if (model.view_loc.valid()) {
+    model.program.set(model.view_loc, camera.view());
+  }
+  model.program.set(model.model_loc, model.T_SM);
+
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    glmesh_draw(model.meshes[i], model.program);
+  }
+  glarena_draw(model.arena, model.program);
+}
+
+static void glmodel_scene_bounds(const aiScene *scene,
+                                 glm::vec3 &bounds_min,
+                                 glm::vec3 &bounds_max) {
+  bounds_min = glm::vec3{FLT_MAX};
+  bounds_max = glm::vec3{-FLT_MAX};
+  for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+    const aiMesh *mesh = scene->mMeshes[i];
+    for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
+      const aiVector3D &v = mesh->mVertices[j];
+      bounds_min = glm::min(bounds_min, glm::vec3(v.x, v.y, v.z));
+      bounds_max = glm::max(bounds_max, glm::vec3(v.x, v.y, v.z));
+    }
+  }
+}
+
+void glmodel_load(glmodel_t &model, const std::string &path) {
+  // Baked models skip Assimp altogether
+  if (glmodel_is_baked(path)) {
+    glmodel_load_baked(model, path);
+    return;
+  }
+
+  // Read
+  Assimp::Importer importer;
+  const auto options =
+      aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+  const aiScene *scene = importer.ReadFile(path, options);
+
+  // Check for errors
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+      !scene->mRootNode) {
+    std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+    return;
+  }
+
+  // Retrieve the directory path of the filepath
+  model.directory = path.substr(0, path.find_last_of('/'));
+
+  // Arena positions are quantized against the bounds of the whole model
+  if (model.options.arena) {
+    glm::vec3 bounds_min;
+    glm::vec3 bounds_max;
+    glmodel_scene_bounds(scene, bounds_min, bounds_max);
+    const glvertex_layout_t layout = model.options.vertex_layout;
+    model.arena = glarena_t{layout, bounds_min, bounds_max};
+  }
+
+  // Request textures first so their decodes overlap the CPU stage
+  std::vector<aiMesh *> meshes;
+  glmodel_collect_meshes(scene->mRootNode, scene, meshes);
+  std::vector<glmodel_staging_t> staging(meshes.size());
+  for (size_t i = 0; i < meshes.size(); i++) {
+    staging[i].mesh = meshes[i];
+    staging[i].textures = glmodel_mesh_textures(model, meshes[i], scene);
+  }
+
+  // CPU stage: convert, optimize and pack meshes on the worker pool
+  thread_pool().parallel_for(meshes.size(), [&](const size_t i) {
+    glmodel_stage_mesh(model.options, model.arena, staging[i]);
+  });
+
+  // GL stage: upload in scene order, then release the scene
+  model.meshes.reserve(model.meshes.size() + meshes.size());
+  for (auto &mesh : staging) {
+    glmodel_process_mesh(model, mesh);
+  }
+  importer.FreeScene();
+  if (model.options.arena) {
+    glarena_upload(model.arena);
+  }
+
+  // Resolve sampler locations once so drawing avoids string lookups
+  for (auto &mesh : model.meshes) {
+    glmesh_bind(mesh, model.program);
+  }
+  glarena_bind(model.arena, model.program);
+
+  const glmesh_optimize_stats_t &stats = model.optimize_stats;
+  if (stats.nb_triangles) {
+    LOG_INFO("Model [%s]: %zu triangles, %zu -> %zu vertices, "
+             "ACMR %.3f -> %.3f",
+             path.c_str(),
+             stats.nb_triangles,
+             stats.nb_vertices_before,
+             stats.nb_vertices_after,
+             stats.acmr_before,
+             stats.acmr_after);
+  }
+}
+
+void glmodel_collect_meshes(aiNode *node,
+                            const aiScene *scene,
+                            std::vector<aiMesh *> &meshes) {
+  // Collect each mesh located at the current node
+  for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+    // The node object only contains indices to index the actual objects in the
+    // scene.  the scene contains all the data, node is just to keep stuff
+    // organized (like relations between nodes).
+    meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+  }
+
+  // After we've collected all of the meshes (if any) we then recursively
+  // collect each of the children nodes
+  for (unsigned int i = 0; i < node->mNumChildren; i++) {
+    glmodel_collect_meshes(node->mChildren[i], scene, meshes);
+  }
+}
+
+void glmodel_mesh_geometry(const aiMesh *mesh,
+                           std::vector<glvertex_t> &vertices,
+                           std::vector<unsigned int> &indices) {
+  vertices.clear();
+  indices.clear();
+  vertices.reserve(mesh->mNumVertices);
+  indices.reserve(mesh->mNumFaces * 3);
+
+  // Walk through each of the mesh's vertices
+  for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+    glvertex_t vertex;
+    glm::vec3 vector;
+    // Placeholder vector since assimp uses its own vector class that doesn't
+    // directly convert to glm's vec3 class so we transfer the data to this
+    // placeholder glm::vec3 first.
+
+    // Positions
+    vector.x = mesh->mVertices[i].x;
+    vector.y = mesh->mVertices[i].y;
+    vector.z = mesh->mVertices[i].z;
+    vertex.position = vector;
+
+    // Normals
+    vector.x = mesh->mNormals[i].x;
+    vector.y = mesh->mNormals[i].y;
+    vector.z = mesh->mNormals[i].z;
+    vertex.normal = vector;
+
+    // Texture coordinates
+    if (mesh->mTextureCoords[0]) {
+      // Does the mesh contain texture coordinates? A vertex can contain up to
+      // 8 different texture coordinates. We thus make the assumption that we
+      // won't use models where a vertex can have multiple texture coordinates
+      // so we always take the first set (0).
+      glm::vec2 vec;
+      vec.x = mesh->mTextureCoords[0][i].x;
+      vec.y = mesh->mTextureCoords[0][i].y;
+      vertex.texcoords = vec;
+    } else {
+      vertex.texcoords = glm::vec2(0.0f, 0.0f);
+    }
+
+    // Tangent
+    vector.x = mesh->mTangents[i].x;
+    vector.y = mesh->mTangents[i].y;
+    vector.z = mesh->mTangents[i].z;
+    vertex.tangent = vector;
+
+    // Bi-tangent
+    vector.x = mesh->mBitangents[i].x;
+    vector.y = mesh->mBitangents[i].y;
+    vector.z = mesh->mBitangents[i].z;
+    vertex.bitangent = vector;
+    vertices.push_back(vertex);
+  }
+
+  // Now walk through each of the mesh's faces (a face is a mesh its triangle)
+  // and retrieve the corresponding vertex indices.
+  for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+    aiFace face = mesh->mFaces[i];
+
+    // Retrieve all indices of the face and store them in the indices vector
+    for (unsigned int j = 0; j < face.mNumIndices; j++)
+      indices.push_back(face.mIndices[j]);
+  }
+}
+
+void glmodel_stage_mesh(const glmodel_options_t &options,
+                        const glarena_t &arena,
+                        glmodel_staging_t &staging) {
+  const aiMesh *mesh = staging.mesh;
+  std::vector<glvertex_t> vertices;
+  std::vector<unsigned int> indices;
+  glmodel_mesh_geometry(mesh, vertices, indices);
+
+  // Weld and reorder triangle meshes for the vertex cache
+  if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE && indices.size()) {
+    staging.stats = glmesh_optimize(vertices, indices);
+  }
+
+  // Pack for the arena or for a mesh of its own
+  if (options.arena) {
+    glvertices_pack(vertices,
+                    options.vertex_layout,
+                    arena.bounds_min,
+                    arena.bounds_max,
+                    staging.vertices);
+    glindices_pack(indices, vertices.size(), true, staging.indices);
+  } else {
+    glvertices_pack(vertices, options.vertex_layout, staging.vertices);
+    glindices_pack(indices,
+                   vertices.size(),
+                   options.split_indices,
+                   staging.indices);
+  }
+}
+
+std::vector<gltexture_t> glmodel_mesh_texture_refs(const aiMesh *mesh,
+                                                   const aiScene *scene) {
+  std::vector<gltexture_t> textures;
+
+  // Process materials
+  aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+  // we assume a convention for sampler names in the shaders. Each diffuse
+  // texture should be named as 'texture_diffuseN' where N is a sequential
+  // number ranging from 1 to MAX_SAMPLER_NUMBER.  Same applies to other
+  // texture as the following list summarizes:
+  // - diffuse: texture_diffuseN
+  // - specular: texture_specularN
+  // - normal: texture_normalN
+
+  // clang-format off
+  // 1. Diffuse maps
+  const auto diffuse_maps = glmodel_material_textures(
+    material,
+    aiTextureType_DIFFUSE,
+    "texture_diffuse"
+  );
+  textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
+
+  // 2. Specular maps
+  const auto specularMaps = glmodel_material_textures(
+    material,
+    aiTextureType_SPECULAR,
+    "texture_specular"
+  );
+  textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+
+  // 3. Normal maps
+  const auto normalMaps = glmodel_material_textures(
+    material,
+    aiTextureType_HEIGHT,
+    "texture_normal"
+  );
+  textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+
+  // 4. Height maps
+  const auto heightMaps = glmodel_material_textures(
+    material,
+    aiTextureType_AMBIENT,
+    "texture_height"
+  );
+  textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+  // clang-format on
+
+  return textures;
+}
+
+std::vector<gltexture_t> glmodel_mesh_textures(glmodel_t &model,
+                                               const aiMesh *mesh,
+                                               const aiScene *scene) {
+  // Acquire from the texture cache, which only loads textures it has not
+  // seen before. The model holds one cache reference per use, released on
+  // destruction
+  auto textures = glmodel_mesh_texture_refs(mesh, scene);
+  for (auto &texture : textures) {
+    const std::string path = model.directory + '/' + texture.path;
+    texture.id = gltexture_acquire(path, model.options.async_textures);
+    model.textures_loaded.push_back(texture);
+  }
+
+  return textures;
+}
+
+void glmodel_process_mesh(glmodel_t &model, glmodel_staging_t &staging) {
+  // Accumulate optimization stats, ACMR weighted by triangles
+  const glmesh_optimize_stats_t &stats = staging.stats;
+  if (stats.nb_triangles) {
+    glmesh_optimize_stats_t &total = model.optimize_stats;
+    const float nb_triangles = total.nb_triangles + stats.nb_triangles;
+    const float w0 = total.nb_triangles / nb_triangles;
+    const float w1 = stats.nb_triangles / nb_triangles;
+    total.acmr_before = total.acmr_before * w0 + stats.acmr_before * w1;
+    total.acmr_after = total.acmr_after * w0 + stats.acmr_after * w1;
+    total.nb_vertices_before += stats.nb_vertices_before;
+    total.nb_vertices_after += stats.nb_vertices_after;
+    total.nb_triangles += stats.nb_triangles;
+  }
+
+  // Upload into the arena or a mesh of its own, meshes the arena rejects
+  // keep their arena quantized vertices
+  if (model.options.arena && glarena_add(model.arena,
+                                         staging.vertices,
+                                         staging.indices,
+                                         staging.textures) == 0) {
+    staging.vertices = glvertices_t();
+    staging.indices = glindices_t();
+  } else {
+    model.meshes.emplace_back(std::move(staging.vertices),
+                              std::move(staging.indices),
+                              std::move(staging.textures),
+                              model.options.keep_geometry);
+  }
+}
+
+// checks all material textures of a given type and returns their type and
+// path, relative to the model directory, as Texture structs.
+std::vector<gltexture_t> glmodel_material_textures(aiMaterial *mat,
+                                                   aiTextureType type,
+                                                   std::string typeName) {
+  std::vector<gltexture_t> textures;
+
+  for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
+    aiString str;
+    mat->GetTexture(type, i, &str);
+
+    gltexture_t texture;
+    texture.id = 0;
+    texture.type = typeName;
+    texture.path = str.C_Str();
+    textures.push_back(texture);
+  }
+
+  return textures;
+}
+
+static size_t glmodel_bake_align(const size_t offset) {
+  return (offset + 15) & ~((size_t) 15);
+}
+
+int glmodel_bake(const std::string &model_path,
+                 const std::string &output_path,
+                 const glvertex_layout_t layout) {
+  // Read
+  Assimp::Importer importer;
+  const auto options =
+      aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+  const aiScene *scene = importer.ReadFile(model_path, options);
+  if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+      !scene->mRootNode) {
+    LOG_ERROR("Failed to load [%s]: %s",
+              model_path.c_str(),
+              importer.GetErrorString());
+    return -1;
+  }
+
+  // Build the arena on the CPU exactly as glmodel_load() would
+  glmodel_options_t model_options;
+  model_options.vertex_layout = layout;
+  glm::vec3 bounds_min;
+  glm::vec3 bounds_max;
+  glmodel_scene_bounds(scene, bounds_min, bounds_max);
+  glarena_t arena{layout, bounds_min, bounds_max};
+
+  std::vector<aiMesh *> meshes;
+  glmodel_collect_meshes(scene->mRootNode, scene, meshes);
+  std::vector<glmodel_staging_t> staging(meshes.size());
+  thread_pool().parallel_for(meshes.size(), [&](const size_t i) {
+    staging[i].mesh = meshes[i];
+    glmodel_stage_mesh(model_options, arena, staging[i]);
+  });
+  for (auto &mesh : staging) {
+    const auto textures = glmodel_mesh_texture_refs(mesh.mesh, scene);
+    if (glarena_add(arena, mesh.vertices, mesh.indices, textures) != 0) {
+      LOG_ERROR("Failed to bake [%s]!", model_path.c_str());
+      return -1;
+    }
+  }
+
+  // Tables
+  std::vector<glmodel_bake_batch_t> batches;
+  std::vector<gldraw_elements_indirect_t> commands;
+  std::vector<glmodel_bake_texture_t> textures;
+  for (const auto &batch : arena.batches) {
+    glmodel_bake_batch_t entry;
+    entry.first_command = commands.size();
+    entry.nb_commands = batch.commands.size();
+    entry.first_texture = textures.size();
+    entry.nb_textures = batch.textures.size();
+    batches.push_back(entry);
+    commands.insert(commands.end(),
+                    batch.commands.begin(),
+                    batch.commands.end());
+
+    for (const auto &texture : batch.textures) {
+      glmodel_bake_texture_t ref = {};
+      if (texture.type.size() >= sizeof(ref.type) ||
+          texture.path.size() >= sizeof(ref.path)) {
+        LOG_ERROR("Texture path too long [%s]!", texture.path.c_str());
+        return -1;
+      }
+      strcpy(ref.type, texture.type.c_str());
+      strcpy(ref.path, texture.path.c_str());
+      textures.push_back(ref);
+    }
+  }
+
+  // Header
+  glmodel_bake_header_t header = {};
+  memcpy(header.magic, "SHOWMDL1", 8);
+  header.vertex_layout = layout;
+  header.nb_batches = batches.size();
+  for (int i = 0; i < 3; i++) {
+    header.bounds_min[i] = arena.bounds_min[i];
+    header.bounds_max[i] = arena.bounds_max[i];
+    header.pos_offset[i] = arena.pos_offset[i];
+    header.pos_scale[i] = arena.pos_scale[i];
+  }
+  header.nb_vertices = arena.nb_vertices;
+  header.nb_indices = arena.nb_indices;
+  header.nb_commands = commands.size();
+  header.nb_textures = textures.size();
+  header.vertex_offset = glmodel_bake_align(sizeof(header));
+  header.index_offset =
+      glmodel_bake_align(header.vertex_offset + arena.vertex_data.size());
+  header.batches_offset =
+      glmodel_bake_align(header.index_offset + arena.index_data.size());
+  header.commands_offset = glmodel_bake_align(
+      header.batches_offset + batches.size() * sizeof(glmodel_bake_batch_t));
+  header.textures_offset = glmodel_bake_align(
+      header.commands_offset +
+      commands.size() * sizeof(gldraw_elements_indirect_t));
+
+  // Write
+  FILE *fp = fopen(output_path.c_str(), "wb");
+  if (fp == NULL) {
+    LOG_ERROR("Failed to open [%s] for writing!", output_path.c_str());
+    return -1;
+  }
+  auto write_at = [&](const uint64_t offset, const void *data, size_t size) {
+    fseek(fp, offset, SEEK_SET);
+    return size == 0 || fwrite(data, size, 1, fp) == 1;
+  };
+  bool ok = write_at(0, &header, sizeof(header));
+  ok = ok && write_at(header.vertex_offset,
+                      arena.vertex_data.data(),
+                      arena.vertex_data.size());
+  ok = ok && write_at(header.index_offset,
+                      arena.index_data.data(),
+                      arena.index_data.size());
+  ok = ok && write_at(header.batches_offset,
+                      batches.data(),
+                      batches.size() * sizeof(glmodel_bake_batch_t));
+  ok = ok && write_at(header.commands_offset,
+                      commands.data(),
+                      commands.size() * sizeof(gldraw_elements_indirect_t));
+  ok = ok && write_at(header.textures_offset,
+                      textures.data(),
+                      textures.size() * sizeof(glmodel_bake_texture_t));
+  fclose(fp);
+  if (ok == false) {
+    LOG_ERROR("Failed to write [%s]!", output_path.c_str());
+    return -1;
+  }
+
+  LOG_INFO("Baked [%s]: %zu vertices, %zu indices, %zu batches",
+           output_path.c_str(),
+           arena.nb_vertices,
+           arena.nb_indices,
+           batches.size());
+
+  return 0;
+}
+
+bool glmodel_is_baked(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL) {
+    return false;
+  }
+
+  char magic[8] = {0};
+  const bool ok = fread(magic, sizeof(magic), 1, fp) == 1;
+  fclose(fp);
+
+  return ok && memcmp(magic, "SHOWMDL1", 8) == 0;
+}
+
+// Section of `count` elements at `offset` lies within the file, compared
+// without overflowing on corrupt counts and offsets
+static bool glmodel_bake_section_valid(const uint64_t offset,
+                                       const uint64_t count,
+                                       const uint64_t element_size,
+                                       const uint64_t data_size) {
+  return offset % 16 == 0 && offset <= data_size &&
+         count <= (data_size - offset) / element_size;
+}
+
+// Draw command reads only indices and vertices in the file
+static bool glmodel_bake_command_valid(const gldraw_elements_indirect_t &cmd,
+                                       const GLushort *indices,
+                                       const uint64_t nb_indices,
+                                       const uint64_t nb_vertices) {
+  if (cmd.first_index > nb_indices ||
+      cmd.count > nb_indices - cmd.first_index) {
+    return false;
+  }
+  if (cmd.count == 0) {
+    return true;
+  }
+  if (cmd.base_vertex < 0 || (uint64_t) cmd.base_vertex >= nb_vertices) {
+    return false;
+  }
+
+  GLushort max_index = 0;
+  for (GLuint i = cmd.first_index; i < cmd.first_index + cmd.count; i++) {
+    max_index = std::max(max_index, indices[i]);
+  }
+  return max_index < nb_vertices - cmd.base_vertex;
+}
+
+void glmodel_load_baked(glmodel_t &model, const std::string &path) {
+  // Map file
+  const int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) != 0) {
+    LOG_ERROR("Failed to open baked model [%s]!", path.c_str());
+    if (fd != -1) {
+      close(fd);
+    }
+    return;
+  }
+  const size_t data_size = st.st_size;
+  void *data = mmap(NULL, data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG_ERROR("Failed to map baked model [%s]!", path.c_str());
+    return;
+  }
+  const uint8_t *bytes = (const uint8_t *) data;
+
+  // Check header and tables
+  glmodel_bake_header_t header;
+  bool valid = data_size >= sizeof(header);
+  if (valid) {
+    memcpy(&header, bytes, sizeof(header));
+    valid = header.vertex_layout <= GLVERTEX_COMPACT_QPOS;
+  }
+  if (valid) {
+    const glvertex_layout_t layout = (glvertex_layout_t) header.vertex_layout;
+    valid = glmodel_bake_section_valid(header.vertex_offset,
+                                       header.nb_vertices,
+                                       glvertex_size(layout),
+                                       data_size);
+    valid = valid && glmodel_bake_section_valid(header.index_offset,
+                                                header.nb_indices,
+                                                sizeof(GLushort),
+                                                data_size);
+    valid = valid && glmodel_bake_section_valid(header.batches_offset,
+                                                header.nb_batches,
+                                                sizeof(glmodel_bake_batch_t),
+                                                data_size);
+    valid = valid &&
+            glmodel_bake_section_valid(header.commands_offset,
+                                       header.nb_commands,
+                                       sizeof(gldraw_elements_indirect_t),
+                                       data_size);
+    valid = valid &&
+            glmodel_bake_section_valid(header.textures_offset,
+                                       header.nb_textures,
+                                       sizeof(glmodel_bake_texture_t),
+                                       data_size);
+  }
+  if (valid) {
+    const auto *commands =
+        (const gldraw_elements_indirect_t *) (bytes + header.commands_offset);
+    const auto *indices = (const GLushort *) (bytes + header.index_offset);
+    for (uint64_t i = 0; valid && i < header.nb_commands; i++) {
+      valid = glmodel_bake_command_valid(commands[i],
+                                         indices,
+                                         header.nb_indices,
+                                         header.nb_vertices);
+    }
+  }
+  if (valid == false) {
+    LOG_ERROR("Invalid baked model [%s]!", path.c_str());
+    munmap(data, data_size);
+    return;
+  }
+
+  // Arena
+  model.directory = path.substr(0, path.find_last_of('/'));
+  glarena_t &arena = model.arena;
+  arena = glarena_t{(glvertex_layout_t) header.vertex_layout,
+                    glm::vec3(header.bounds_min[0],
+                              header.bounds_min[1],
+                              header.bounds_min[2]),
+                    glm::vec3(header.bounds_max[0],
+                              header.bounds_max[1],
+                              header.bounds_max[2])};
+  arena.pos_offset = glm::vec3(header.pos_offset[0],
+                               header.pos_offset[1],
+                               header.pos_offset[2]);
+  arena.pos_scale = glm::vec3(header.pos_scale[0],
+                              header.pos_scale[1],
+                              header.pos_scale[2]);
+  arena.nb_vertices = header.nb_vertices;
+  arena.nb_indices = header.nb_indices;
+
+  const auto *batches =
+      (const glmodel_bake_batch_t *) (bytes + header.batches_offset);
+  const auto *commands =
+      (const gldraw_elements_indirect_t *) (bytes + header.commands_offset);
+  const auto *textures =
+      (const glmodel_bake_texture_t *) (bytes + header.textures_offset);
+  for (uint32_t i = 0; i < header.nb_batches; i++) {
+    const glmodel_bake_batch_t &entry = batches[i];
+    if (entry.first_command > header.nb_commands ||
+        entry.nb_commands > header.nb_commands - entry.first_command ||
+        entry.first_texture > header.nb_textures ||
+        entry.nb_textures > header.nb_textures - entry.first_texture) {
+      LOG_ERROR("Invalid baked model [%s]!", path.c_str());
+      arena = glarena_t{};
+      munmap(data, data_size);
+      return;
+    }
+
+    glarena_batch_t batch;
+    batch.commands.assign(commands + entry.first_command,
+                          commands + entry.first_command + entry.nb_commands);
+    for (uint32_t j = 0; j < entry.nb_textures; j++) {
+      const glmodel_bake_texture_t &ref = textures[entry.first_texture + j];
+      gltexture_t texture;
+      texture.type = std::string(ref.type, strnlen(ref.type, sizeof(ref.type)));
+      texture.path = std::string(ref.path, strnlen(ref.path, sizeof(ref.path)));
+      const std::string texture_path = model.directory + '/' + texture.path;
+      const bool async = model.options.async_textures;
+      texture.id = gltexture_acquire(texture_path, async);
+      model.textures_loaded.push_back(texture);
+      batch.textures.push_back(texture);
+    }
+    arena.batches.push_back(batch);
+  }
+
+  // Blobs are already in the GPU layout
+  const uint64_t vertex_size =
+      header.nb_vertices * glvertex_size(arena.layout);
+  const uint64_t index_size = header.nb_indices * sizeof(GLushort);
+  glarena_upload(arena,
+                 bytes + header.vertex_offset,
+                 vertex_size,
+                 bytes + header.index_offset,
+                 index_size);
+  munmap(data, data_size);
+
+  glarena_bind(arena, model.program);
+}
+
+unsigned int texture_from_file(const std::string &dir,
+                               const char *fp,
+                               bool /*gamma*/) {
+  const std::string filename = dir + '/' + std::string(fp);
+  unsigned int texture_id;
+  glGenTextures(1, &texture_id);
+  texture_load_file(texture_id, filename);
+
+  return texture_id;
+}
+
+/*****************************************************************************
+ *                                DRAW
+ ****************************************************************************/
+
+globj_t::globj_t(const char *vs, const char *fs) : vs_{vs}, fs_{fs} {}
+
+glprog_t &globj_t::program() {
+  // Programs are shared and only built when an object is first drawn
+  if (program_ == nullptr) {
+    program_ = glprog_library_get(vs_, fs_);
+    model_loc_ = program_->uniform("model");
+  }
+
+  return *program_;
+}
+
+void globj_t::pos(const glm::vec3 &pos) { T_SM_ = glm::translate(T_SM_, pos); }
+
+glm::vec3 globj_t::pos() { return glm::vec3(T_SM_[3]); }
+
+glm::mat3 globj_t::rot() {
+  glm::vec3 col_0(T_SM_[0]);
+  glm::vec3 col_1(T_SM_[1]);
+  glm::vec3 col_2(T_SM_[2]);
+  glm::mat3 R(col_0, col_1, col_2);
+  return R;
+}
+
+glcf_t::glcf_t() : globj_t{shaders::glcf_vs, shaders::glcf_fs} {
+  // Form the camera fov frame
+  float hfov = fov_ / 2.0f;
+  float z = scale_;
+  float hwidth = z * glm::tan(hfov);
+  const glm::vec3 lb{-hwidth, hwidth, z};  // Left bottom
+  const glm::vec3 lt{-hwidth, -hwidth, z}; // Left top
+  const glm::vec3 rt{hwidth, -hwidth, z};  // Right top
+  const glm::vec3 rb{hwidth, hwidth, z};   // Right bottom
+
+  // Rectangle frame
+  // clang-format off
+  static const GLfloat vertices[] = {
+    // -- Left bottom to left top
+    lb.x, lb.y, lb.z, lt.x, lt.y, lt.z,
+    // -- Left top to right top
+    lt.x, lt.y, lt.z, rt.x, rt.y, rt.z,
+    // -- Right top to right bottom
+    rt.x, rt.y, rt.z, rb.x, rb.y, rb.z,
+    // -- Right bottom to left bottom
+    rb.x, rb.y, rb.z, lb.x, lb.y, lb.z,
+    // Rectangle frame to origin
+    // -- Origin to left bottom
+    0.0f, 0.0f, 0.0f, lb.x, lb.y, lb.z,
+    // -- Origin to left top
+    0.0f, 0.0f, 0.0f, lt.x, lt.y, lt.z,
+    // -- Origin to right top
+    0.0f, 0.0f, 0.0f, rt.x, rt.y, rt.z,
+    // -- Origin to right bottom
+    0.0f, 0.0f, 0.0f, rb.x, rb.y, rb.z
+  };
+  // clang-format on
+  const size_t nb_lines = 8;
+  const size_t nb_vertices = nb_lines * 2;
+  const size_t buffer_size = sizeof(GLfloat) * nb_vertices * 3;
+
+  // VAO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+
+  // VBO
+  glGenBuffers(1, &VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glBufferData(GL_ARRAY_BUFFER, buffer_size, vertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(0,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        3 * sizeof(float),
+                        (void *) 0);
+  glEnableVertexAttribArray(0);
+
+  // Clean up
+  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
+  glBindVertexArray(0);             // Unbind VAO
+}
+
+glcf_t::~glcf_t() {
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteBuffers(1, &VBO_);
+}
+
+void glcf_t::draw(const glcamera_t &camera) {
+  glcamera_ubo_use(camera);
+  program().use();
+  program_->set(model_loc_, T_SM_);
+
+  // Store original line width
+  float original_line_width = 0.0f;
+  glGetFloatv(GL_LINE_WIDTH, &original_line_width);
+
+  // Set line width
+  glLineWidth(line_width_);
+
+  // Draw frame
+  const size_t nb_lines = 8;
+  const size_t nb_vertices = nb_lines * 2;
+  glBindVertexArray(VAO_);
+  glDrawArrays(GL_LINES, 0, nb_vertices);
+  glBindVertexArray(0); // Unbind VAO
+
+  // Restore original line width
+  glLineWidth(original_line_width);
+}
+
+glcube_t::glcube_t() : glcube_t{0.5} {}
+
+glcube_t::glcube_t(const float cube_size)
+	: globj_t{shaders::glcube_vs, shaders::glcube_fs},
+		cube_size_{cube_size} {
+  // Vertices
+  // clang-format off
+  const float r = color_.x;
+  const float g = color_.y;
+  const float b = color_.z;
+  static const GLfloat vertices[] = {
+    // Triangle 1
+    -cube_size, -cube_size, -cube_size, r, g, b,
+    -cube_size, -cube_size, cube_size, r, g, b,
+    -cube_size, cube_size, cube_size, r, g, b,
+    // Triangle 2
+    cube_size, cube_size, -cube_size, r, g, b,
+    -cube_size, -cube_size, -cube_size, r, g, b,
+    -cube_size, cube_size, -cube_size, r, g, b,
+    // Triangle 3
+    cube_size, -cube_size, cube_size, r, g, b,
+    -cube_size, -cube_size, -cube_size, r, g, b,
+    cube_size, -cube_size, -cube_size, r, g, b,
+    // Triangle 4
+    cube_size, cube_size, -cube_size, r, g, b,
+    cube_size, -cube_size, -cube_size, r, g, b,
+    -cube_size, -cube_size, -cube_size, r, g, b,
+    // Triangle 5
+    -cube_size, -cube_size, -cube_size, r, g, b,
+    -cube_size, cube_size, cube_size, r, g, b,
+    -cube_size, cube_size, -cube_size, r, g, b,
+    // Triangle 6
+    cube_size, -cube_size, cube_size, r, g, b,
+    -cube_size, -cube_size, cube_size, r, g, b,
+    -cube_size, -cube_size, -cube_size, r, g, b,
+    // Triangle 7
+    -cube_size, cube_size, cube_size, r, g, b,
+    -cube_size, -cube_size, cube_size, r, g, b,
+    cube_size, -cube_size, cube_size, r, g, b,
+    // Triangle 8
+    cube_size, cube_size, cube_size, r, g, b,
+    cube_size, -cube_size, -cube_size, r, g, b,
+    cube_size, cube_size, -cube_size, r, g, b,
+    // Triangle 9
+    cube_size, -cube_size, -cube_size, r, g, b,
+    cube_size, cube_size, cube_size, r, g, b,
+    cube_size, -cube_size, cube_size, r, g, b,
+    // Triangle 10
+    cube_size, cube_size, cube_size, r, g, b,
+    cube_size, cube_size, -cube_size, r, g, b,
+    -cube_size, cube_size, -cube_size, r, g, b,
+    // Triangle 11
+    cube_size, cube_size, cube_size, r, g, b,
+    -cube_size, cube_size, -cube_size, r, g, b,
+    -cube_size, cube_size, cube_size, r, g, b,
+    // Triangle 12
+    cube_size, cube_size, cube_size, r, g, b,
+    -cube_size, cube_size, cube_size, r, g, b,
+    cube_size, -cube_size, cube_size, r, g, b
+    // Triangle 12 : end
+  };
+  const size_t nb_triangles = 12;
+  const size_t vertices_per_triangle = 3;
+  const size_t nb_vertices = vertices_per_triangle * nb_triangles;
+  const size_t vertex_buffer_size = sizeof(float) * 6 * nb_vertices;
+  // clang-format on
+
+  // VAO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+
+  // VBO
+  glGenBuffers(1, &VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, vertices, GL_STATIC_DRAW);
+  // -- Position attribute
+  size_t vertex_size = 6 * sizeof(float);
+  void *pos_offset = (void *) 0;
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, pos_offset);
+  glEnableVertexAttribArray(0);
+  // -- Color attribute
+  void *color_offset = (void *) (3 * sizeof(float));
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, color_offset);
+  glEnableVertexAttribArray(1);
+
+  // Clean up
+  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
+  glBindVertexArray(0);             // Unbind VAO
+}
+
+glcube_t::~glcube_t() {
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteBuffers(1, &VBO_);
+}
+
+void glcube_t::draw(const glcamera_t &camera) {
+  glcamera_ubo_use(camera);
+  program().use();
+  program_->set(model_loc_, T_SM_);
+
+  // 12 x 3 indices starting at 0 -> 12 triangles -> 6 squares
+  glBindVertexArray(VAO_);
+  glDrawArrays(GL_TRIANGLES, 0, 36);
+  glBindVertexArray(0); // Unbind VAO
+}
+
+glcubes_t::glcubes_t() : globj_t{shaders::glcubes_vs, shaders::glcube_fs} {
+  // Unit cube, faces wound counter-clockwise when seen from outside
+  // clang-format off
+  static const GLfloat vertices[] = {
+    -0.5f, -0.5f, -0.5f,
+     0.5f, -0.5f, -0.5f,
+     0.5f,  0.5f, -0.5f,
+    -0.5f,  0.5f, -0.5f,
+    -0.5f, -0.5f,  0.5f,
+     0.5f, -0.5f,  0.5f,
+     0.5f,  0.5f,  0.5f,
+    -0.5f,  0.5f,  0.5f
+  };
+  static const GLushort indices[] = {
+    0, 3, 2, 0, 2, 1, // -z
+    4, 5, 6, 4, 6, 7, // +z
+    0, 4, 7, 0, 7, 3, // -x
+    1, 2, 6, 1, 6, 5, // +x
+    0, 1, 5, 0, 5, 4, // -y
+    3, 7, 6, 3, 6, 2  // +y
+  };
+  // clang-format on
+
+  // VAO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+
+  // VBO
+  glGenBuffers(1, &VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  // -- Position attribute
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *) 0);
+  glEnableVertexAttribArray(0);
+
+  // EBO
+  glGenBuffers(1, &EBO_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               sizeof(indices),
+               indices,
+               GL_STATIC_DRAW);
+
+  // Instance VBO
+  glGenBuffers(1, &instance_VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_VBO_);
+  const size_t instance_size = sizeof(glcube_instance_t);
+  // -- Transform attribute, a mat4 takes up 4 attribute locations
+  for (int i = 0; i < 4; i++) {
+    void *col_offset = (void *) (offsetof(glcube_instance_t, T) + i * 16);
+    glVertexAttribPointer(1 + i,
+                          4,
+                          GL_FLOAT,
+                          GL_FALSE,
+                          instance_size,
+                          col_offset);
+    glEnableVertexAttribArray(1 + i);
+    glVertexAttribDivisor(1 + i, 1);
+  }
+  // -- Color and size attribute
+  void *color_offset = (void *) offsetof(glcube_instance_t, color);
+  glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, instance_size, color_offset);
+  glEnableVertexAttribArray(5);
+  glVertexAttribDivisor(5, 1);
+
+  // Clean up
+  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
+  glBindVertexArray(0);             // Unbind VAO
+}
+
+glcubes_t::~glcubes_t() {
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteBuffers(1, &VBO_);
+  glDeleteBuffers(1, &EBO_);
+  glDeleteBuffers(1, &instance_VBO_);
+}
+
+size_t glcubes_t::size() const { return instances_.size(); }
+
+size_t glcubes_t::add(const glm::mat4 &T,
+                      const glm::vec3 &color,
+                      const float size) {
+  instances_.push_back({T, color, size});
+  dirty_flags_.push_back(false);
+  update(instances_.size() - 1, T, color, size);
+  return instances_.size() - 1;
+}
+
+void glcubes_t::update(const size_t idx,
+                       const glm::mat4 &T,
+                       const glm::vec3 &color,
+                       const float size) {
+  assert(idx < instances_.size());
+  instances_[idx] = {T, color, size};
+  if (dirty_flags_[idx] == false) {
+    dirty_flags_[idx] = true;
+    dirty_.push_back(idx);
+  }
+}
+
+// Removes an instance by moving the last instance into its slot. Returns the
+// previous index of the moved instance, which equals `idx` if it was the last.
+size_t glcubes_t::remove(const size_t idx) {
+  assert(idx < instances_.size());
+  const size_t last = instances_.size() - 1;
+  if (idx != last) {
+    const glcube_instance_t &moved = instances_[last];
+    update(idx, moved.T, moved.color, moved.size);
+  }
+  instances_.pop_back();
+  dirty_flags_.pop_back();
+  return last;
+}
+
+void glcubes_t::clear() {
+  instances_.clear();
+  dirty_.clear();
+  dirty_flags_.clear();
+}
+
+void glcubes_t::upload() {
+  const size_t instance_size = sizeof(glcube_instance_t);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_VBO_);
+
+  if (instances_.size() > capacity_) {
+    // Grow the instance buffer and upload everything
+    capacity_ = std::max(instances_.size(), std::max(capacity_ * 2, (size_t) 64));
+    glBufferData(GL_ARRAY_BUFFER,
+                 capacity_ * instance_size,
+                 NULL,
+                 GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    0,
+                    instances_.size() * instance_size,
+                    instances_.data());
+
+  } else if (dirty_.size()) {
+    // Upload contiguous runs of modified instances only
+    std::sort(dirty_.begin(), dirty_.end());
+    dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+    size_t i = 0;
+    while (i < dirty_.size()) {
+      const size_t start = dirty_[i];
+      size_t end = start + 1;
+      while (i + 1 < dirty_.size() && dirty_[i + 1] == end) {
+        end++;
+        i++;
+      }
+      i++;
+
+      // Instances removed after being modified are skipped
+      end = std::min(end, instances_.size());
+      if (start < end) {
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        start * instance_size,
+                        (end - start) * instance_size,
+                        &instances_[start]);
+      }
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  for (const auto idx : dirty_) {
+    if (idx < dirty_flags_.size()) {
+      dirty_flags_[idx] = false;
+    }
+  }
+  dirty_.clear();
+}
+
+void glcubes_t::draw(const glcamera_t &camera) {
+  glcamera_ubo_use(camera);
+  upload();
+  if (instances_.size() == 0) {
+    return;
+  }
+
+  program().use();
+  program_->set(model_loc_, T_SM_);
+
+  // 36 indices per cube -> 12 triangles -> 6 squares
+  glBindVertexArray(VAO_);
+  glDrawElementsInstanced(GL_TRIANGLES,
+                          36,
+                          GL_UNSIGNED_SHORT,
+                          0,
+                          instances_.size());
+  glBindVertexArray(0); // Unbind VAO
+}
+
+void glpoint_attributes() {
+  const size_t stride = sizeof(glpoint_t);
+  // -- Position attribute
+  void *pos_offset = (void *) offsetof(glpoint_t, pos);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, pos_offset);
+  glEnableVertexAttribArray(0);
+  // -- Color attribute
+  void *color_offset = (void *) offsetof(glpoint_t, color);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, color_offset);
+  glEnableVertexAttribArray(1);
+  // -- Intensity attribute
+  void *intensity_offset = (void *) offsetof(glpoint_t, intensity);
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, intensity_offset);
+  glEnableVertexAttribArray(2);
+}
+
+glpoints_t::glpoints_t(const size_t capacity)
+    : globj_t{shaders::glpoints_vs, shaders::glpoints_fs} {
+  persistent_ = GLAD_GL_ARB_buffer_storage;
+  VBO_ = 0;
+  glGenVertexArrays(1, &VAO_);
+  reserve(capacity);
+}
+
+glpoints_t::~glpoints_t() {
+  for (auto &fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteBuffers(1, &VBO_);
+}
+
+size_t glpoints_t::size() const { return size_; }
+
+// Grows the point buffer to hold at least `capacity` points per region
+void glpoints_t::reserve(const size_t capacity) {
+  if (capacity <= capacity_) {
+    return;
+  }
+  allocate(std::max(capacity, capacity_ * 2), nb_regions_);
+}
+
+// Buffer storage is immutable so a new buffer is always created and the
+// points already uploaded are copied over on the GPU into the first region
+void glpoints_t::allocate(const size_t capacity, const int nb_regions) {
+  const size_t nb_bytes = nb_regions * capacity * sizeof(glpoint_t);
+  const GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  GLuint VBO;
+  glGenBuffers(1, &VBO);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+  if (persistent_) {
+    glBufferStorage(GL_COPY_WRITE_BUFFER, nb_bytes, NULL, flags);
+  } else {
+    glBufferData(GL_COPY_WRITE_BUFFER, nb_bytes, NULL, GL_DYNAMIC_DRAW);
+  }
+  if (size_) {
+    glBindBuffer(GL_COPY_READ_BUFFER, VBO_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                        GL_COPY_WRITE_BUFFER,
+                        region_ * capacity_ * sizeof(glpoint_t),
+                        0,
+                        size_ * sizeof(glpoint_t));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  }
+  if (persistent_) {
+    mapped_ = (glpoint_t *) glMapBufferRange(GL_COPY_WRITE_BUFFER,
+                                             0,
+                                             nb_bytes,
+                                             flags);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  // Deleting the old buffer also unmaps it
+  if (VBO_) {
+    glDeleteBuffers(1, &VBO_);
+  }
+  VBO_ = VBO;
+  capacity_ = capacity;
+  nb_regions_ = nb_regions;
+
+  // Regions of the new buffer are not read by any draw yet
+  region_ = 0;
+  for (auto &fence : fences_) {
+    if (fence) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+
+  // Point attributes
+  glBindVertexArray(VAO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glpoint_attributes();
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+void glpoints_t::clear() { size_ = 0; }
+
+void glpoints_t::set(const glpoint_t *points, const size_t n) {
+  write(true, n, points, nullptr, nullptr, nullptr);
+}
+
+void glpoints_t::set(const float *xyz,
+                     const uint8_t *rgba,
+                     const float *intensity,
+                     const size_t n) {
+  write(true, n, nullptr, xyz, rgba, intensity);
+}
+
+void glpoints_t::append(const glpoint_t *points, const size_t n) {
+  write(false, n, points, nullptr, nullptr, nullptr);
+}
+
+void glpoints_t::append(const float *xyz,
+                        const uint8_t *rgba,
+                        const float *intensity,
+                        const size_t n) {
+  write(false, n, nullptr, xyz, rgba, intensity);
+}
+
+void glpoints_t::write(const bool replace,
+                       const size_t n,
+                       const glpoint_t *points,
+                       const float *xyz,
+                       const uint8_t *rgba,
+                       const float *intensity) {
+  if (n == 0) {
+    return;
+  }
+  const double t0 = glfwGetTime();
+
+  // Replaced points need not be copied when growing
+  if (replace) {
+    size_ = 0;
+  }
+  const size_t offset = size_;
+  reserve(offset + n);
+
+  // Map destination
+  glpoint_t *dst = nullptr;
+  if (persistent_) {
+    // A single region still being drawn is split into the ring. Nothing
+    // needs copying, the old buffer lives on until its draws complete.
+    if (replace && nb_regions_ == 1 && fences_[0]) {
+      const GLenum status = glClientWaitSync(fences_[0], 0, 0);
+      if (status == GL_TIMEOUT_EXPIRED) {
+        allocate(capacity_, GLPOINTS_NB_REGIONS);
+      } else {
+        glDeleteSync(fences_[0]);
+        fences_[0] = nullptr;
+      }
+    }
+
+    // A replace moves on to the next region, which is only still being read
+    // if the GPU is more than two draws behind
+    if (replace && nb_regions_ > 1) {
+      region_ = (region_ + 1) % nb_regions_;
+      GLsync &fence = fences_[region_];
+      if (fence) {
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+          stats_.nb_stalls++;
+          while (status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence,
+                                      GL_SYNC_FLUSH_COMMANDS_BIT,
+                                      1000000000);
+          }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+      }
+    }
+    dst = mapped_ + region_ * capacity_ + offset;
+
+  } else {
+    // Orphan the buffer on replace, appends write past the drawn points
+    GLbitfield access = GL_MAP_WRITE_BIT;
+    if (replace) {
+      access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+    } else {
+      access |= GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+    dst = (glpoint_t *) glMapBufferRange(GL_ARRAY_BUFFER,
+                                         offset * sizeof(glpoint_t),
+                                         n * sizeof(glpoint_t),
+                                         access);
+  }
+
+  // Write points
+  if (points) {
+    memcpy(dst, points, n * sizeof(glpoint_t));
+  } else {
+    for (size_t i = 0; i < n; i++) {
+      glpoint_t &p = dst[i];
+      p.pos = glm::vec3{xyz[i * 3 + 0], xyz[i * 3 + 1], xyz[i * 3 + 2]};
+      if (rgba) {
+        memcpy(p.color, &rgba[i * 4], 4);
+      } else {
+        memset(p.color, 255, 4);
+      }
+      p.intensity = (intensity) ? intensity[i] : 1.0f;
+    }
+  }
+
+  if (persistent_ == false) {
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  size_ = offset + n;
+
+  stats_.nb_uploads++;
+  stats_.nb_points += n;
+  stats_.nb_bytes += n * sizeof(glpoint_t);
+  stats_.upload_time += glfwGetTime() - t0;
+}
+
+void glpoints_t::print_stats() const {
+  const double mb = stats_.nb_bytes / (1024.0 * 1024.0);
+  LOG_INFO("Points [%s]: %zu uploads, %zu points, %.1f MB in %.3f s "
+           "(%.1f MB/s), %zu stalls",
+           (persistent_) ? "persistent" : "orphaned",
+           stats_.nb_uploads,
+           stats_.nb_points,
+           mb,
+           stats_.upload_time,
+           (stats_.upload_time > 0.0) ? mb / stats_.upload_time : 0.0,
+           stats_.nb_stalls);
+}
+
+void glpoints_t::draw(const glcamera_t &camera) {
+  if (size_ == 0) {
+    return;
+  }
+
+  if (program_ == nullptr) {
+    program();
+    point_size_loc_ = program_->uniform("point_size");
+    point_scale_loc_ = program_->uniform("point_scale");
+  }
+
+  // Pixels per meter at unit distance
+  float point_scale = 0.0f;
+  if (attenuate_) {
+    point_scale = camera.screen_height * camera.projection()[1][1] * 0.5f;
+  }
+
+  glcamera_ubo_use(camera);
+  program_->use();
+  program_->set(model_loc_, T_SM_);
+  program_->set(point_size_loc_, point_size_);
+  program_->set(point_scale_loc_, point_scale);
+
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  glBindVertexArray(VAO_);
+  glDrawArrays(GL_POINTS, region_ * capacity_, size_);
+  glBindVertexArray(0); // Unbind VAO
+  glDisable(GL_PROGRAM_POINT_SIZE);
+
+  // Fence the draw so a later replace knows when the region is free
+  if (persistent_) {
+    GLsync &fence = fences_[region_];
+    if (fence) {
+      glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+}
+
+glframe_t::glframe_t() : globj_t{shaders::glframe_vs, shaders::glframe_fs} {
+  // Vertices
+  // clang-format off
+  static const GLfloat vertices[] = {
+    // Line 1 : x-axis + color
+    0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    // Line 2 : y-axis + color
+    0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+    // Line 3 : z-axis + color
+    0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f
+  };
+  const size_t nb_vertices = 6;
+  const size_t buffer_size = sizeof(GLfloat) * 6 * nb_vertices;
+  // clang-format on
+
+  // VAO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+
+  // VBO
+  glGenBuffers(1, &VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glBufferData(GL_ARRAY_BUFFER, buffer_size, vertices, GL_STATIC_DRAW);
+  // -- Position attribute
+  size_t vertex_size = 6 * sizeof(float);
+  void *pos_offset = (void *) 0;
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertex_size, pos_offset);
+  glEnableVertexAttribArray(0);
+  // -- Color attribute
+  void *color_offset = (void *) (3 * sizeof(float));
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, vertex_size, color_offset);
+  glEnableVertexAttribArray(1);
+
+  // Clean up
+  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
+  glBindVertexArray(0);             // Unbind VAO
+}
+
+glframe_t::~glframe_t() {
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteBuffers(1, &VBO_);
+}
+
+void glframe_t::draw(const glcamera_t &camera) {
+  glcamera_ubo_use(camera);
+  program().use();
+  program_->set(model_loc_, T_SM_);
+
+  // Store original line width
+  float original_line_width = 0.0f;
+  glGetFloatv(GL_LINE_WIDTH, &original_line_width);
+
+  // Set line width
+  glLineWidth(line_width_);
+
+  // Draw frame
+  glBindVertexArray(VAO_);
+  glDrawArrays(GL_LINES, 0, 6);
+  glBindVertexArray(0); // Unbind VAO
+
+  // Restore original line width
+  glLineWidth(original_line_width);
+}
+
+static GLfloat *glgrid_create_vertices(int grid_size) {
+  // Allocate memory for vertices
+  int nb_lines = (grid_size + 1) * 2;
+  int nb_vertices = nb_lines * 2;
+  const size_t buffer_size = sizeof(GLfloat) * nb_vertices * 3;
+  GLfloat *vertices = (GLfloat *) malloc(buffer_size);
+
+  // Setup
+  const float min_x = -1.0f * (float) grid_size / 2.0f;
+  const float max_x = (float) grid_size / 2.0f;
+  const float min_z = -1.0f * (float) grid_size / 2.0f;
+  const float max_z = (float) grid_size / 2.0f;
+
+  // Row vertices
+  float z = min_z;
+  int vert_idx = 0;
+  for (int i = 0; i < ((grid_size + 1) * 2); i++) {
+    if ((i % 2) == 0) {
+      vertices[(vert_idx * 3)] = min_x;
+      vertices[(vert_idx * 3) + 1] = 0.0f;
+      vertices[(vert_idx * 3) + 2] = z;
+    } else {
+      vertices[(vert_idx * 3)] = max_x;
+      vertices[(vert_idx * 3) + 1] = 0.0f;
+      vertices[(vert_idx * 3) + 2] = z;
+      z += 1.0f;
+    }
+    vert_idx++;
+  }
+
+  // Column vertices
+  float x = min_x;
+  for (int j = 0; j < ((grid_size + 1) * 2); j++) {
+    if ((j % 2) == 0) {
+      vertices[(vert_idx * 3)] = x;
+      vertices[(vert_idx * 3) + 1] = 0.0f;
+      vertices[(vert_idx * 3) + 2] = min_z;
+    } else {
+      vertices[(vert_idx * 3)] = x;
+      vertices[(vert_idx * 3) + 1] = 0.0f;
+      vertices[(vert_idx * 3) + 2] = max_z;
+      x += 1.0f;
+    }
+    vert_idx++;
+  }
+
+  return vertices;
+}
+
+glgrid_t::glgrid_t() : globj_t{shaders::glgrid_vs, shaders::glgrid_fs} {
+  // Create vertices
+  const int nb_lines = (grid_size_ + 1) * 2;
+  const int nb_vertices = nb_lines * 2;
+  GLfloat *vertices = glgrid_create_vertices(grid_size_);
+  const size_t buffer_size = sizeof(GLfloat) * nb_vertices * 3;
+
+  // VAO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+
+  // VBO
+  glGenBuffers(1, &VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glBufferData(GL_ARRAY_BUFFER, buffer_size, vertices, GL_STATIC_DRAW);
+  glVertexAttribPointer(0,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        3 * sizeof(float),
+                        (void *) 0);
+  glEnableVertexAttribArray(0);
+
+  // Clean up
+  glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind VBO
+  glBindVertexArray(0);             // Unbind VAO
+  free(vertices);
+}
+
+glgrid_t::~glgrid_t() {
+  glDeleteVertexArrays(1, &VAO_);
+  glDeleteBuffers(1, &VBO_);
+}
+
+void glgrid_t::draw(const glcamera_t &camera) {
+  glcamera_ubo_use(camera);
+  program().use();
+  program_->set(model_loc_, T_SM_);
+
+  const int nb_lines = (grid_size_ + 1) * 2;
+  const int nb_vertices = nb_lines * 2;
+
+  glBindVertexArray(VAO_);
+  glDrawArrays(GL_LINES, 0, nb_vertices);
+  glBindVertexArray(0); // Unbind VAO
+}
+
+glplane_t::glplane_t(const std::string &image_path)
+    : globj_t{shaders::glplane_vs, shaders::glplane_fs}, image_path_{
+                                                             image_path} {
+  // clang-format off
+  const float vertices[] = {
+    // Positions         // Colors           // Texture coords
+    0.5f,  0.5f,  0.0f,  1.0f, 1.0f, 1.0f,   1.0f, 1.0f,  // Top right
+    0.5f, -0.5f,  0.0f,  1.0f, 1.0f, 1.0f,   1.0f, 0.0f,  // Bottom right
+    -0.5f, -0.5f, 0.0f,  1.0f, 1.0f, 1.0f,   0.0f, 0.0f,  // Bottom left
+    -0.5f,  0.5f, 0.0f,  1.0f, 1.0f, 1.0f,   0.0f, 1.0f   // Top left
+  };
+  const unsigned int indices[] = {
+    0, 1, 3, // first triangle
+    1, 2, 3  // second triangle
+  };
+  // clang-format on
+
+  // VAO
+  glGenVertexArrays(1, &VAO_);
+  glBindVertexArray(VAO_);
+
+  // VBO
+  glGenBuffers(1, &VBO_);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+  // -- Position attribute
+  const void *pos_offset = (void *) 0;
+  glVertexAttribPointer(0,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        8 * sizeof(float),
+                        pos_offset);
+  glEnableVertexAttribArray(0);
+  // -- Color attribute
+  void *color_offset = (void *) (3 * sizeof(float));
+  glVertexAttribPointer(1,
+                        3,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        8 * sizeof(float),
+                        color_offset);
+  glEnableVertexAttribArray(1);
+  // -- Texture coord attribute
+  void *texture_offset = (void *) (6 * sizeof(float));
+  glVertexAttribPointer(2,
+                        2,
+                        GL_FLOAT,
+                        GL_FALSE,
+                        8 * sizeof(float),
+                        texture_offset);
+  glEnableVertexAttribArray(2);
+
+  // EBO
+  glGenBuffers(1, &EBO_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               sizeof(indices),
+               indices,
+               GL_STATIC_DRAW);
+
+  // FBO
+  glGenFramebuffers(1, &FBO_);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+
+  // Load and create a texture
+  texture_ = load_texture(image_path_, img_width_, img_height_, img_channels_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER,
+                         GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_2D,
+                         texture_,
+                         0);
+
+  // Render buffer
+  unsigned int rbo;
+  glGenRenderbuffers(1, &rbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+  glRenderbufferStorage(GL_RENDERBUFFER,
+                        GL_DEPTH24_STENCIL8,
+                        img_width_,
+                        img_height_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                            GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER,
+                            rbo);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    printf("Framebuffer is not complete!\n");
+  }
+
+  // Clean up
+  glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind FBO
+  glBindBuffer(GL_ARRAY_BUFFER, 0);     // Unbind VBO
+  glBindVertexArray(0);                 // Unbind VAO
+}
+
+void glplane_t::draw(const glcamera_t &camera) {
+  glcamera_ubo_use(camera);
+  // glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+  // glEnable(GL_DEPTH_TEST);
+  // glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+  // glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  program().use();
+  // program.set("projection", camera.projection());
+  // program.set("view", camera.view());
+  // program.set("model", T_SM);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindVertexArray(VAO_);
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+  glBindVertexArray(0); // Unbind VAO
+
+  // glDisable(GL_DEPTH_TEST);
+  // glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/*****************************************************************************
+ *                                 VOXELS
+ ****************************************************************************/
+
+static inline size_t voxchunk_index(const int lx, const int ly, const int lz) {
+  return lx + VOXCHUNK_SIZE * (ly + VOXCHUNK_SIZE * lz);
+}
+
+voxmap_t::voxmap_t(const float voxel_size_) : voxel_size{voxel_size_} {
+  for (auto &color : palette) {
+    color = glm::vec3{0.9, 0.4, 0.2};
+  }
+}
+
+uint64_t voxmap_t::key(const int cx, const int cy, const int cz) {
+  // 21 bits per axis, enough for +-2^20 chunks
+  const uint64_t mask = (1 << 21) - 1;
+  const uint64_t x = (uint64_t) cx & mask;
+  const uint64_t y = (uint64_t) cy & mask;
+  const uint64_t z = (uint64_t) cz & mask;
+  return (x << 42) | (y << 21) | z;
+}
+
+voxchunk_t *voxmap_t::chunk(const int cx, const int cy, const int cz) const {
+  const auto it = chunks.find(key(cx, cy, cz));
+  return (it == chunks.end()) ? nullptr : it->second.get();
+}
+
+uint8_t voxmap_t::get(const int x, const int y, const int z) const {
+  const voxchunk_t *c = chunk(x >> VOXCHUNK_BITS,
+                              y >> VOXCHUNK_BITS,
+                              z >> VOXCHUNK_BITS);
+  if (c == nullptr) {
+    return 0;
+  }
+
+  const int n = VOXCHUNK_SIZE - 1;
+  return c->voxels[voxchunk_index(x & n, y & n, z & n)];
+}
+
+void voxmap_t::set(const int x,
+                   const int y,
+                   const int z,
+                   const uint8_t material) {
+  const int cx = x >> VOXCHUNK_BITS;
+  const int cy = y >> VOXCHUNK_BITS;
+  const int cz = z >> VOXCHUNK_BITS;
+  const int n = VOXCHUNK_SIZE - 1;
+  const int lx = x & n;
+  const int ly = y & n;
+  const int lz = z & n;
+
+  // Allocate chunk on demand
+  voxchunk_t *c = chunk(cx, cy, cz);
+  if (c == nullptr) {
+    if (material == 0) {
+      return;
+    }
+
+    std::unique_ptr<voxchunk_t> new_chunk{new voxchunk_t()};
+    new_chunk->cx = cx;
+    new_chunk->cy = cy;
+    new_chunk->cz = cz;
+    c = new_chunk.get();
+    chunks[key(cx, cy, cz)] = std::move(new_chunk);
+  }
+
+  // Update voxel
+  uint8_t &voxel = c->voxels[voxchunk_index(lx, ly, lz)];
+  if (voxel == material) {
+    return;
+  } else if (voxel == 0) {
+    c->nb_occupied++;
+    nb_voxels++;
+  } else if (material == 0) {
+    c->nb_occupied--;
+    nb_voxels--;
+  }
+  voxel = material;
+
+  // Faces of neighbouring chunks change when a boundary voxel changes
+  mark_dirty(cx, cy, cz);
+  if (lx == 0) mark_dirty(cx - 1, cy, cz);
+  if (lx == n) mark_dirty(cx + 1, cy, cz);
+  if (ly == 0) mark_dirty(cx, cy - 1, cz);
+  if (ly == n) mark_dirty(cx, cy + 1, cz);
+  if (lz == 0) mark_dirty(cx, cy, cz - 1);
+  if (lz == n) mark_dirty(cx, cy, cz + 1);
+}
+
+void voxmap_t::add(const glm::vec3 &p, const uint8_t material) {
+  set(floor(p.x / voxel_size),
+      floor(p.y / voxel_size),
+      floor(p.z / voxel_size),
+      material);
+}
+
+void voxmap_t::remove(const glm::vec3 &p) { add(p, 0); }
+
+void voxmap_t::mark_dirty(const int cx, const int cy, const int cz) {
+  voxchunk_t *c = chunk(cx, cy, cz);
+  if (c && c->dirty == false) {
+    c->dirty = true;
+    dirty.push_back(key(cx, cy, cz));
+  }
+}
+
+void voxmap_t::mesh(const voxchunk_t &chunk,
+                    std::vector<voxvertex_t> &vertices) const {
+  const int N = VOXCHUNK_SIZE;
+
+  // Neighbouring chunks, indexed by axis and side
+  const voxchunk_t *neighbours[3][2] = {
+      {this->chunk(chunk.cx - 1, chunk.cy, chunk.cz),
+       this->chunk(chunk.cx + 1, chunk.cy, chunk.cz)},
+      {this->chunk(chunk.cx, chunk.cy - 1, chunk.cz),
+       this->chunk(chunk.cx, chunk.cy + 1, chunk.cz)},
+      {this->chunk(chunk.cx, chunk.cy, chunk.cz - 1),
+       this->chunk(chunk.cx, chunk.cy, chunk.cz + 1)}};
+
+  // Voxel lookup where at most one coordinate lies outside the chunk
+  const auto voxel = [&](const int p[3]) -> uint8_t {
+    for (int d = 0; d < 3; d++) {
+      if (p[d] < 0 || p[d] >= N) {
+        const voxchunk_t *neighbour = neighbours[d][p[d] >= N];
+        if (neighbour == nullptr) {
+          return 0;
+        }
+
+        int q[3] = {p[0], p[1], p[2]};
+        q[d] = p[d] & (N - 1);
+        return neighbour->voxels[voxchunk_index(q[0], q[1], q[2])];
+      }
+    }
+    return chunk.voxels[voxchunk_index(p[0], p[1], p[2])];
+  };
+
+  // Simple directional shading: -x, +x, -y, +y, -z, +z
+  const float shade[6] = {0.8f, 0.8f, 0.5f, 1.0f, 0.65f, 0.65f};
+
+  uint8_t mask[VOXCHUNK_SIZE * VOXCHUNK_SIZE];
+  for (int d = 0; d < 3; d++) {
+    const int u = (d + 1) % 3;
+    const int v = (d + 2) % 3;
+
+    for (int side = 0; side < 2; side++) {
+      for (int i = 0; i < N; i++) {
+        // Mask of faces in this slice that are exposed on this side, only
+        // the outermost slices need to look into neighbouring chunks
+        const int j = i + ((side) ? 1 : -1);
+        const bool inside = (j >= 0 && j < N);
+        for (int b = 0; b < N; b++) {
+          for (int a = 0; a < N; a++) {
+            int p[3];
+            p[d] = i;
+            p[u] = a;
+            p[v] = b;
+            const uint8_t m = chunk.voxels[voxchunk_index(p[0], p[1], p[2])];
+            if (m == 0) {
+              mask[a + b * N] = 0;
+              continue;
+            }
+
+            p[d] = j;
+            const uint8_t next = (inside)
+                                     ? chunk.voxels[voxchunk_index(p[0],
+                                                                   p[1],
+                                                                   p[2])]
+                                     : voxel(p);
+            mask[a + b * N] = (next == 0) ? m : 0;
+          }
+        }
+
+        // Greedily merge faces of the same material into rectangles
+        for (int b = 0; b < N; b++) {
+          for (int a = 0; a < N;) {
+            const uint8_t m = mask[a + b * N];
+            if (m == 0) {
+              a++;
+              continue;
+            }
+
+            // Extend along u, then along v while the whole row matches
+            int w = 1;
+            while (a + w < N && mask[a + w + b * N] == m) {
+              w++;
+            }
+            int h = 1;
+            for (; b + h < N; h++) {
+              bool row_ok = true;
+              for (int k = 0; k < w; k++) {
+                if (mask[a + k + (b + h) * N] != m) {
+                  row_ok = false;
+                  break;
+                }
+              }
+              if (row_ok == false) {
+                break;
+              }
+            }
+
+            // Emit quad, counter-clockwise when seen from outside
+            const int corners[4][2] = {{a, b},
+                                       {a + w, b},
+                                       {a + w, b + h},
+                                       {a, b + h}};
+            const int order[2][4] = {{0, 3, 2, 1}, {0, 1, 2, 3}};
+            const glm::vec3 color = palette[m] * shade[d * 2 + side] * 255.0f;
+            for (int k = 0; k < 4; k++) {
+              const int *corner = corners[order[side][k]];
+              voxvertex_t vertex;
+              vertex.pos[d] = i + side;
+              vertex.pos[u] = corner[0];
+              vertex.pos[v] = corner[1];
+              vertex.pos[3] = 0;
+              vertex.color[0] = color.x;
+              vertex.color[1] = color.y;
+              vertex.color[2] = color.z;
+              vertex.color[3] = 255;
+              vertices.push_back(vertex);
+            }
+
+            // Clear merged faces
+            for (int l = 0; l < h; l++) {
+              for (int k = 0; k < w; k++) {
+                mask[a + k + (b + l) * N] = 0;
+              }
+            }
+            a += w;
+          }
+        }
+      }
+    }
+  }
+}
+
+glvoxels_t::glvoxels_t(const float voxel_size)
+    : globj_t{shaders::glvoxel_vs, shaders::glvoxel_fs}, map_{voxel_size} {
+  // Quad index buffer shared by all chunks, grown on demand
+  glGenBuffers(1, &EBO_);
+}
+
+glvoxels_t::~glvoxels_t() {
+  for (auto &kv : gpu_chunks_) {
+    glDeleteVertexArrays(1, &kv.second.VAO);
+    glDeleteBuffers(1, &kv.second.VBO);
+  }
+  glDeleteBuffers(1, &EBO_);
+}
+
+void glvoxels_t::add(const glm::vec3 &p, const uint8_t material) {
+  map_.add(p, material);
+}
+
+void glvoxels_t::remove(const glm::vec3 &p) { map_.remove(p); }
+
+size_t glvoxels_t::remesh(const size_t max_chunks) {
+  size_t nb_remeshed = 0;
+
+  while (map_.dirty.size() && nb_remeshed < max_chunks) {
+    const uint64_t key = map_.dirty.back();
+    map_.dirty.pop_back();
+    const auto it = map_.chunks.find(key);
+    if (it == map_.chunks.end()) {
+      continue;
+    }
+    voxchunk_t &chunk = *it->second;
+    chunk.dirty = false;
+
+    // Release empty chunks
+    glvoxchunk_t &gpu = gpu_chunks_[key];
+    if (chunk.nb_occupied == 0) {
+      glDeleteVertexArrays(1, &gpu.VAO);
+      glDeleteBuffers(1, &gpu.VBO);
+      gpu_chunks_.erase(key);
+      map_.chunks.erase(it);
+      continue;
+    }
+
+    // Mesh chunk
+    vertices_.clear();
+    map_.mesh(chunk, vertices_);
+    gpu.nb_quads = vertices_.size() / 4;
+    const glm::vec3 origin{chunk.cx * VOXCHUNK_SIZE * map_.voxel_size,
+                           chunk.cy * VOXCHUNK_SIZE * map_.voxel_size,
+                           chunk.cz * VOXCHUNK_SIZE * map_.voxel_size};
+    gpu.T = glm::translate(glm::mat4(1.0f), origin);
+    gpu.T = glm::scale(gpu.T, glm::vec3(map_.voxel_size));
+
+    // Grow shared quad index buffer
+    if (gpu.nb_quads > max_quads_) {
+      max_quads_ = std::max(gpu.nb_quads, max_quads_ * 2);
+      std::vector<GLuint> indices;
+      indices.reserve(max_quads_ * 6);
+      for (GLuint q = 0; q < max_quads_; q++) {
+        const GLuint quad[6] = {0, 1, 2, 0, 2, 3};
+        for (const auto idx : quad) {
+          indices.push_back(q * 4 + idx);
+        }
+      }
+      // Not bound as an element buffer so no VAO state is touched
+      glBindBuffer(GL_COPY_WRITE_BUFFER, EBO_);
+      glBufferData(GL_COPY_WRITE_BUFFER,
+                   indices.size() * sizeof(GLuint),
+                   indices.data(),
+                   GL_STATIC_DRAW);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // Upload
+    if (gpu.VAO == 0) {
+      glGenVertexArrays(1, &gpu.VAO);
+      glBindVertexArray(gpu.VAO);
+      glGenBuffers(1, &gpu.VBO);
+      glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+      // -- Position attribute
+      const size_t vertex_size = sizeof(voxvertex_t);
+      void *pos_offset = (void *) offsetof(voxvertex_t, pos);
+      glVertexAttribPointer(0,
+                            3,
+                            GL_UNSIGNED_BYTE,
+                            GL_FALSE,
+                            vertex_size,
+                            pos_offset);
+      glEnableVertexAttribArray(0);
+      // -- Color attribute
+      void *color_offset = (void *) offsetof(voxvertex_t, color);
+      glVertexAttribPointer(1,
+                            3,
+                            GL_UNSIGNED_BYTE,
+                            GL_TRUE,
+                            vertex_size,
+                            color_offset);
+      glEnableVertexAttribArray(1);
+      glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.VBO);
+    glBufferData(GL_ARRAY_BUFFER,
+                 vertices_.size() * sizeof(voxvertex_t),
+                 vertices_.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    nb_remeshed++;
+  }
+
+  return nb_remeshed;
+}
+
+void glvoxels_t::draw(const glcamera_t &camera) {
+  remesh(remesh_budget_);
+  if (gpu_chunks_.empty()) {
+    return;
+  }
+
+  glcamera_ubo_use(camera);
+  program().use();
+
+  // Frustum in the voxel map frame
+  const glfrustum_t frustum{camera.projection() * camera.view() * T_SM_};
+  const float chunk_size = VOXCHUNK_SIZE * map_.voxel_size;
+  for (const auto &kv : gpu_chunks_) {
+    const glvoxchunk_t &gpu = kv.second;
+    const glm::vec3 min{gpu.T[3]};
+    if (frustum.visible(min, min + glm::vec3(chunk_size)) == false) {
+      continue;
+    }
+
+    program_->set(model_loc_, T_SM_ * gpu.T);
+    glBindVertexArray(gpu.VAO);
+    glDrawElements(GL_TRIANGLES, gpu.nb_quads * 6, GL_UNSIGNED_INT, 0);
+  }
+  glBindVertexArray(0); // Unbind VAO
+}
+
+gloctomap_t::gloctomap_t() {}
+
+gloctomap_t::gloctomap_t(const octomap::OcTree &tree) { load(tree); }
+
+uint64_t gloctomap_t::cell_key(const octomap::OcTreeKey &key,
+                               const unsigned int level) const {
+  const uint64_t cx = key[0] >> level;
+  const uint64_t cy = key[1] >> level;
+  const uint64_t cz = key[2] >> level;
+  return (cx << 32) | (cy << 16) | cz;
+}
+
+uint64_t gloctomap_t::block_key(const octomap::OcTreeKey &key) const {
+  return cell_key(key, block_bits_);
+}
+
+uint64_t gloctomap_t::parent_key(const uint64_t block,
+                                 const unsigned int level) const {
+  const unsigned int shift = level - block_bits_;
+  const uint64_t cx = ((block >> 32) & 0xFFFF) >> shift;
+  const uint64_t cy = ((block >> 16) & 0xFFFF) >> shift;
+  const uint64_t cz = (block & 0xFFFF) >> shift;
+  return (cx << 32) | (cy << 16) | cz;
+}
+
+unsigned int gloctomap_t::covering_level(const uint64_t block) const {
+  for (unsigned int level = block_bits_ + 1; level <= 16; level++) {
+    if (coarse_[level].count(parent_key(block, level))) {
+      return level;
+    }
+  }
+  return 0;
+}
+
+void gloctomap_t::add_box(const uint64_t block,
+                          const unsigned int level,
+                          const glm::vec3 &center,
+                          const float size) {
+  const glm::mat4 T = glm::translate(glm::mat4(1.0f), center);
+  const size_t slot = cubes_.add(T, color_, size);
+  if (level <= block_bits_) {
+    blocks_[block].push_back(slot);
+    slot_keys_.push_back(block);
+  } else {
+    const uint64_t cell = parent_key(block, level);
+    coarse_[level][cell] = slot;
+    slot_keys_.push_back(cell);
+  }
+  slot_levels_.push_back(level);
+}
+
+void gloctomap_t::remove_slots(std::vector<size_t> &slots) {
+  // Remove from the back so that every moved instance is one that is kept,
+  // then point its index entry at the instance's new slot
+  std::sort(slots.rbegin(), slots.rend());
+  for (const auto slot : slots) {
+    const size_t moved = cubes_.remove(slot);
+    if (moved != slot) {
+      const uint64_t key = slot_keys_[moved];
+      const unsigned int level = slot_levels_[moved];
+      slot_keys_[slot] = key;
+      slot_levels_[slot] = level;
+      if (level <= block_bits_) {
+        auto &moved_slots = blocks_[key];
+        *std::find(moved_slots.begin(), moved_slots.end(), moved) = slot;
+      } else {
+        coarse_[level][key] = slot;
+      }
+    }
+    slot_keys_.pop_back();
+    slot_levels_.pop_back();
+  }
+}
+
+void gloctomap_t::remove_block(const uint64_t block) {
+  std::vector<size_t> slots;
+  auto it = blocks_.find(block);
+  if (it != blocks_.end()) {
+    slots = std::move(it->second);
+    blocks_.erase(it);
+  }
+
+  const unsigned int level = covering_level(block);
+  if (level) {
+    auto &cells = coarse_[level];
+    auto cell = cells.find(parent_key(block, level));
+    slots.push_back(cell->second);
+    cells.erase(cell);
+  }
+
+  remove_slots(slots);
+}
+
+void gloctomap_t::remove_within(const uint64_t cell,
+                                const unsigned int level) {
+  // Scans the listed boxes rather than the blocks of the region, which can
+  // be billions for a leaf near the root
+  std::vector<size_t> slots;
+  for (auto it = blocks_.begin(); it != blocks_.end();) {
+    if (parent_key(it->first, level) == cell) {
+      slots.insert(slots.end(), it->second.begin(), it->second.end());
+      it = blocks_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (unsigned int l = block_bits_ + 1; l <= level; l++) {
+    const unsigned int shift = level - l;
+    for (auto it = coarse_[l].begin(); it != coarse_[l].end();) {
+      const uint64_t x = ((it->first >> 32) & 0xFFFF) >> shift;
+      const uint64_t y = ((it->first >> 16) & 0xFFFF) >> shift;
+      const uint64_t z = (it->first & 0xFFFF) >> shift;
+      if (((x << 32) | (y << 16) | z) == cell) {
+        slots.push_back(it->second);
+        it = coarse_[l].erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  remove_slots(slots);
+}
+
+void gloctomap_t::build_region(const octomap::OcTree &tree,
+                               const uint64_t cell,
+                               const unsigned int level) {
+  const unsigned int tree_depth = tree.getTreeDepth();
+  const octomap::key_type span = (1 << level) - 1;
+  const octomap::OcTreeKey min_key{
+      (octomap::key_type) (((cell >> 32) & 0xFFFF) << level),
+      (octomap::key_type) (((cell >> 16) & 0xFFFF) << level),
+      (octomap::key_type) ((cell & 0xFFFF) << level)};
+  const octomap::OcTreeKey max_key{(octomap::key_type) (min_key[0] + span),
+                                   (octomap::key_type) (min_key[1] + span),
+                                   (octomap::key_type) (min_key[2] + span)};
+
+  auto it = tree.begin_leafs_bbx(min_key, max_key);
+  for (; it != tree.end_leafs_bbx(); ++it) {
+    if (tree.isNodeOccupied(*it) == false) {
+      continue;
+    }
+
+    const unsigned int leaf_level = tree_depth - it.getDepth();
+    const octomap::OcTreeKey &key = it.getKey();
+    octomap::OcTreeKey leaf_min;
+    for (int i = 0; i < 3; i++) {
+      leaf_min[i] = (key[i] >> leaf_level) << leaf_level;
+    }
+    const octomap::point3d c = it.getCoordinate();
+    const glm::vec3 center{c.x(), c.y(), c.z()};
+    if (leaf_level <= level) {
+      add_box(block_key(leaf_min), leaf_level, center, it.getSize());
+      continue;
+    }
+
+    // A leaf coarser than the region covers all of it. Parts of it that were
+    // not rebuilt may still hold the boxes it was pruned from.
+    remove_within(cell_key(leaf_min, leaf_level), leaf_level);
+    add_box(block_key(leaf_min), leaf_level, center, it.getSize());
+    break;
+  }
+}
+
+void gloctomap_t::build_block(const octomap::OcTree &tree,
+                              const uint64_t block) {
+  // Already built with a region or covered by a coarse box added meanwhile
+  if (blocks_.count(block) || covering_level(block)) {
+    return;
+  }
+  build_region(tree, block, block_bits_);
+}
+
+void gloctomap_t::load(const octomap::OcTree &tree) {
+  cubes_.clear();
+  blocks_.clear();
+  for (auto &cells : coarse_) {
+    cells.clear();
+  }
+  slot_keys_.clear();
+  slot_levels_.clear();
+
+  const unsigned int tree_depth = tree.getTreeDepth();
+  for (auto it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+    if (tree.isNodeOccupied(*it) == false) {
+      continue;
+    }
+
+    const unsigned int level = tree_depth - it.getDepth();
+    const octomap::OcTreeKey &key = it.getKey();
+    octomap::OcTreeKey leaf_min;
+    for (int i = 0; i < 3; i++) {
+      leaf_min[i] = (key[i] >> level) << level;
+    }
+    const octomap::point3d c = it.getCoordinate();
+    add_box(block_key(leaf_min), level, {c.x(), c.y(), c.z()}, it.getSize());
+  }
+}
+
+size_t gloctomap_t::update(octomap::OcTree &tree) {
+  if (tree.isChangeDetectionEnabled() == false) {
+    LOG_WARN("OcTree change detection disabled, enabling and reloading!");
+    tree.enableChangeDetection(true);
+    tree.resetChangeDetection();
+    load(tree);
+    return blocks_.size();
+  }
+
+  // Blocks containing at least one changed key
+  std::vector<uint64_t> changed;
+  changed.reserve(tree.numChangesDetected());
+  for (auto it = tree.changedKeysBegin(); it != tree.changedKeysEnd(); ++it) {
+    changed.push_back(block_key(it->first));
+  }
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+  // Coarse boxes over changed blocks are dropped with them, their whole
+  // region is rebuilt in one pass over the tree
+  std::vector<std::pair<unsigned int, uint64_t>> regions;
+  for (const auto block : changed) {
+    const unsigned int level = covering_level(block);
+    if (level) {
+      regions.emplace_back(level, parent_key(block, level));
+    }
+  }
+  std::sort(regions.begin(), regions.end());
+  regions.erase(std::unique(regions.begin(), regions.end()), regions.end());
+
+  for (const auto block : changed) {
+    remove_block(block);
+  }
+  for (const auto &region : regions) {
+    build_region(tree, region.second, region.first);
+  }
+  for (const auto block : changed) {
+    build_block(tree, block);
+  }
+  tree.resetChangeDetection();
+
+  return changed.size();
+}
+
+void gloctomap_t::draw(const glcamera_t &camera) { cubes_.draw(camera); }
+
+/*****************************************************************************
+ *                              POINT CLOUDS
+ ****************************************************************************/
+
+// Subsampling grid cell of a point inside a node cube
+static uint32_t pcloud_cell(const glm::vec3 &p,
+                            const glm::vec3 &min,
+                            const float size,
+                            const int grid_size) {
+  const glm::vec3 r = (p - min) / size * (float) grid_size;
+  const int x = std::min(std::max((int) r.x, 0), grid_size - 1);
+  const int y = std::min(std::max((int) r.y, 0), grid_size - 1);
+  const int z = std::min(std::max((int) r.z, 0), grid_size - 1);
+  return (x * grid_size + y) * grid_size + z;
+}
+
+// Child octant of a point inside a node cube, bit 2 is x, bit 1 y and bit 0 z
+static int pcloud_octant(const glm::vec3 &p,
+                         const glm::vec3 &min,
+                         const float size) {
+  const glm::vec3 mid = min + glm::vec3(size * 0.5f);
+  return ((p.x >= mid.x) << 2) | ((p.y >= mid.y) << 1) | (p.z >= mid.z);
+}
+
+static glm::vec3 pcloud_child_min(const glm::vec3 &min,
+                                  const float size,
+                                  const int octant) {
+  const float half = size * 0.5f;
+  return min + glm::vec3{(octant & 4) ? half : 0.0f,
+                         (octant & 2) ? half : 0.0f,
+                         (octant & 1) ? half : 0.0f};
+}
+
+struct pcloud_builder_t {
+  pcloud_build_config_t config;
+  FILE *fp = nullptr;
+  uint64_t offset = 0;
+  std::vector<pcloud_node_t> nodes;
+};
+
+static pcloud_node_t pcloud_node(const glm::vec3 &min,
+                                 const float size,
+                                 const int grid_size) {
+  pcloud_node_t node;
+  node.min[0] = min.x;
+  node.min[1] = min.y;
+  node.min[2] = min.z;
+  node.size = size;
+  node.spacing = size / grid_size;
+  node.nb_points = 0;
+  node.offset = 0;
+  for (int i = 0; i < 8; i++) {
+    node.children[i] = -1;
+  }
+  return node;
+}
+
+static int pcloud_write_points(pcloud_builder_t &builder,
+                               const int node_idx,
+                               const std::vector<glpoint_t> &points) {
+  pcloud_node_t &node = builder.nodes[node_idx];
+  node.offset = builder.offset;
+  node.nb_points = points.size();
+  const size_t n = points.size();
+  if (fwrite(points.data(), sizeof(glpoint_t), n, builder.fp) != n) {
+    return -1;
+  }
+  builder.offset += n * sizeof(glpoint_t);
+  return 0;
+}
+
+// Builds the subtree of `points` in memory into `node`, -1 if there are no
+// points. Nodes are added in pre-order. Returns -1 if a write failed.
+static int pcloud_build_node(pcloud_builder_t &builder,
+                             std::vector<glpoint_t> &points,
+                             const glm::vec3 &min,
+                             const float size,
+                             const int depth,
+                             int &node) {
+  node = -1;
+  if (points.empty()) {
+    return 0;
+  }
+  const int grid_size = builder.config.grid_size;
+  const int idx = builder.nodes.size();
+  builder.nodes.push_back(pcloud_node(min, size, grid_size));
+  node = idx;
+
+  // Small or deep nodes keep all their points, which also stops duplicate
+  // points from recursing forever
+  const bool leaf = points.size() <= builder.config.max_leaf_points ||
+                    depth >= builder.config.max_depth;
+  if (leaf) {
+    return pcloud_write_points(builder, idx, points);
+  }
+
+  // Keep the first point of every grid cell, pass the rest to the children
+  std::vector<glpoint_t> sampled;
+  std::vector<glpoint_t> children[8];
+  std::unordered_set<uint32_t> cells;
+  cells.reserve(points.size());
+  for (const auto &p : points) {
+    if (cells.insert(pcloud_cell(p.pos, min, size, grid_size)).second) {
+      sampled.push_back(p);
+    } else {
+      children[pcloud_octant(p.pos, min, size)].push_back(p);
+    }
+  }
+  std::vector<glpoint_t>().swap(points);
+  cells = std::unordered_set<uint32_t>();
+  if (pcloud_write_points(builder, idx, sampled) != 0) {
+    return -1;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    const glm::vec3 child_min = pcloud_child_min(min, size, i);
+    int child = -1;
+    if (pcloud_build_node(builder,
+                          children[i],
+                          child_min,
+                          size * 0.5f,
+                          depth + 1,
+                          child) != 0) {
+      return -1;
+    }
+    builder.nodes[idx].children[i] = child;
+  }
+
+  return 0;
+}
+
+// Top levels of the octree sampled while streaming, level order
+struct pcloud_top_node_t {
+  std::unordered_set<uint32_t> cells;
+  std::vector<glpoint_t> points;
+};
+
+static int pcloud_top_index(const glm::vec3 &p,
+                            const glm::vec3 &min,
+                            const float size,
+                            const int level) {
+  const int n = 1 << level;
+  const int offset = ((1 << (3 * level)) - 1) / 7;
+  const glm::vec3 r = (p - min) / size * (float) n;
+  const int x = std::min(std::max((int) r.x, 0), n - 1);
+  const int y = std::min(std::max((int) r.y, 0), n - 1);
+  const int z = std::min(std::max((int) r.z, 0), n - 1);
+  return offset + (x * n + y) * n + z;
+}
+
+static glm::vec3 pcloud_top_min(const glm::vec3 &min,
+                                const float size,
+                                const int level,
+                                const int idx) {
+  const int n = 1 << level;
+  const int cell = idx - ((1 << (3 * level)) - 1) / 7;
+  const int x = cell / (n * n);
+  const int y = (cell / n) % n;
+  const int z = cell % n;
+  return min + glm::vec3{(float) x, (float) y, (float) z} * (size / n);
+}
+
+int pcloud_build(pcloud_reader_t reader,
+                 const std::string &output_path,
+                 const pcloud_build_config_t &config) {
+  // Spool the input to disk and find its bounds
+  const std::string spool_path = output_path + ".spool";
+  FILE *spool = fopen(spool_path.c_str(), "wb");
+  if (spool == NULL) {
+    LOG_ERROR("Failed to open [%s]!", spool_path.c_str());
+    return -1;
+  }
+  glm::vec3 lo{FLT_MAX};
+  glm::vec3 hi{-FLT_MAX};
+  uint64_t nb_points = 0;
+  std::vector<glpoint_t> batch;
+  size_t n = 0;
+  while ((n = reader(batch)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      lo = glm::min(lo, batch[i].pos);
+      hi = glm::max(hi, batch[i].pos);
+    }
+    if (fwrite(batch.data(), sizeof(glpoint_t), n, spool) != n) {
+      LOG_ERROR("Failed to write [%s]!", spool_path.c_str());
+      fclose(spool);
+      remove(spool_path.c_str());
+      return -1;
+    }
+    nb_points += n;
+  }
+  if (fclose(spool) != 0) {
+    LOG_ERROR("Failed to write [%s]!", spool_path.c_str());
+    remove(spool_path.c_str());
+    return -1;
+  }
+  if (nb_points == 0) {
+    LOG_ERROR("No points to build [%s] from!", output_path.c_str());
+    remove(spool_path.c_str());
+    return -1;
+  }
+
+  // Cubic bounds, slightly enlarged so the max point falls inside
+  const glm::vec3 extent = hi - lo;
+  const float size =
+      std::max({extent.x, extent.y, extent.z, 1e-6f}) * 1.0001f;
+  const glm::vec3 min = lo;
+
+  // Bucket level so that evenly spread buckets fit in memory
+  int depth = 0;
+  while (depth < 4 && (nb_points >> (3 * depth)) > config.max_bucket_points) {
+    depth++;
+  }
+  const int nb_top = ((1 << (3 * depth)) - 1) / 7;
+  const int nb_buckets = 1 << (3 * depth);
+  std::vector<pcloud_top_node_t> top(nb_top);
+
+  // Sample the top levels and split the remaining points into buckets. Bucket
+  // files stay open until all points are split, batches share one bucket's
+  // worth of memory.
+  const size_t bucket_batch =
+      std::max(config.max_bucket_points / nb_buckets, (size_t) 1024);
+  std::vector<std::vector<glpoint_t>> buffers(nb_buckets);
+  std::vector<FILE *> bucket_fps(nb_buckets, nullptr);
+  std::vector<bool> bucket_used(nb_buckets, false);
+  auto bucket_path = [&](const int b) {
+    return output_path + ".bucket" + std::to_string(b);
+  };
+  auto flush_bucket = [&](const int b) {
+    if (bucket_fps[b] == nullptr) {
+      bucket_fps[b] = fopen(bucket_path(b).c_str(), "wb");
+      if (bucket_fps[b] == nullptr) {
+        return false;
+      }
+      bucket_used[b] = true;
+    }
+    const size_t n = buffers[b].size();
+    if (fwrite(buffers[b].data(), sizeof(glpoint_t), n, bucket_fps[b]) != n) {
+      return false;
+    }
+    buffers[b].clear();
+    return true;
+  };
+  auto close_buckets = [&]() {
+    bool ok = true;
+    for (auto &fp : bucket_fps) {
+      if (fp && fclose(fp) != 0) {
+        ok = false;
+      }
+      fp = nullptr;
+    }
+    return ok;
+  };
+  auto remove_buckets = [&]() {
+    for (int b = 0; b < nb_buckets; b++) {
+      if (bucket_used[b]) {
+        remove(bucket_path(b).c_str());
+      }
+    }
+  };
+  auto read_bucket = [&](const int b, std::vector<glpoint_t> &points) {
+    FILE *fp = fopen(bucket_path(b).c_str(), "rb");
+    if (fp == nullptr) {
+      return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    const long bytes = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    points.resize((bytes > 0) ? bytes / sizeof(glpoint_t) : 0);
+    const size_t n = fread(points.data(), sizeof(glpoint_t), points.size(), fp);
+    fclose(fp);
+    return (bytes >= 0 && n == points.size()) ? 0 : -1;
+  };
+
+  spool = fopen(spool_path.c_str(), "rb");
+  if (spool == NULL) {
+    LOG_ERROR("Failed to open [%s]!", spool_path.c_str());
+    remove(spool_path.c_str());
+    return -1;
+  }
+  batch.resize(65536);
+  while ((n = fread(batch.data(), sizeof(glpoint_t), batch.size(), spool))) {
+    for (size_t i = 0; i < n; i++) {
+      const glpoint_t &p = batch[i];
+
+      bool claimed = false;
+      for (int level = 0; level < depth && claimed == false; level++) {
+        const int idx = pcloud_top_index(p.pos, min, size, level);
+        const float node_size = size / (1 << level);
+        const glm::vec3 node_min = pcloud_top_min(min, size, level, idx);
+        const uint32_t cell =
+            pcloud_cell(p.pos, node_min, node_size, config.grid_size);
+        if (top[idx].cells.insert(cell).second) {
+          top[idx].points.push_back(p);
+          claimed = true;
+        }
+      }
+      if (claimed) {
+        continue;
+      }
+
+      const int b = pcloud_top_index(p.pos, min, size, depth) - nb_top;
+      buffers[b].push_back(p);
+      if (buffers[b].size() >= bucket_batch && !flush_bucket(b)) {
+        LOG_ERROR("Failed to write [%s]!", bucket_path(b).c_str());
+        fclose(spool);
+        remove(spool_path.c_str());
+        close_buckets();
+        remove_buckets();
+        return -1;
+      }
+    }
+  }
+  fclose(spool);
+  remove(spool_path.c_str());
+  for (int b = 0; b < nb_buckets; b++) {
+    if (buffers[b].size() && !flush_bucket(b)) {
+      LOG_ERROR("Failed to write [%s]!", bucket_path(b).c_str());
+      close_buckets();
+      remove_buckets();
+      return -1;
+    }
+    std::vector<glpoint_t>().swap(buffers[b]);
+  }
+  if (close_buckets() == false) {
+    LOG_ERROR("Failed to write buckets of [%s]!", output_path.c_str());
+    remove_buckets();
+    return -1;
+  }
+
+  // Output file, the header is rewritten once the node table is known. Any
+  // failure from here removes the partial output and the remaining buckets.
+  pcloud_builder_t builder;
+  builder.config = config;
+  auto fail = [&](const char *msg, const std::string &path) {
+    LOG_ERROR("%s [%s]!", msg, path.c_str());
+    if (builder.fp) {
+      fclose(builder.fp);
+      remove(output_path.c_str());
+    }
+    remove_buckets();
+    return -1;
+  };
+  builder.fp = fopen(output_path.c_str(), "wb");
+  if (builder.fp == NULL) {
+    return fail("Failed to open", output_path);
+  }
+  pcloud_header_t header;
+  memset(&header, 0, sizeof(header));
+  if (fwrite(&header, sizeof(header), 1, builder.fp) != 1) {
+    return fail("Failed to write", output_path);
+  }
+  builder.offset = sizeof(header);
+  for (int level = 0; level < depth; level++) {
+    for (int i = 0; i < (1 << (3 * level)); i++) {
+      const int idx = ((1 << (3 * level)) - 1) / 7 + i;
+      const glm::vec3 node_min = pcloud_top_min(min, size, level, idx);
+      builder.nodes.push_back(
+          pcloud_node(node_min, size / (1 << level), config.grid_size));
+    }
+  }
+
+  // Bucket subtrees, linked to their parent in the deepest top level
+  for (int b = 0; b < nb_buckets; b++) {
+    if (bucket_used[b] == false) {
+      continue;
+    }
+    std::vector<glpoint_t> points;
+    if (read_bucket(b, points) != 0) {
+      return fail("Failed to read", bucket_path(b));
+    }
+    remove(bucket_path(b).c_str());
+    bucket_used[b] = false;
+
+    const int idx = nb_top + b;
+    const float bucket_size = size / (1 << depth);
+    const glm::vec3 bucket_min = pcloud_top_min(min, size, depth, idx);
+    int node = -1;
+    if (pcloud_build_node(builder,
+                          points,
+                          bucket_min,
+                          bucket_size,
+                          depth,
+                          node) != 0) {
+      return fail("Failed to write", output_path);
+    }
+    if (depth > 0) {
+      const glm::vec3 center = bucket_min + glm::vec3(bucket_size * 0.5f);
+      const int parent = pcloud_top_index(center, min, size, depth - 1);
+      const glm::vec3 parent_min = pcloud_top_min(min, size, depth - 1, parent);
+      const int octant = pcloud_octant(center, parent_min, bucket_size * 2.0f);
+      builder.nodes[parent].children[octant] = node;
+    }
+  }
+
+  // Top level points, linking non-empty nodes to their parents bottom up
+  for (int level = depth - 1; level >= 0; level--) {
+    for (int i = 0; i < (1 << (3 * level)); i++) {
+      const int idx = ((1 << (3 * level)) - 1) / 7 + i;
+      if (pcloud_write_points(builder, idx, top[idx].points) != 0) {
+        return fail("Failed to write", output_path);
+      }
+      std::vector<glpoint_t>().swap(top[idx].points);
+      top[idx].cells = std::unordered_set<uint32_t>();
+
+      const pcloud_node_t &node = builder.nodes[idx];
+      bool empty = (node.nb_points == 0);
+      for (int j = 0; j < 8; j++) {
+        empty = empty && (node.children[j] == -1);
+      }
+      if (level == 0 || empty) {
+        continue;
+      }
+
+      const float node_size = node.size;
+      const glm::vec3 center =
+          glm::vec3{node.min[0], node.min[1], node.min[2]} +
+          glm::vec3(node_size * 0.5f);
+      const int parent = pcloud_top_index(center, min, size, level - 1);
+      const glm::vec3 parent_min = pcloud_top_min(min, size, level - 1, parent);
+      const int octant = pcloud_octant(center, parent_min, node_size * 2.0f);
+      builder.nodes[parent].children[octant] = idx;
+    }
+  }
+
+  // Node table footer and header
+  memcpy(header.magic, "SHOWPCO1", 8);
+  header.nb_points = nb_points;
+  header.nb_nodes = builder.nodes.size();
+  header.nodes_offset = builder.offset;
+  const size_t nb_nodes = builder.nodes.size();
+  if (fwrite(builder.nodes.data(),
+             sizeof(pcloud_node_t),
+             nb_nodes,
+             builder.fp) != nb_nodes ||
+      fseek(builder.fp, 0, SEEK_SET) != 0 ||
+      fwrite(&header, sizeof(header), 1, builder.fp) != 1) {
+    return fail("Failed to write", output_path);
+  }
+  const int retval = fclose(builder.fp);
+  builder.fp = nullptr;
+  if (retval != 0) {
+    remove(output_path.c_str());
+    return fail("Failed to write", output_path);
+  }
+
+  LOG_INFO("Built [%s]: %llu points, %zu nodes",
+           output_path.c_str(),
+           (unsigned long long) nb_points,
+           builder.nodes.size());
+
+  return 0;
+}
+
+glpcloud_t::glpcloud_t(const std::string &path)
+    : globj_t{shaders::glpoints_vs, shaders::glpoints_fs} {
+  // Map file
+  fd_ = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd_ == -1 || fstat(fd_, &st) != 0) {
+    FATAL("Failed to open point cloud [%s]!", path.c_str());
+  }
+  data_size_ = st.st_size;
+  void *data = mmap(NULL, data_size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    FATAL("Failed to map point cloud [%s]!", path.c_str());
+  }
+  data_ = (const uint8_t *) data;
+
+  // Check header and node table
+  pcloud_header_t header;
+  if (data_size_ < sizeof(header)) {
+    FATAL("Invalid point cloud [%s]!", path.c_str());
+  }
+  memcpy(&header, data_, sizeof(header));
+  const size_t table_size = header.nb_nodes * sizeof(pcloud_node_t);
+  if (memcmp(header.magic, "SHOWPCO1", 8) != 0 || header.nb_nodes == 0 ||
+      header.nodes_offset + table_size > data_size_) {
+    FATAL("Invalid point cloud [%s]!", path.c_str());
+  }
+  nodes_ = (const pcloud_node_t *) (data_ + header.nodes_offset);
+  nb_nodes_ = header.nb_nodes;
+  gpu_nodes_.resize(nb_nodes_);
+
+  loader_ = std::thread(&glpcloud_t::loader, this);
+}
+
+glpcloud_t::~glpcloud_t() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  loader_.join();
+
+  for (const auto idx : resident_) {
+    glDeleteVertexArrays(1, &gpu_nodes_[idx].VAO);
+    glDeleteBuffers(1, &gpu_nodes_[idx].VBO);
+  }
+  munmap((void *) data_, data_size_);
+  close(fd_);
+}
 
-  // EBO
-  glGenBuffers(1, &EBO_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               sizeof(indices),
-               indices,
-               GL_STATIC_DRAW);
+// Background thread reading requested nodes, the copy pages the points in
+// from disk off the render thread
+void glpcloud_t::loader() {
+  while (true) {
+    int idx = -1;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&] { return stop_ || requests_.size(); });
+      if (stop_) {
+        return;
+      }
+      idx = requests_.front();
+      requests_.pop_front();
+    }
 
-  // FBO
-  glGenFramebuffers(1, &FBO_);
-  glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+    const pcloud_node_t &node = nodes_[idx];
+    std::vector<glpoint_t> points(node.nb_points);
+    if (node.offset + node.nb_points * sizeof(glpoint_t) <= data_size_) {
+      memcpy(points.data(),
+             data_ + node.offset,
+             node.nb_points * sizeof(glpoint_t));
+    } else {
+      points.clear();
+    }
 
-  // Load and create a texture
-  texture_ = load_texture(image_path_, img_width_, img_height_, img_channels_);
-  glFramebufferTexture2D(GL_FRAMEBUFFER,
-                         GL_COLOR_ATTACHMENT0,
-                         GL_TEXTURE_2D,
-                         texture_,
-                         0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded_.emplace_back(idx, std::move(points));
+  }
+}
 
-  // Render buffer
-  unsigned int rbo;
-  glGenRenderbuffers(1, &rbo);
-  glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-  glRenderbufferStorage(GL_RENDERBUFFER,
-                        GL_DEPTH24_STENCIL8,
-                        img_width_,
-                        img_height_);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER,
-                            GL_DEPTH_STENCIL_ATTACHMENT,
-                            GL_RENDERBUFFER,
-                            rbo);
+// Frees least recently drawn nodes until `nb_bytes` more fit in the budget.
+// Nodes drawn in the last frame are kept.
+void glpcloud_t::evict(const size_t nb_bytes) {
+  if (stats_.gpu_bytes + nb_bytes <= gpu_budget_) {
+    return;
+  }
 
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-    printf("Framebuffer is not complete!\n");
+  std::sort(resident_.begin(), resident_.end(), [&](int a, int b) {
+    return gpu_nodes_[a].last_used < gpu_nodes_[b].last_used;
+  });
+  size_t nb_evicted = 0;
+  while (nb_evicted < resident_.size() &&
+         stats_.gpu_bytes + nb_bytes > gpu_budget_) {
+    glpcloud_node_t &node = gpu_nodes_[resident_[nb_evicted]];
+    if (node.last_used + 1 >= frame_) {
+      break;
+    }
+    glDeleteVertexArrays(1, &node.VAO);
+    glDeleteBuffers(1, &node.VBO);
+    stats_.gpu_bytes -= node.nb_bytes;
+    stats_.nb_evictions++;
+    node = glpcloud_node_t();
+    nb_evicted++;
   }
+  resident_.erase(resident_.begin(), resident_.begin() + nb_evicted);
+}
 
-  // Clean up
-  glBindFramebuffer(GL_FRAMEBUFFER, 0); // Unbind FBO
-  glBindBuffer(GL_ARRAY_BUFFER, 0);     // Unbind VBO
-  glBindVertexArray(0);                 // Unbind VAO
+void glpcloud_t::upload() {
+  std::vector<std::pair<int, std::vector<glpoint_t>>> loaded;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (loaded_.size() && loaded.size() < upload_budget_) {
+      loaded.push_back(std::move(loaded_.front()));
+      loaded_.pop_front();
+    }
+  }
+  if (loaded.empty()) {
+    return;
+  }
+
+  size_t nb_bytes = 0;
+  for (const auto &kv : loaded) {
+    nb_bytes += kv.second.size() * sizeof(glpoint_t);
+  }
+  evict(nb_bytes);
+
+  for (const auto &kv : loaded) {
+    glpcloud_node_t &node = gpu_nodes_[kv.first];
+    node.requested = false;
+    const size_t size = kv.second.size() * sizeof(glpoint_t);
+    if (size == 0 || stats_.gpu_bytes + size > gpu_budget_) {
+      continue;
+    }
+
+    glGenVertexArrays(1, &node.VAO);
+    glGenBuffers(1, &node.VBO);
+    glBindVertexArray(node.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, node.VBO);
+    glBufferData(GL_ARRAY_BUFFER, size, kv.second.data(), GL_STATIC_DRAW);
+    glpoint_attributes();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    node.nb_bytes = size;
+    node.last_used = frame_;
+    resident_.push_back(kv.first);
+    stats_.gpu_bytes += size;
+    stats_.nb_loads++;
+  }
 }
 
-void glplane_t::draw(const glcamera_t &camera) {
-  UNUSED(camera);
-  // glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
-  // glEnable(GL_DEPTH_TEST);
-  // glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-  // glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void glpcloud_t::draw(const glcamera_t &camera) {
+  frame_++;
+  upload();
+
+  // Camera position and frustum in the point cloud frame
+  const glm::mat4 VM = camera.view() * T_SM_;
+  const glm::vec3 eye{glm::inverse(VM)[3]};
+  const glfrustum_t frustum{camera.projection() * VM};
+  const float pixels_per_meter =
+      camera.screen_height * camera.projection()[1][1] * 0.5f;
+
+  // Refine nodes with the largest projected spacing first
+  std::vector<int> visible;
+  std::priority_queue<std::pair<float, int>> queue;
+  queue.push({FLT_MAX, 0});
+  size_t nb_points = 0;
+  while (queue.size()) {
+    const std::pair<float, int> top = queue.top();
+    queue.pop();
+    const pcloud_node_t &node = nodes_[top.second];
+    if (nb_points + node.nb_points > point_budget_) {
+      break;
+    }
+    visible.push_back(top.second);
+    nb_points += node.nb_points;
+    if (top.first < max_error_) {
+      continue;
+    }
 
-  program_.use();
-  // program.set("projection", camera.projection());
-  // program.set("view", camera.view());
-  // program.set("model", T_SM);
+    for (const auto child_idx : node.children) {
+      if (child_idx < 0 || (size_t) child_idx >= nb_nodes_) {
+        continue;
+      }
+      const pcloud_node_t &child = nodes_[child_idx];
+      const glm::vec3 min{child.min[0], child.min[1], child.min[2]};
+      const glm::vec3 max = min + glm::vec3(child.size);
+      if (frustum.visible(min, max) == false) {
+        continue;
+      }
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindVertexArray(VAO_);
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-  glBindVertexArray(0); // Unbind VAO
+      const glm::vec3 center = (min + max) * 0.5f;
+      const float radius = child.size * 0.866f;
+      const float dist = std::max(glm::length(eye - center) - radius,
+                                  camera.near);
+      queue.push({child.spacing * pixels_per_meter / dist, child_idx});
+    }
+  }
 
-  // glDisable(GL_DEPTH_TEST);
-  // glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  // Request missing nodes in refinement order, stale requests are dropped
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto idx : requests_) {
+      gpu_nodes_[idx].requested = false;
+    }
+    requests_.clear();
+    for (const auto idx : visible) {
+      glpcloud_node_t &node = gpu_nodes_[idx];
+      if (node.VAO == 0 && node.requested == false && nodes_[idx].nb_points) {
+        node.requested = true;
+        requests_.push_back(idx);
+      }
+    }
+  }
+  cv_.notify_one();
+
+  // Draw resident nodes
+  if (program_ == nullptr) {
+    program();
+    point_size_loc_ = program_->uniform("point_size");
+    point_scale_loc_ = program_->uniform("point_scale");
+  }
+  glcamera_ubo_use(camera);
+  program_->use();
+  program_->set(model_loc_, T_SM_);
+  program_->set(point_size_loc_, point_size_);
+  program_->set(point_scale_loc_, 0.0f);
+
+  stats_.nb_visible = visible.size();
+  stats_.nb_drawn = 0;
+  stats_.nb_points_drawn = 0;
+  glEnable(GL_PROGRAM_POINT_SIZE);
+  for (const auto idx : visible) {
+    glpcloud_node_t &node = gpu_nodes_[idx];
+    if (node.VAO == 0) {
+      continue;
+    }
+    node.last_used = frame_;
+    glBindVertexArray(node.VAO);
+    glDrawArrays(GL_POINTS, 0, nodes_[idx].nb_points);
+    stats_.nb_drawn++;
+    stats_.nb_points_drawn += nodes_[idx].nb_points;
+  }
+  glBindVertexArray(0); // Unbind VAO
+  glDisable(GL_PROGRAM_POINT_SIZE);
 }
 
 /*****************************************************************************
@@ -1409,6 +6040,16 @@ gui_t::gui_t(const std::string &title_, const int width_, const int height_)
   // Setup Platform/Renderer bindings
   ImGui_ImplGlfw_InitForOpenGL(gui, true);
   ImGui_ImplOpenGL3_Init(glsl_version);
+
+  // Compile built-in programs in the background if the driver can,
+  // otherwise they are compiled when objects are first drawn
+  shaders_parallel_init();
+  if (shaders_parallel_supported()) {
+    glprog_library_prefetch_builtin();
+  }
+
+  // Camera uniform buffer shared by all built-in shaders
+  camera_ubo = glcamera_ubo_create();
 }
 
 gui_t::gui_t(const std::string &title)
@@ -1419,6 +6060,7 @@ gui_t::~gui_t() {
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
 
+  glcamera_ubo_delete(camera_ubo);
   glfwDestroyWindow(gui);
   glfwTerminate();
 }
@@ -1439,6 +6081,9 @@ void gui_t::poll() {
 
   glfwGetWindowSize(gui, &width, &height);
   keyboard_cb(gui);
+
+  // Upload camera once per frame for all objects
+  glcamera_ubo_update(camera_ubo, camera);
 }
 
 void gui_t::clear() {
@@ -1456,6 +6101,9 @@ void gui_t::render(const bool clear_gui) {
   // glfwMakeContextCurrent(gui_);
 	glEnable(GL_CULL_FACE);
   glfwSwapBuffers(gui);
+
+  // Frame boundary for texture residency
+  gltexture_cache_trim();
 }
 
 void gui_t::loop(std::function<int()> cb) {
@@ -1544,6 +6192,35 @@ void gui_t::keyboard_cb(GLFWwindow *window) {
  *                               GUI IMSHOW
  ****************************************************************************/
 
+// Chroma planes round up for odd sizes
+static int imshow_chroma(const int size) { return (size + 1) / 2; }
+
+gui_imshow_frame_t &gui_imshow_frames_t::write_frame() {
+  return buffers[write];
+}
+
+void gui_imshow_frames_t::publish() {
+  buffers[write].seq = ++nb_published;
+  const int prev = middle.exchange(write | FRESH, std::memory_order_acq_rel);
+  if (prev & FRESH) {
+    nb_dropped++;
+  }
+  write = prev & ~FRESH;
+}
+
+bool gui_imshow_frames_t::consume() {
+  if ((middle.load(std::memory_order_acquire) & FRESH) == 0) {
+    return false;
+  }
+  read = middle.exchange(read, std::memory_order_acq_rel) & ~FRESH;
+  nb_consumed++;
+  return true;
+}
+
+const gui_imshow_frame_t &gui_imshow_frames_t::read_frame() const {
+  return buffers[read];
+}
+
 gui_imshow_t::gui_imshow_t(const std::string &title) : title_{title} {}
 
 gui_imshow_t::gui_imshow_t(const std::string &title,
@@ -1566,8 +6243,84 @@ gui_imshow_t::gui_imshow_t(const std::string &title,
   init(title, img_width, img_height, img_channels, data);
 }
 
+gui_imshow_t::gui_imshow_t(const std::string &title,
+                           const int img_width,
+                           const int img_height,
+                           const gui_imshow_format_t format,
+                           const unsigned char *data) {
+  init(title, img_width, img_height, format, data);
+}
+
+gui_imshow_t::~gui_imshow_t() {
+  for (auto &plane : planes_) {
+    glDeleteTextures(1, &plane.id);
+  }
+  for (auto &level : minmax_levels_) {
+    glDeleteTextures(1, &level.id);
+  }
+  if (minmax_fence_) {
+    glDeleteSync(minmax_fence_);
+  }
+  if (minmax_FBO_) {
+    glDeleteFramebuffers(1, &minmax_FBO_);
+    glDeleteBuffers(1, &minmax_PBO_);
+  }
+  if (convert_VAO_) {
+    glDeleteVertexArrays(1, &convert_VAO_);
+  }
+  for (auto &pbo : pbos_) {
+    if (pbo.fence) {
+      glDeleteSync(pbo.fence);
+    }
+    if (pbo.query) {
+      glDeleteQueries(1, &pbo.query);
+    }
+    glDeleteBuffers(1, &pbo.id);
+  }
+}
+
 bool gui_imshow_t::ok() { return ok_; }
 
+// Segment frames against an initialized window, channels only count for
+// direct images
+static bool imshow_shm_matches(const gui_imshow_t &imshow,
+                               const shm_header_t &header) {
+  if (imshow.ok_ == false) {
+    return true;
+  }
+  const bool direct = (header.format == IMSHOW_DIRECT);
+  return (int) header.width == imshow.img_width_ &&
+         (int) header.height == imshow.img_height_ &&
+         header.format == (uint32_t) imshow.format_ &&
+         (direct == false || (int) header.channels == imshow.img_channels_);
+}
+
+int gui_imshow_t::attach(const std::string &name) {
+  if (shm_.open(name) != 0) {
+    LOG_ERROR("Failed to attach imshow [%s] to [%s]!",
+              title_.c_str(),
+              name.c_str());
+    return -1;
+  }
+
+  const shm_header_t &header = *shm_.header_;
+  if (imshow_shm_matches(*this, header) == false) {
+    LOG_ERROR("Imshow [%s] is %dx%dx%d, [%s] has %dx%dx%d frames!",
+              title_.c_str(),
+              img_width_,
+              img_height_,
+              img_channels_,
+              name.c_str(),
+              header.width,
+              header.height,
+              header.channels);
+    shm_.close();
+    return -1;
+  }
+
+  return 0;
+}
+
 void gui_imshow_t::init(const std::string &title,
                         const int img_width,
                         const int img_height,
@@ -1610,28 +6363,545 @@ void gui_imshow_t::init(const std::string &title,
   ok_ = true;
 }
 
+void gui_imshow_t::init(const std::string &title,
+                        const int img_width,
+                        const int img_height,
+                        const gui_imshow_format_t format,
+                        const unsigned char *data) {
+  if (format == IMSHOW_DIRECT) {
+    FATAL("Direct images need a channel count!\n");
+  }
+
+  // RGBA target the conversion renders into
+  format_ = format;
+  init(title, img_width, img_height, 4, nullptr);
+
+  // Planes, offsets into a tightly packed frame
+  const int cw = imshow_chroma(img_width);
+  const int ch = imshow_chroma(img_height);
+  const size_t luma = (size_t) img_width * img_height;
+  switch (format) {
+    case IMSHOW_YUYV:
+      planes_.resize(1);
+      planes_[0] = {0, cw, img_height, 4, 0};
+      break;
+    case IMSHOW_NV12:
+      planes_.resize(2);
+      planes_[0] = {0, img_width, img_height, 1, 0};
+      planes_[1] = {0, cw, ch, 2, luma};
+      break;
+    case IMSHOW_I420:
+      planes_.resize(3);
+      planes_[0] = {0, img_width, img_height, 1, 0};
+      planes_[1] = {0, cw, ch, 1, luma};
+      planes_[2] = {0, cw, ch, 1, luma + (size_t) cw * ch};
+      break;
+    default:
+      planes_.resize(1);
+      planes_[0] = {0, img_width, img_height, 1, 0};
+      break;
+  }
+
+  const GLenum internal_formats[5] = {0, GL_R8, GL_RG8, 0, GL_RGBA8};
+  for (auto &plane : planes_) {
+    plane.internal_format = internal_formats[plane.channels];
+  }
+  if (format == IMSHOW_DEPTH16) {
+    planes_[0].internal_format = GL_R16;
+    planes_[0].type = GL_UNSIGNED_SHORT;
+  } else if (format == IMSHOW_FLOAT32) {
+    planes_[0].internal_format = GL_R32F;
+    planes_[0].type = GL_FLOAT;
+  }
+
+  for (auto &plane : planes_) {
+    glGenTextures(1, &plane.id);
+    glBindTexture(GL_TEXTURE_2D, plane.id);
+    glTexImage2D(GL_TEXTURE_2D,
+                 0,
+                 plane.internal_format,
+                 plane.width,
+                 plane.height,
+                 0,
+                 texture_format(plane.channels),
+                 plane.type,
+                 NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  convert_program_ = glprog_library_get(shaders::imshow_convert_vs,
+                                        shaders::imshow_convert_fs);
+  glGenVertexArrays(1, &convert_VAO_);
+
+  // Min / max levels, each 8x smaller, down to 1x1
+  if (format == IMSHOW_DEPTH16 || format == IMSHOW_FLOAT32) {
+    int w = img_width;
+    int h = img_height;
+    do {
+      w = (w + 7) / 8;
+      h = (h + 7) / 8;
+      gui_imshow_plane_t level;
+      level.width = w;
+      level.height = h;
+      level.channels = 2;
+      level.internal_format = GL_RG32F;
+      level.type = GL_FLOAT;
+      glGenTextures(1, &level.id);
+      glBindTexture(GL_TEXTURE_2D, level.id);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, w, h, 0, GL_RG, GL_FLOAT, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      minmax_levels_.push_back(level);
+    } while (w > 1 || h > 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    minmax_program_ = glprog_library_get(shaders::imshow_convert_vs,
+                                         shaders::imshow_minmax_fs);
+    glGenFramebuffers(1, &minmax_FBO_);
+    glGenBuffers(1, &minmax_PBO_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, minmax_PBO_);
+    glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float) * 2, NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+
+  if (data) {
+    upload(data);
+  }
+}
+
+void gui_imshow_t::stream(const size_t nb_buffers) {
+  if (ok_ == false || pbos_.size()) {
+    return;
+  }
+  persistent_ = GLAD_GL_ARB_buffer_storage;
+  const bool timer = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+  const GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  pbo_size_ =
+      gui_imshow_frame_size(format_, img_width_, img_height_, img_channels_);
+  pbo_index_ = 0;
+  pbos_.resize(std::max(nb_buffers, (size_t) 2));
+  for (auto &pbo : pbos_) {
+    glGenBuffers(1, &pbo.id);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.id);
+    if (persistent_) {
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, pbo_size_, NULL, flags);
+      pbo.mapped = (uint8_t *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                                0,
+                                                pbo_size_,
+                                                flags);
+    } else {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo_size_, NULL, GL_STREAM_DRAW);
+    }
+    if (timer) {
+      glGenQueries(1, &pbo.query);
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+uint8_t *gui_imshow_t::map() {
+  stream();
+  if (pbos_.empty()) {
+    return nullptr;
+  }
+  if (writing_) {
+    return writing_;
+  }
+  const double t0 = glfwGetTime();
+  gui_imshow_pbo_t &pbo = pbos_[pbo_index_];
+
+  // Collect the last copy out of this buffer if the GPU timed it already
+  if (pbo.query_pending) {
+    GLuint available = 0;
+    glGetQueryObjectuiv(pbo.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(pbo.query, GL_QUERY_RESULT, &elapsed);
+      stats_.last_gpu_time = elapsed * 1e-9;
+      stats_.gpu_time += stats_.last_gpu_time;
+      stats_.nb_gpu_samples++;
+    }
+    pbo.query_pending = false;
+  }
+
+  if (persistent_) {
+    // Wait for the copy still reading this buffer
+    if (pbo.fence) {
+      GLenum status = glClientWaitSync(pbo.fence, 0, 0);
+      if (status == GL_TIMEOUT_EXPIRED) {
+        stats_.nb_stalls++;
+        while (status == GL_TIMEOUT_EXPIRED) {
+          status = glClientWaitSync(pbo.fence,
+                                    GL_SYNC_FLUSH_COMMANDS_BIT,
+                                    1000000000);
+        }
+      }
+      glDeleteSync(pbo.fence);
+      pbo.fence = nullptr;
+    }
+    writing_ = pbo.mapped;
+
+  } else {
+    // Orphan the buffer so the driver never waits on a pending copy
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.id);
+    writing_ = (uint8_t *) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                            0,
+                                            pbo_size_,
+                                            GL_MAP_WRITE_BIT |
+                                                GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  map_time_ = glfwGetTime();
+  stats_.last_stall_time = map_time_ - t0;
+  stats_.stall_time += stats_.last_stall_time;
+
+  return writing_;
+}
+
+void gui_imshow_t::publish() {
+  if (writing_ == nullptr) {
+    return;
+  }
+  const double t0 = glfwGetTime();
+  gui_imshow_pbo_t &pbo = pbos_[pbo_index_];
+
+  // Texture copies source from the bound buffer
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo.id);
+  if (persistent_ == false) {
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+  if (pbo.query) {
+    glBeginQuery(GL_TIME_ELAPSED, pbo.query);
+  }
+  upload(nullptr);
+  if (pbo.query) {
+    glEndQuery(GL_TIME_ELAPSED);
+    pbo.query_pending = true;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // Fence the copy so the next map of this buffer knows when it is free
+  if (persistent_) {
+    pbo.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  writing_ = nullptr;
+  pbo_index_ = (pbo_index_ + 1) % pbos_.size();
+
+  const double t1 = glfwGetTime();
+  stats_.nb_frames++;
+  stats_.nb_bytes += pbo_size_;
+  stats_.last_upload_time = t1 - t0;
+  stats_.upload_time += stats_.last_upload_time;
+  stats_.last_latency = t1 - map_time_;
+  stats_.latency += stats_.last_latency;
+}
+
 void gui_imshow_t::update(void *pixels) {
-  GLenum img_format;
-  switch (img_channels_) {
-  case 1: img_format = GL_RED; break;
-  case 3: img_format = GL_RGB; break;
-  case 4: img_format = GL_RGBA; break;
-  }
-
-  glBindTexture(GL_TEXTURE_2D, img_id_);
-  glTexSubImage2D(GL_TEXTURE_2D,
-                  0,
-                  0,
-                  0,
-                  img_width_,
-                  img_height_,
-                  img_format,
-                  GL_UNSIGNED_BYTE,
-                  pixels);
+  // Streaming
+  if (pbos_.size()) {
+    uint8_t *dst = map();
+    memcpy(dst, pixels, pbo_size_);
+    publish();
+    return;
+  }
+
+  upload((const uint8_t *) pixels);
+}
+
+// Copies a frame into the textures, `pixels` are offsets into the bound pixel
+// unpack buffer when streaming
+void gui_imshow_t::upload(const uint8_t *pixels) {
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  if (format_ == IMSHOW_DIRECT) {
+    glBindTexture(GL_TEXTURE_2D, img_id_);
+    glTexSubImage2D(GL_TEXTURE_2D,
+                    0,
+                    0,
+                    0,
+                    img_width_,
+                    img_height_,
+                    texture_format(img_channels_),
+                    GL_UNSIGNED_BYTE,
+                    pixels);
+  } else {
+    for (const auto &plane : planes_) {
+      glBindTexture(GL_TEXTURE_2D, plane.id);
+      glTexSubImage2D(GL_TEXTURE_2D,
+                      0,
+                      0,
+                      0,
+                      plane.width,
+                      plane.height,
+                      texture_format(plane.channels),
+                      plane.type,
+                      (const void *) ((uintptr_t) pixels + plane.offset));
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   glBindTexture(GL_TEXTURE_2D, 0);
+
+  if (format_ != IMSHOW_DIRECT) {
+    convert();
+  }
+}
+
+// Renders the planes into `img_id_`, restoring the caller's program,
+// framebuffers, VAO, viewport, texture units and depth / cull / blend state
+void gui_imshow_t::convert() {
+  GLint viewport[4];
+  GLint program = 0;
+  GLint draw_FBO = 0;
+  GLint read_FBO = 0;
+  GLint VAO = 0;
+  GLint active_texture = 0;
+  GLint textures[3] = {0, 0, 0};
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_FBO);
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_FBO);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &VAO);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &active_texture);
+  for (int i = 0; i < 3; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &textures[i]);
+  }
+  const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+  const GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+  const GLboolean blend = glIsEnabled(GL_BLEND);
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_BLEND);
+
+  // Depth and float range, from the last reduction that has landed
+  const bool ranged = (format_ == IMSHOW_DEPTH16 || format_ == IMSHOW_FLOAT32);
+  if (ranged && auto_range_) {
+    reduce_range();
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO_);
+  glViewport(0, 0, img_width_, img_height_);
+  convert_program_->use();
+  convert_program_->set("format", (int) format_);
+  if (ranged) {
+    const float scale = (format_ == IMSHOW_DEPTH16) ? 65535.0f : 1.0f;
+    convert_program_->set("colormap", (int) colormap_);
+    convert_program_->set("range", range_min_, range_max_);
+    convert_program_->set("scale", scale);
+  }
+  const char *samplers[3] = {"plane0", "plane1", "plane2"};
+  for (size_t i = 0; i < planes_.size(); i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, planes_[i].id);
+    convert_program_->set(samplers[i], (int) i);
+  }
+  glBindVertexArray(convert_VAO_);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  for (int i = 0; i < 3; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+  }
+  glActiveTexture(active_texture);
+  glBindVertexArray(VAO);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_FBO);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, read_FBO);
+  glUseProgram(program);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  if (depth_test) {
+    glEnable(GL_DEPTH_TEST);
+  }
+  if (cull_face) {
+    glEnable(GL_CULL_FACE);
+  }
+  if (blend) {
+    glEnable(GL_BLEND);
+  }
+}
+
+static void imshow_submit(gui_imshow_frames_t &frames,
+                          const int img_width,
+                          const int img_height,
+                          const int img_channels,
+                          const gui_imshow_format_t format,
+                          const unsigned char *data) {
+  gui_imshow_frame_t &frame = frames.write_frame();
+  const size_t size =
+      gui_imshow_frame_size(format, img_width, img_height, img_channels);
+  frame.width = img_width;
+  frame.height = img_height;
+  frame.channels = img_channels;
+  frame.format = format;
+  frame.data.resize(size);
+  memcpy(frame.data.data(), data, size);
+  frames.publish();
+}
+
+// Collects the last min / max readback if the GPU is done with it and
+// queues a new reduction of the current image, never waiting on the GPU
+void gui_imshow_t::reduce_range() {
+  if (minmax_fence_) {
+    if (glClientWaitSync(minmax_fence_, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(minmax_fence_);
+    minmax_fence_ = nullptr;
+
+    float minmax[2] = {0.0f, 0.0f};
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, minmax_PBO_);
+    glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(minmax), minmax);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // No valid pixels keeps the last range
+    if (minmax[0] <= minmax[1]) {
+      range_min_ = minmax[0];
+      range_max_ = minmax[1];
+    }
+  }
+
+  // Reduce image -> 1x1
+  const float scale = (format_ == IMSHOW_DEPTH16) ? 65535.0f : 1.0f;
+  minmax_program_->use();
+  minmax_program_->set("src", 0);
+  minmax_program_->set("scale", scale);
+  minmax_program_->set("zero_invalid", (format_ == IMSHOW_DEPTH16) ? 1 : 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindFramebuffer(GL_FRAMEBUFFER, minmax_FBO_);
+  glBindVertexArray(convert_VAO_);
+  GLuint src = planes_[0].id;
+  for (size_t i = 0; i < minmax_levels_.size(); i++) {
+    const gui_imshow_plane_t &level = minmax_levels_[i];
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D,
+                           level.id,
+                           0);
+    glViewport(0, 0, level.width, level.height);
+    minmax_program_->set("first", (i == 0) ? 1 : 0);
+    glBindTexture(GL_TEXTURE_2D, src);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    src = level.id;
+  }
+  glBindVertexArray(0);
+
+  // Read the 1x1 result into the pack buffer, collected on a later frame
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, minmax_PBO_);
+  glReadPixels(0, 0, 1, 1, GL_RG, GL_FLOAT, (void *) 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  minmax_fence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void gui_imshow_t::submit(const int img_width,
+                          const int img_height,
+                          const int img_channels,
+                          const unsigned char *data) {
+  imshow_submit(frames_,
+                img_width,
+                img_height,
+                img_channels,
+                IMSHOW_DIRECT,
+                data);
+}
+
+void gui_imshow_t::submit(const int img_width,
+                          const int img_height,
+                          const gui_imshow_format_t format,
+                          const unsigned char *data) {
+  imshow_submit(frames_, img_width, img_height, 4, format, data);
+}
+
+void gui_imshow_t::print_stats() const {
+  const size_t n = std::max(stats_.nb_frames, (size_t) 1);
+  const size_t n_gpu = std::max(stats_.nb_gpu_samples, (size_t) 1);
+  const double mb = stats_.nb_bytes / (1024.0 * 1024.0);
+  LOG_INFO("Imshow [%s, %s]: %zu frames, %.1f MB, %zu stalls, "
+           "stall %.3f ms, upload %.3f ms, latency %.3f ms, gpu %.3f ms "
+           "(per frame)",
+           title_.c_str(),
+           (persistent_) ? "persistent" : "orphaned",
+           stats_.nb_frames,
+           mb,
+           stats_.nb_stalls,
+           stats_.stall_time / n * 1e3,
+           stats_.upload_time / n * 1e3,
+           stats_.latency / n * 1e3,
+           stats_.gpu_time / n_gpu * 1e3);
 }
 
 void gui_imshow_t::show() {
+  // Producer process restarted under the same name, map the new segment
+  if (shm_.restarted()) {
+    const std::string name = shm_.name_;
+    attach(name);
+  }
+
+  // Newest frame from a producer process, read in place
+  shm_frame_t shm_frame;
+  if (shm_.ok() && shm_.poll(shm_frame)) {
+    const shm_header_t &header = *shm_.header_;
+    const gui_imshow_format_t format = (gui_imshow_format_t) header.format;
+    if (imshow_shm_matches(*this, header) == false) {
+      LOG_ERROR("Imshow [%s] got a %dx%dx%d frame, expected %dx%dx%d!",
+                title_.c_str(),
+                header.width,
+                header.height,
+                header.channels,
+                img_width_,
+                img_height_,
+                img_channels_);
+    } else if (ok_ == false && format == IMSHOW_DIRECT) {
+      init(title_,
+           header.width,
+           header.height,
+           header.channels,
+           shm_frame.data);
+    } else if (ok_ == false) {
+      init(title_, header.width, header.height, format, shm_frame.data);
+    } else {
+      upload(shm_frame.data);
+    }
+
+    // A torn frame is replaced by the next one
+    if (shm_.valid(shm_frame)) {
+      const double latency = (shm_time_now() - shm_frame.timestamp) * 1e-9;
+      stats_.last_shm_latency = latency;
+      stats_.shm_latency += latency;
+    }
+  }
+
+  // Newest frame from the producer thread
+  if (frames_.consume()) {
+    const gui_imshow_frame_t &frame = frames_.read_frame();
+    const unsigned char *data = frame.data.data();
+    if (ok_ == false && frame.format == IMSHOW_DIRECT) {
+      init(title_, frame.width, frame.height, frame.channels, data);
+    } else if (ok_ == false) {
+      init(title_, frame.width, frame.height, frame.format, data);
+    } else if (frame.width != img_width_ || frame.height != img_height_ ||
+               frame.channels != img_channels_ || frame.format != format_) {
+      LOG_ERROR("Imshow [%s] got a %dx%dx%d frame, expected %dx%dx%d!",
+                title_.c_str(),
+                frame.width,
+                frame.height,
+                frame.channels,
+                img_width_,
+                img_height_,
+                img_channels_);
+    } else {
+      update((void *) frame.data.data());
+    }
+  }
+  if (ok_ == false) {
+    return;
+  }
+
   // Set window alpha
   float alpha = 2.0f;
   ImGui::SetNextWindowBgAlpha(alpha);
@@ -1670,4 +6940,16 @@ void gui_imshow_t::show(const int img_width,
   show();
 }
 
+void gui_imshow_t::show(const int img_width,
+                        const int img_height,
+                        const gui_imshow_format_t format,
+                        const unsigned char *data) {
+  if (ok_ == false) {
+    init(title_, img_width, img_height, format, data);
+  } else {
+    update((void *) data);
+  }
+  show();
+}
+
 } // namespace proto
@@ -1,16 +1,36 @@
 #ifndef SHOW_HPP
 #define SHOW_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -23,6 +43,10 @@
 
 #include <stb/stb_image.h>
 
+#include <octomap/octomap.h>
+
+#include "shm.hpp"
+
 namespace show {
 
 #define __FILENAME__                                                           \
@@ -61,24 +85,102 @@ void print_vec4(const std::string &title, const glm::vec4 &v);
 void print_mat3(const std::string &title, const glm::mat3 &m);
 void print_mat4(const std::string &title, const glm::mat4 &m);
 
+uint64_t hash_fnv1a(const void *data,
+                    const size_t size,
+                    const uint64_t seed = 14695981039346656037ULL);
+int file_read(const std::string &path, std::string &contents);
+
+/**
+ * Fixed size worker pool, `thread_pool()` is shared by the library and sized
+ * to the hardware concurrency. `parallel_for()` runs `fn(i)` for i in [0, n)
+ * on the workers and the calling thread and returns once every call has
+ * finished, it must not be called from a job.
+ */
+struct thread_pool_t {
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+
+  thread_pool_t(const size_t nb_threads = 0);
+  ~thread_pool_t();
+
+  void push(std::function<void()> job);
+  void parallel_for(const size_t n, const std::function<void(size_t)> &fn);
+};
+
+thread_pool_t &thread_pool();
+
 /*****************************************************************************
  *                                SHADER
  ****************************************************************************/
 
+int shader_submit(const char *shader_src, const int type);
+int shader_check(const int shader);
 int shader_compile(const char *shader_src, const int type);
 int shader_compile(const std::string &shader_path, const int type);
 int shaders_link(const int vertex_shader,
                  const int fragment_shader,
                  const int geometry_shader = -1);
+bool shaders_parallel_supported();
+void shaders_parallel_init();
+
+/**
+ * Program binary cache. When enabled, `glprog_t` looks up linked programs in
+ * `dir` by a hash of their sources and the GL driver strings before compiling
+ * from source, and stores the `glGetProgramBinary` output after a miss. Any
+ * mismatch or rejected binary falls back to compiling from source.
+ */
+struct glprog_cache_t {
+  bool enabled = false;
+  std::string dir;
+  std::string driver;
+  size_t hits = 0;
+  size_t misses = 0;
+};
+
+glprog_cache_t &glprog_cache();
+void glprog_cache_enable(const std::string &dir);
+void glprog_cache_disable();
+void glprog_cache_print_stats();
+
+/**
+ * Active uniform reflected from a linked program. Array uniforms are stored
+ * under their base name, i.e. without the trailing `[0]`. Names looked up
+ * that are not in the table, e.g. `arr[2]`, are resolved by GL and added,
+ * with a `type` of 0.
+ */
+struct gluniform_t {
+  std::string name;
+  int location = -1;
+  GLenum type = 0;
+  int size = 0;
+};
+
+/**
+ * Resolved uniform location. Obtain one via `glprog_t::uniform()` once, then
+ * pass it to `glprog_t::set()` every frame to avoid any string lookups.
+ */
+struct gluniform_handle_t {
+  int location = -1;
+
+  bool valid() const { return location != -1; }
+};
 
 struct glprog_t {
   unsigned int program_id;
+  mutable std::vector<gluniform_t> uniforms; // Sorted by name
 
   glprog_t(const std::string &vs_path, const std::string &fs_path);
   glprog_t(const std::string &vs_path,
            const std::string &fs_path,
            const std::string &gs_path);
   glprog_t(const char *vs_src, const char *fs_var);
+  explicit glprog_t(const unsigned int program_id_);
+
+  void reflect();
+  gluniform_handle_t uniform(const std::string &key) const;
 
   void use() const;
   int set(const std::string &key, const bool value) const;
@@ -100,8 +202,78 @@ struct glprog_t {
   int set(const std::string &key, const glm::mat2 &mat) const;
   int set(const std::string &key, const glm::mat3 &mat) const;
   int set(const std::string &key, const glm::mat4 &mat) const;
+
+  int set(const gluniform_handle_t handle, const bool value) const;
+  int set(const gluniform_handle_t handle, const int value) const;
+  int set(const gluniform_handle_t handle, const float value) const;
+  int set(const gluniform_handle_t handle, const glm::vec2 &value) const;
+  int set(const gluniform_handle_t handle, const float x, const float y) const;
+  int set(const gluniform_handle_t handle, const glm::vec3 &value) const;
+  int set(const gluniform_handle_t handle,
+          const float x,
+          const float y,
+          const float z) const;
+  int set(const gluniform_handle_t handle, const glm::vec4 &value) const;
+  int set(const gluniform_handle_t handle,
+          const float x,
+          const float y,
+          const float z,
+          const float w) const;
+  int set(const gluniform_handle_t handle, const glm::mat2 &mat) const;
+  int set(const gluniform_handle_t handle, const glm::mat3 &mat) const;
+  int set(const gluniform_handle_t handle, const glm::mat4 &mat) const;
+};
+
+/**
+ * Program submitted to the driver whose compile and link status has not been
+ * queried yet. `glprog_submit()` returns immediately, `glprog_ready()` polls
+ * via `KHR_parallel_shader_compile` or `ARB_parallel_shader_compile` when
+ * available and `glprog_finish()` checks the status, returning the program
+ * id or -1 on failure.
+ */
+struct glprog_job_t {
+  int program = -1;
+  int vs = -1;
+  int fs = -1;
+  int gs = -1;
+  bool done = false;
+  bool use_cache = false;
+  uint64_t cache_key = 0;
 };
 
+glprog_job_t glprog_submit(const char *vs_src,
+                           const char *fs_src,
+                           const char *gs_src = nullptr);
+bool glprog_ready(const glprog_job_t &job);
+int glprog_finish(glprog_job_t &job);
+
+/**
+ * Batch compilation: every program added is submitted to the driver straight
+ * away, statuses are only queried once all of them are in flight. Programs
+ * that fail to build are returned as 0 and make `glprog_batch_finish()`
+ * return -1.
+ */
+struct glprog_batch_t {
+  std::vector<glprog_job_t> jobs;
+};
+
+size_t glprog_batch_add(glprog_batch_t &batch,
+                        const char *vs_src,
+                        const char *fs_src,
+                        const char *gs_src = nullptr);
+bool glprog_batch_ready(const glprog_batch_t &batch);
+int glprog_batch_finish(glprog_batch_t &batch,
+                        std::vector<unsigned int> &programs);
+
+/**
+ * Shared program library used by the built-in objects. Programs are keyed by
+ * their sources, compiled on first use (or prefetched in the background) and
+ * shared by every object drawing with the same shaders.
+ */
+void glprog_library_prefetch(const char *vs_src, const char *fs_src);
+void glprog_library_prefetch_builtin();
+glprog_t *glprog_library_get(const char *vs_src, const char *fs_src);
+
 /*****************************************************************************
  *                                 TEXTURE
  ****************************************************************************/
@@ -123,6 +295,172 @@ unsigned int load_texture(const std::string &texture_file,
                           int &img_channels);
 
 unsigned int load_texture(const std::string &texture_file);
+void texture_upload(const unsigned int texture_id,
+                    const int img_width,
+                    const int img_height,
+                    const int img_channels,
+                    const unsigned char *data);
+
+/**
+ * Block compressed textures with prebuilt mip chains. `dds_load()` reads a
+ * DDS file holding BC1, BC3, BC4, BC5 or BC7 (DX10 header) blocks and
+ * `dds_save()` writes one, `texture_upload_compressed()` uploads every level
+ * with glCompressedTexImage2D(). Texture loaders prefer the sibling
+ * `<image>.dds` of an image, e.g. `diffuse.png.dds`, when the GL context
+ * supports its format and it is not older than the image, see
+ * `texture_compressed_sibling()`. `show_texc` encodes them from PNG / JPG.
+ */
+struct gltexture_compressed_t {
+  GLenum format = 0;
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> data;
+  std::vector<size_t> level_offsets;
+  std::vector<size_t> level_sizes;
+};
+
+size_t texture_block_size(const GLenum format);
+size_t texture_level_size(const GLenum format,
+                          const int width,
+                          const int height);
+bool texture_compressed_supported(const GLenum format);
+std::string texture_compressed_path(const std::string &path);
+std::string texture_compressed_sibling(const std::string &path);
+int dds_load(const std::string &path, gltexture_compressed_t &texture);
+int dds_save(const std::string &path, const gltexture_compressed_t &texture);
+void texture_upload_compressed(const unsigned int texture_id,
+                               const gltexture_compressed_t &texture);
+
+/**
+ * Asynchronous texture loading. `texture_from_file_async()` returns a texture
+ * holding a 1x1 white placeholder right away and decodes the file on
+ * `gltexture_decode_pool()`, kept apart from `thread_pool()` so decodes do
+ * not queue ahead of `parallel_for()` work. `gltexture_loader_poll()`
+ * uploads up to `max_uploads` decoded images into their textures on the
+ * context thread, and `gltexture_loader_finish()` blocks until every pending
+ * decode is uploaded. `texture_load_file()` and `texture_load_file_async()`
+ * load into an existing texture, the latter keeping its current contents
+ * until the upload.
+ *
+ * Each request is numbered and only the latest one per texture uploads.
+ * `gltexture_loader_cancel()` drops a texture's pending request and must be
+ * called before deleting a texture that may have one, since GL reuses ids.
+ */
+struct gltexture_decode_t {
+  unsigned int id = 0;
+  uint64_t generation = 0;
+  std::string path;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  unsigned char *data = nullptr;
+  gltexture_compressed_t compressed;
+};
+
+struct gltexture_loader_t {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<gltexture_decode_t> decoded;
+  size_t nb_pending = 0;
+  size_t nb_uploaded = 0;
+
+  // Latest request per texture, context thread only
+  uint64_t generation = 0;
+  std::unordered_map<unsigned int, uint64_t> requests;
+};
+
+gltexture_loader_t &gltexture_loader();
+thread_pool_t &gltexture_decode_pool();
+void gltexture_loader_cancel(const unsigned int texture_id);
+void texture_placeholder(const unsigned int texture_id);
+size_t texture_mip_chain_size(const int width,
+                              const int height,
+                              const int bytes_per_pixel);
+int texture_load_file(const unsigned int texture_id, const std::string &path);
+void texture_load_file_async(const unsigned int texture_id,
+                             const std::string &path);
+unsigned int texture_from_file_async(const std::string &path);
+size_t gltexture_loader_poll(const size_t max_uploads = SIZE_MAX);
+void gltexture_loader_finish();
+
+/**
+ * Process wide texture cache, used from the context thread only.
+ * `gltexture_acquire()` returns the texture for an image file and loads it,
+ * asynchronously if `async`, only the first time its canonical path is
+ * seen. `gltexture_release()` drops a reference and deletes the texture with
+ * its last one. With `hash_contents` set files at different paths with
+ * identical bytes share a texture too, at the cost of reading each new path
+ * once to hash it.
+ *
+ * The cache also accounts the GPU bytes of each texture, mips included.
+ * With a non-zero `budget` `gltexture_cache_trim()`, called once per frame
+ * by `gui_t::render()`, evicts the least recently bound textures until the
+ * total fits: first by dropping their top `evict_levels` mips, then down to
+ * the placeholder. Textures bound in the current frame are never evicted.
+ * `gltexture_bind()` marks a texture used and reloads it in full through
+ * the async loader if it was evicted, but only once the full texture fits
+ * in the budget next to the resident bytes and the reloads in flight, so
+ * trimming and reloading do not chase each other. A texture whose reload
+ * fails keeps what is resident and is marked `failed`, which stops further
+ * reloads.
+ */
+struct gltexture_entry_t {
+  unsigned int id = 0;
+  size_t refs = 0;
+  std::string path;
+  uint64_t hash = 0;
+
+  // Residency
+  GLenum format = 0;      // Compressed format, 0 if uncompressed
+  int width = 0;          // Full resolution
+  int height = 0;
+  int channels = 0;
+  int nb_levels = 0;      // Mips in the full chain
+  int dropped = 0;        // Top mips evicted, -1 if only the placeholder
+  size_t bytes = 0;       // Currently resident
+  uint64_t last_used = 0; // Frame last bound
+  bool loading = false;
+  bool failed = false;     // Reload failed, kept as resident
+  size_t reload_bytes = 0; // Reserved for a reload in flight
+};
+
+struct gltexture_residency_t {
+  size_t nb_textures = 0;
+  size_t nb_full = 0;
+  size_t nb_reduced = 0;
+  size_t nb_placeholder = 0;
+  size_t nb_loading = 0;
+  size_t resident_bytes = 0;
+  size_t full_bytes = 0;
+  size_t budget = 0;
+  size_t evictions = 0;
+  size_t reloads = 0;
+};
+
+struct gltexture_cache_t {
+  bool hash_contents = false;
+  std::unordered_map<std::string, unsigned int> paths;
+  std::unordered_map<uint64_t, unsigned int> hashes;
+  std::unordered_map<unsigned int, gltexture_entry_t> entries;
+  size_t hits = 0;
+  size_t misses = 0;
+
+  size_t budget = 0; // Bytes, 0 for unlimited
+  int evict_levels = 2;
+  uint64_t frame = 0;
+  size_t resident_bytes = 0;
+  size_t reload_bytes = 0;
+  size_t evictions = 0;
+  size_t reloads = 0;
+};
+
+gltexture_cache_t &gltexture_cache();
+unsigned int gltexture_acquire(const std::string &path, const bool async);
+void gltexture_release(const unsigned int texture_id);
+void gltexture_bind(const unsigned int texture_id);
+void gltexture_cache_trim();
+gltexture_residency_t gltexture_cache_residency();
+void gltexture_cache_print_stats();
 
 struct glvertex_t {
   glm::vec3 position;
@@ -132,26 +470,266 @@ struct glvertex_t {
   glm::vec3 bitangent;
 };
 
+/**
+ * Vertex buffer layouts. `GLVERTEX_FULL` uploads `glvertex_t` as is (56
+ * bytes), the compact layouts keep the same attribute locations but store
+ * texcoords as half floats and the normal and tangent octahedral encoded in
+ * two normalized shorts each (decode with `oct_decode` below). The bitangent
+ * is dropped, its sign is the sign of the tangent's second component which
+ * otherwise stores the octahedral y remapped to [0, 1]:
+ *
+ *   vec3 oct_decode(vec2 e) {
+ *     vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+ *     float t = max(-n.z, 0.0);
+ *     n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+ *     return normalize(n);
+ *   }
+ *   float sign = (t.y < 0.0) ? -1.0 : 1.0;
+ *   vec2 t_oct = vec2(t.x, abs(t.y) * 2.0 - 1.0);
+ *   bitangent = sign * cross(normal, oct_decode(t_oct));
+ *
+ * `GLVERTEX_COMPACT_QPOS` also quantizes positions to 16-bit normalized
+ * values within the mesh bounds, the vertex shader restores them with the
+ * `pos_offset` and `pos_scale` uniforms set by `glmesh_draw()`.
+ */
+enum glvertex_layout_t {
+  GLVERTEX_FULL,
+  GLVERTEX_COMPACT,
+  GLVERTEX_COMPACT_QPOS
+};
+
+struct glvertex_compact_t {
+  glm::vec3 position;
+  GLshort normal[2];
+  GLshort tangent[2];
+  GLhalf texcoords[2];
+};
+
+struct glvertex_qpos_t {
+  GLushort position[4];
+  GLshort normal[2];
+  GLshort tangent[2];
+  GLhalf texcoords[2];
+};
+
+/**
+ * Vertices packed in a `glvertex_layout_t`, ready to upload. Positions are
+ * `pos_offset + position * pos_scale`.
+ */
+struct glvertices_t {
+  glvertex_layout_t layout = GLVERTEX_FULL;
+  std::vector<uint8_t> data;
+  size_t size = 0;
+  glm::vec3 pos_offset = glm::vec3(0.0f);
+  glm::vec3 pos_scale = glm::vec3(1.0f);
+};
+
+size_t glvertex_size(const glvertex_layout_t layout);
+void glvertices_pack(const std::vector<glvertex_t> &src,
+                     const glvertex_layout_t layout,
+                     glvertices_t &dst);
+void glvertices_pack(const std::vector<glvertex_t> &src,
+                     const glvertex_layout_t layout,
+                     const glm::vec3 &bounds_min,
+                     const glm::vec3 &bounds_max,
+                     glvertices_t &dst);
+void glvertices_unpack(const glvertices_t &src, std::vector<glvertex_t> &dst);
+
+/**
+ * Index buffer ready to upload. Meshes with at most 65536 vertices use
+ * `GL_UNSIGNED_SHORT` indices, larger ones `GL_UNSIGNED_INT` unless split,
+ * in which case consecutive triangles are grouped into ranges that each
+ * reference at most 65536 vertices and store 16-bit indices relative to the
+ * range's `base_vertex`. Range offsets and counts are in indices. A mesh
+ * with a triangle spanning more than 65536 vertices cannot be split and
+ * keeps 32-bit indices.
+ */
+struct glindex_range_t {
+  size_t offset = 0;
+  size_t count = 0;
+  GLint base_vertex = 0;
+};
+
+struct glindices_t {
+  GLenum type = GL_UNSIGNED_INT;
+  std::vector<uint8_t> data;
+  size_t size = 0;
+  std::vector<glindex_range_t> ranges;
+};
+
+size_t glindex_size(const GLenum type);
+void glindices_pack(const std::vector<unsigned int> &src,
+                    const size_t nb_vertices,
+                    const bool split,
+                    glindices_t &dst);
+void glindices_unpack(const glindices_t &src, std::vector<unsigned int> &dst);
+
 /*****************************************************************************
  *                                 MESH
  ****************************************************************************/
 
+/**
+ * Mesh uploaded to the GPU. The mesh owns its VAO, VBO and EBO and is move
+ * only. Unless `keep_geometry` is set the CPU copies of the vertices and
+ * indices are released once uploaded, their layout, size and ranges remain.
+ */
 struct glmesh_t {
-  std::vector<glvertex_t> vertices;
-  std::vector<unsigned int> indices;
+  glvertices_t vertices;
+  glindices_t indices;
   std::vector<gltexture_t> textures;
-  unsigned int VAO;
-  unsigned int VBO;
-  unsigned int EBO;
+  std::vector<gluniform_handle_t> sampler_locs;
+  gluniform_handle_t pos_offset_loc;
+  gluniform_handle_t pos_scale_loc;
+  unsigned int program_id = 0;
+  unsigned int VAO = 0;
+  unsigned int VBO = 0;
+  unsigned int EBO = 0;
 
   glmesh_t(const std::vector<glvertex_t> &vertices_,
            const std::vector<unsigned int> &indices_,
-           const std::vector<gltexture_t> &textures_);
+           std::vector<gltexture_t> textures_,
+           const bool split_indices = false,
+           const bool keep_geometry = true);
+  glmesh_t(glvertices_t vertices_,
+           const std::vector<unsigned int> &indices_,
+           std::vector<gltexture_t> textures_,
+           const bool split_indices = false,
+           const bool keep_geometry = true);
+  glmesh_t(glvertices_t vertices_,
+           glindices_t indices_,
+           std::vector<gltexture_t> textures_,
+           const bool keep_geometry = true);
+  glmesh_t(const glmesh_t &) = delete;
+  glmesh_t(glmesh_t &&other) noexcept;
+  ~glmesh_t();
+
+  glmesh_t &operator=(const glmesh_t &) = delete;
+  glmesh_t &operator=(glmesh_t &&other) noexcept;
 };
 
 void glmesh_init(glmesh_t &mesh);
+void glmesh_release_geometry(glmesh_t &mesh);
+void glmesh_bind(glmesh_t &mesh, const glprog_t &program);
 void glmesh_draw(const glmesh_t &mesh, const glprog_t &program);
 
+/**
+ * Load-time mesh optimization for triangle lists. `glmesh_weld()` merges
+ * bitwise identical vertices, `glmesh_tipsify()` reorders triangles for the
+ * post-transform vertex cache (Sander et al. 2007) and returns the first
+ * triangle of every cluster it started, `glmesh_sort_clusters()` orders those
+ * clusters outward facing first to reduce overdraw and
+ * `glmesh_optimize_fetch()` renumbers vertices in order of first use.
+ *
+ * `glmesh_acmr()` is the average number of vertices transformed per triangle
+ * with a FIFO cache of `cache_size` entries, 3.0 is the worst case and 0.5
+ * the ideal for large regular meshes.
+ */
+struct glmesh_optimize_stats_t {
+  size_t nb_vertices_before = 0;
+  size_t nb_vertices_after = 0;
+  size_t nb_triangles = 0;
+  float acmr_before = 0.0f;
+  float acmr_after = 0.0f;
+};
+
+float glmesh_acmr(const std::vector<unsigned int> &indices,
+                  const size_t nb_vertices,
+                  const int cache_size = 16);
+void glmesh_weld(std::vector<glvertex_t> &vertices,
+                 std::vector<unsigned int> &indices);
+std::vector<size_t> glmesh_tipsify(std::vector<unsigned int> &indices,
+                                   const size_t nb_vertices,
+                                   const int cache_size = 16);
+void glmesh_sort_clusters(const std::vector<glvertex_t> &vertices,
+                          std::vector<unsigned int> &indices,
+                          const std::vector<size_t> &clusters);
+void glmesh_optimize_fetch(std::vector<glvertex_t> &vertices,
+                           std::vector<unsigned int> &indices);
+glmesh_optimize_stats_t glmesh_optimize(std::vector<glvertex_t> &vertices,
+                                        std::vector<unsigned int> &indices,
+                                        const int cache_size = 16);
+
+/**
+ * Static geometry packed into a single vertex and index buffer with one VAO.
+ * Meshes are added with `glarena_add()` and uploaded once with
+ * `glarena_upload()`. `glarena_draw()` then binds each distinct set of
+ * textures once and issues every draw sharing it with one
+ * `glMultiDrawElementsIndirect()`, or `glMultiDrawElementsBaseVertex()` where
+ * GL 4.3 / ARB_multi_draw_indirect is missing. Indices are 16-bit relative to
+ * each draw's base vertex, quantized positions are relative to the arena
+ * bounds given at construction, meshes added already packed must use the
+ * arena layout and bounds and split 16-bit indices. `glarena_add()` returns
+ * -1 for meshes it cannot hold, e.g. ones that fell back to 32-bit indices.
+ */
+struct gldraw_elements_indirect_t {
+  GLuint count = 0;
+  GLuint instance_count = 1;
+  GLuint first_index = 0;
+  GLint base_vertex = 0;
+  GLuint base_instance = 0;
+};
+
+struct glarena_batch_t {
+  std::vector<gltexture_t> textures;
+  std::vector<gluniform_handle_t> sampler_locs;
+  std::vector<gldraw_elements_indirect_t> commands;
+  size_t first_command = 0;
+
+  // glMultiDrawElementsBaseVertex() arguments
+  std::vector<GLsizei> counts;
+  std::vector<const void *> offsets;
+  std::vector<GLint> base_vertices;
+};
+
+struct glarena_t {
+  glvertex_layout_t layout = GLVERTEX_FULL;
+  glm::vec3 bounds_min = glm::vec3(0.0f);
+  glm::vec3 bounds_max = glm::vec3(0.0f);
+  glm::vec3 pos_offset = glm::vec3(0.0f);
+  glm::vec3 pos_scale = glm::vec3(1.0f);
+  std::vector<uint8_t> vertex_data;
+  std::vector<uint8_t> index_data;
+  size_t nb_vertices = 0;
+  size_t nb_indices = 0;
+  std::vector<glarena_batch_t> batches;
+  bool indirect = false;
+
+  gluniform_handle_t pos_offset_loc;
+  gluniform_handle_t pos_scale_loc;
+  unsigned int program_id = 0;
+  unsigned int VAO = 0;
+  unsigned int VBO = 0;
+  unsigned int EBO = 0;
+  unsigned int DIBO = 0;
+
+  glarena_t(const glvertex_layout_t layout_ = GLVERTEX_FULL,
+            const glm::vec3 &bounds_min_ = glm::vec3(0.0f),
+            const glm::vec3 &bounds_max_ = glm::vec3(0.0f));
+  glarena_t(const glarena_t &) = delete;
+  glarena_t(glarena_t &&other) noexcept;
+  ~glarena_t();
+
+  glarena_t &operator=(const glarena_t &) = delete;
+  glarena_t &operator=(glarena_t &&other) noexcept;
+};
+
+int glarena_add(glarena_t &arena,
+                const std::vector<glvertex_t> &vertices,
+                const std::vector<unsigned int> &indices,
+                const std::vector<gltexture_t> &textures);
+int glarena_add(glarena_t &arena,
+                const glvertices_t &vertices,
+                const glindices_t &indices,
+                const std::vector<gltexture_t> &textures);
+void glarena_upload(glarena_t &arena);
+void glarena_upload(glarena_t &arena,
+                    const void *vertex_data,
+                    const size_t vertex_size,
+                    const void *index_data,
+                    const size_t index_size);
+void glarena_bind(glarena_t &arena, const glprog_t &program);
+void glarena_draw(const glarena_t &arena, const glprog_t &program);
+
 /*****************************************************************************
  *                                 CAMERA
  ****************************************************************************/
@@ -187,6 +765,10 @@ struct glcamera_t {
   int &screen_width;
   int &screen_height;
 
+  // Bumped on every pose or field of view change, call `update()` after
+  // setting the fields directly
+  uint64_t version = 0;
+
   glcamera_t(int &screen_width_, int &screen_height_)
       : screen_width{screen_width_}, screen_height{screen_height_} {
     update();
@@ -205,6 +787,7 @@ struct glcamera_t {
     // Normalize the vectors, because their length gets closer to 0 the more
     // you look up or down which results in slower movement.
     up = glm::normalize(glm::cross(right, front));
+    version++;
   }
 
   glm::mat4 projection() const {
@@ -255,6 +838,7 @@ struct glcamera_t {
     } else if (fov >= glm::radians(90.0f)) {
       fov = glm::radians(90.0f);
     }
+    version++;
   }
 };
 
@@ -264,6 +848,40 @@ void glcamera_keyboard_handler(glcamera_t &camera,
 void glcamera_mouse_handler(glcamera_t &camera, const float dx, const float dy);
 void glcamera_scroll_handler(glcamera_t &camera, const float dy);
 
+/**
+ * Camera uniform buffer. Built-in shaders declare a `std140` uniform block
+ * named `camera` which `glprog_t` binds to `GLCAMERA_UBO_BINDING`, so the
+ * projection and view matrices are uploaded once per frame by `gui_t` rather
+ * than once per object.
+ *
+ * Draw functions still take the camera they render with and pass it to
+ * `glcamera_ubo_use()`, which re-uploads the bound buffer only when the
+ * camera, its `version` or the screen size differ from the last upload, e.g.
+ * for an inset view. The check is a few integer compares per draw.
+ */
+static const GLuint GLCAMERA_UBO_BINDING = 0;
+
+struct glcamera_ubo_t {
+  glm::mat4 projection;
+  glm::mat4 view;
+};
+
+GLuint glcamera_ubo_create();
+void glcamera_ubo_delete(GLuint &ubo);
+void glcamera_ubo_update(const GLuint ubo, const glcamera_t &camera);
+void glcamera_ubo_use(const glcamera_t &camera);
+
+/**
+ * View frustum planes extracted from a `projection * view * model` matrix,
+ * `visible()` tests an axis aligned box in the model frame.
+ */
+struct glfrustum_t {
+  glm::vec4 planes[6];
+
+  glfrustum_t(const glm::mat4 &M);
+  bool visible(const glm::vec3 &min, const glm::vec3 &max) const;
+};
+
 
 /*****************************************************************************
  *                                 MODEL
@@ -279,13 +897,18 @@ layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec3 pos_offset;
+uniform vec3 pos_scale;
 
 void main() {
 	TexCoords = aTexCoords;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	vec3 pos = pos_offset + aPos * pos_scale;
+	gl_Position = projection * view * model * vec4(pos, 1.0);
 }
 )glsl";
 
@@ -304,38 +927,136 @@ void main() {
 
 } // namespace shaders
 
+/**
+ * Model load options. With `arena` set (the default) all meshes are packed
+ * into the model's `glarena_t` and drawn with a handful of multi-draws,
+ * otherwise every mesh is a `glmesh_t` with its own buffers, optionally split
+ * into 16-bit index ranges and keeping its CPU geometry. With
+ * `async_textures` the model is drawable straight away with placeholder
+ * textures that `glmodel_draw()` replaces as their decodes complete.
+ */
+struct glmodel_options_t {
+  glvertex_layout_t vertex_layout = GLVERTEX_FULL;
+  bool async_textures = true;
+  bool arena = true;
+  bool split_indices = false;
+  bool keep_geometry = false;
+};
+
 struct glmodel_t {
   glprog_t program;
+  gluniform_handle_t projection_loc;
+  gluniform_handle_t view_loc;
+  gluniform_handle_t model_loc;
 
-  std::vector<gltexture_t> textures_loaded;
+  std::vector<gltexture_t> textures_loaded; // One cache reference each
   std::vector<glmesh_t> meshes;
+  glarena_t arena;
   std::string directory;
   bool gamma_correction = false;
+  glmodel_options_t options;
+  glmesh_optimize_stats_t optimize_stats;
 
   glm::mat4 T_SM = glm::mat4(1.0f);
 
   glmodel_t(const std::string &path,
             const std::string &vs,
             const std::string &fs,
-            bool gamma = false);
+            bool gamma = false,
+            const glmodel_options_t &options_ = glmodel_options_t());
 
   glmodel_t(const std::string &path,
             const char *vs = shaders::glmodel_vs,
             const char *fs = shaders::glmodel_fs,
-            bool gamma = false);
+            bool gamma = false,
+            const glmodel_options_t &options_ = glmodel_options_t());
+  glmodel_t(const glmodel_t &) = delete;
+  ~glmodel_t();
+
+  glmodel_t &operator=(const glmodel_t &) = delete;
+};
+
+/**
+ * Mesh converted by the CPU stage of `glmodel_load()`. Its textures are
+ * requested first so their decodes overlap the CPU stage, then
+ * `glmodel_stage_mesh()`, which only reads the scene, the load options and
+ * the arena bounds, runs on the worker pool and the GL stage
+ * `glmodel_process_mesh()` uploads the mesh on the context thread.
+ */
+struct glmodel_staging_t {
+  aiMesh *mesh = nullptr;
+  std::vector<gltexture_t> textures;
+  glvertices_t vertices;
+  glindices_t indices;
+  glmesh_optimize_stats_t stats;
 };
 
 void glmodel_draw(glmodel_t &model, const glcamera_t &camera);
 void glmodel_load(glmodel_t &model, const std::string &path);
-void glmodel_process_node(glmodel_t &model, aiNode *node,
-                          const aiScene *scene);
-glmesh_t glmodel_process_mesh(glmodel_t &model,
-                              aiMesh *mesh,
-                              const aiScene *scene);
-std::vector<gltexture_t> glmodel_load_textures(glmodel_t &model,
-                                               aiMaterial *mat,
-                                               aiTextureType type,
-                                               std::string typeName);
+void glmodel_collect_meshes(aiNode *node,
+                            const aiScene *scene,
+                            std::vector<aiMesh *> &meshes);
+void glmodel_mesh_geometry(const aiMesh *mesh,
+                           std::vector<glvertex_t> &vertices,
+                           std::vector<unsigned int> &indices);
+void glmodel_stage_mesh(const glmodel_options_t &options,
+                        const glarena_t &arena,
+                        glmodel_staging_t &staging);
+std::vector<gltexture_t> glmodel_mesh_texture_refs(const aiMesh *mesh,
+                                                   const aiScene *scene);
+std::vector<gltexture_t> glmodel_mesh_textures(glmodel_t &model,
+                                               const aiMesh *mesh,
+                                               const aiScene *scene);
+void glmodel_process_mesh(glmodel_t &model, glmodel_staging_t &staging);
+std::vector<gltexture_t> glmodel_material_textures(aiMaterial *mat,
+                                                   aiTextureType type,
+                                                   std::string typeName);
+
+/**
+ * Baked model (.showm) written by `glmodel_bake()`, see `show_bake`, and
+ * loaded by `glmodel_load()` through mmap without Assimp. The file holds the
+ * model's arena already in the GPU layout: the header, the vertex blob in
+ * `vertex_layout`, the 16-bit index blob, the batch (material) table, the
+ * draw commands and the texture table with paths relative to the model
+ * file. Sections start 16-byte aligned.
+ */
+struct glmodel_bake_header_t {
+  char magic[8]; // "SHOWMDL1"
+  uint32_t vertex_layout;
+  uint32_t nb_batches;
+  float bounds_min[3];
+  float bounds_max[3];
+  float pos_offset[3];
+  float pos_scale[3];
+  uint64_t nb_vertices;
+  uint64_t nb_indices;
+  uint64_t nb_commands;
+  uint64_t nb_textures;
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+  uint64_t batches_offset;
+  uint64_t commands_offset;
+  uint64_t textures_offset;
+};
+
+struct glmodel_bake_batch_t {
+  uint32_t first_command;
+  uint32_t nb_commands;
+  uint32_t first_texture;
+  uint32_t nb_textures;
+};
+
+struct glmodel_bake_texture_t {
+  char type[32];
+  char path[224];
+};
+
+int glmodel_bake(const std::string &model_path,
+                 const std::string &output_path,
+                 const glvertex_layout_t layout = GLVERTEX_COMPACT_QPOS);
+bool glmodel_is_baked(const std::string &path);
+void glmodel_load_baked(glmodel_t &model, const std::string &path);
+
 unsigned int texture_from_file(const std::string &dir,
                                const char *fp,
                                bool gamma = false);
@@ -350,9 +1071,11 @@ static const char *glcf_vs = R"glsl(
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
   gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -375,9 +1098,11 @@ layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec3 in_color;
 out vec3 color;
 
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
   gl_Position = projection * view * model * vec4(in_pos, 1.0);
@@ -391,9 +1116,11 @@ layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec3 in_color;
 out vec3 color;
 
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
   gl_Position = projection * view * model * vec4(in_pos, 1.0);
@@ -422,15 +1149,37 @@ void main() {
 }
 )glsl";
 
+static const char *glcubes_vs = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in mat4 in_transform;
+layout (location = 5) in vec4 in_color_size;
+out vec3 color;
+
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
+uniform mat4 model;
+
+void main() {
+  vec4 pos = in_transform * vec4(in_pos * in_color_size.w, 1.0);
+  gl_Position = projection * view * model * pos;
+  color = in_color_size.rgb;
+}
+)glsl";
+
 static const char *glframe_vs = R"glsl(
 #version 330 core
 layout (location = 0) in vec3 in_pos;
 layout (location = 1) in vec3 in_color;
 out vec3 color;
 
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
   gl_Position = projection * view * model * vec4(in_pos, 1.0);
@@ -452,9 +1201,11 @@ static const char *glgrid_vs = R"glsl(
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main() {
   gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -501,10 +1252,56 @@ void main() {
 }
 )glsl";
 
+static const char *glpoints_vs = R"glsl(
+#version 330 core
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec4 in_color;
+layout (location = 2) in float in_intensity;
+out vec3 color;
+
+layout (std140) uniform camera {
+  mat4 projection;
+  mat4 view;
+};
+uniform mat4 model;
+uniform float point_size;
+uniform float point_scale;
+
+void main() {
+  vec4 pos = view * model * vec4(in_pos, 1.0);
+  gl_Position = projection * pos;
+  color = in_color.rgb * in_intensity;
+
+  // Sizes are in meters when attenuated and in pixels otherwise
+  if (point_scale > 0.0) {
+    gl_PointSize = max(point_size * point_scale / max(-pos.z, 1e-3), 1.0);
+  } else {
+    gl_PointSize = point_size;
+  }
+}
+)glsl";
+
+static const char *glpoints_fs = R"glsl(
+#version 150 core
+in vec3 color;
+out vec4 frag_color;
+
+void main() {
+  vec2 d = gl_PointCoord - vec2(0.5);
+  if (dot(d, d) > 0.25) {
+    discard;
+  }
+  frag_color = vec4(color, 1.0f);
+}
+)glsl";
+
 } // namespace shaders
 
 struct globj_t {
-  glprog_t program_;
+  const char *vs_;
+  const char *fs_;
+  glprog_t *program_ = nullptr;
+  gluniform_handle_t model_loc_;
   unsigned int VAO_;
   unsigned int VBO_;
   unsigned int EBO_;
@@ -512,6 +1309,8 @@ struct globj_t {
 
   globj_t(const char *vs, const char *fs);
 
+  glprog_t &program();
+
   void pos(const glm::vec3 &pos);
   glm::vec3 pos();
   glm::mat3 rot();
@@ -537,6 +1336,122 @@ struct glcube_t : globj_t {
   void draw(const glcamera_t &camera);
 };
 
+/**
+ * Per-instance data of `glcubes_t`, `size` is the cube edge length.
+ */
+struct glcube_instance_t {
+  glm::mat4 T;
+  glm::vec3 color;
+  float size;
+};
+
+/**
+ * Instanced cube batch. All cubes share one unit cube mesh and are drawn with
+ * a single `glDrawElementsInstanced` call. Only instances modified since the
+ * last draw are re-uploaded.
+ */
+struct glcubes_t : globj_t {
+  std::vector<glcube_instance_t> instances_;
+  std::vector<size_t> dirty_;
+  std::vector<bool> dirty_flags_;
+  size_t capacity_ = 0;
+  GLuint instance_VBO_;
+
+  glcubes_t();
+  ~glcubes_t();
+  size_t size() const;
+  size_t add(const glm::mat4 &T, const glm::vec3 &color, const float size);
+  void update(const size_t idx,
+              const glm::mat4 &T,
+              const glm::vec3 &color,
+              const float size);
+  size_t remove(const size_t idx);
+  void clear();
+  void upload();
+  void draw(const glcamera_t &camera);
+};
+
+/**
+ * Point cloud vertex (20 bytes). `intensity` scales the color in the shader.
+ */
+struct glpoint_t {
+  glm::vec3 pos;
+  GLubyte color[4];
+  float intensity;
+};
+
+/**
+ * Sets up the `glpoint_t` vertex attributes of the bound VAO, sourced from
+ * the bound array buffer.
+ */
+void glpoint_attributes();
+
+struct glpoints_stats_t {
+  size_t nb_uploads = 0;
+  size_t nb_points = 0;
+  size_t nb_bytes = 0;
+  size_t nb_stalls = 0;
+  double upload_time = 0.0;
+};
+
+/**
+ * Point cloud renderer. Points are written straight into a persistently
+ * mapped buffer when `ARB_buffer_storage` is available, otherwise into an
+ * orphaned buffer through `glMapBufferRange`. `append()` only writes past the
+ * points already drawn so it never waits on the GPU. The persistent buffer
+ * holds one region, fenced after the draws that read it. Once a `set()`
+ * finds that region still being drawn the buffer is split into
+ * `GLPOINTS_NB_REGIONS` regions: `set()` then writes the next region and
+ * only waits if that one is still being drawn, draws read the region
+ * written last. Append-only streaming therefore keeps a single copy.
+ *
+ * Points are accepted interleaved as `glpoint_t` or as separate arrays where
+ * colors and intensities may be `nullptr` (white and 1.0). With `attenuate_`
+ * the point size is in meters, otherwise in pixels.
+ */
+static const int GLPOINTS_NB_REGIONS = 3;
+
+struct glpoints_t : globj_t {
+  size_t size_ = 0;
+  size_t capacity_ = 0; // Points per region
+  bool persistent_ = false;
+  glpoint_t *mapped_ = nullptr;
+  int nb_regions_ = 1;
+  int region_ = 0;
+  GLsync fences_[GLPOINTS_NB_REGIONS] = {};
+  gluniform_handle_t point_size_loc_;
+  gluniform_handle_t point_scale_loc_;
+
+  float point_size_ = 0.05f;
+  bool attenuate_ = true;
+  glpoints_stats_t stats_;
+
+  glpoints_t(const size_t capacity = 0);
+  ~glpoints_t();
+  size_t size() const;
+  void reserve(const size_t capacity);
+  void allocate(const size_t capacity, const int nb_regions);
+  void clear();
+  void set(const glpoint_t *points, const size_t n);
+  void set(const float *xyz,
+           const uint8_t *rgba,
+           const float *intensity,
+           const size_t n);
+  void append(const glpoint_t *points, const size_t n);
+  void append(const float *xyz,
+              const uint8_t *rgba,
+              const float *intensity,
+              const size_t n);
+  void write(const bool replace,
+             const size_t n,
+             const glpoint_t *points,
+             const float *xyz,
+             const uint8_t *rgba,
+             const float *intensity);
+  void print_stats() const;
+  void draw(const glcamera_t &camera);
+};
+
 struct glframe_t : globj_t {
   const float line_width_ = 5.0f;
 
@@ -570,11 +1485,246 @@ struct glplane_t : globj_t {
   void draw(const glcamera_t &camera);
 };
 
+
+/*****************************************************************************
+ *                                 VOXELS
+ ****************************************************************************/
+
+static const int VOXCHUNK_BITS = 5;
+static const int VOXCHUNK_SIZE = 1 << VOXCHUNK_BITS;
+static const int VOXCHUNK_VOLUME = VOXCHUNK_SIZE * VOXCHUNK_SIZE * VOXCHUNK_SIZE;
+
+/**
+ * Dense block of VOXCHUNK_SIZE^3 voxels. Each voxel stores a material index
+ * into the voxel map palette, 0 means empty.
+ */
+struct voxchunk_t {
+  int cx = 0;
+  int cy = 0;
+  int cz = 0;
+  std::vector<uint8_t> voxels = std::vector<uint8_t>(VOXCHUNK_VOLUME, 0);
+  size_t nb_occupied = 0;
+  bool dirty = false;
+};
+
+/**
+ * Voxel mesh vertex, positions are chunk local voxel corners (0 to 32) and
+ * colors are the shaded material color.
+ */
+struct voxvertex_t {
+  GLubyte pos[4];
+  GLubyte color[4];
+};
+
+/**
+ * Sparse voxel map. Chunks are allocated on demand in a hash map keyed by
+ * chunk coordinates, modified chunks are queued for re-meshing and `mesh()`
+ * greedily merges the exposed faces of a chunk into quads.
+ */
+struct voxmap_t {
+  float voxel_size;
+  glm::vec3 palette[256];
+  std::unordered_map<uint64_t, std::unique_ptr<voxchunk_t>> chunks;
+  std::vector<uint64_t> dirty;
+  size_t nb_voxels = 0;
+
+  voxmap_t(const float voxel_size_);
+
+  static uint64_t key(const int cx, const int cy, const int cz);
+  voxchunk_t *chunk(const int cx, const int cy, const int cz) const;
+  uint8_t get(const int x, const int y, const int z) const;
+  void set(const int x, const int y, const int z, const uint8_t material);
+  void add(const glm::vec3 &p, const uint8_t material = 1);
+  void remove(const glm::vec3 &p);
+  void mark_dirty(const int cx, const int cy, const int cz);
+  void mesh(const voxchunk_t &chunk, std::vector<voxvertex_t> &vertices) const;
+};
+
+/**
+ * GPU buffers of a meshed voxel chunk, `T` maps chunk local voxel corners to
+ * the voxel map frame.
+ */
+struct glvoxchunk_t {
+  GLuint VAO = 0;
+  GLuint VBO = 0;
+  size_t nb_quads = 0;
+  glm::mat4 T = glm::mat4(1.0f);
+};
+
+/**
+ * Chunked voxel renderer. Only chunks dirtied since the last draw are
+ * re-meshed and re-uploaded (at most `remesh_budget_` per draw), each chunk
+ * is frustum culled and drawn with one call using a shared quad index buffer.
+ */
 struct glvoxels_t : globj_t {
-  std::vector<GLfloat> vertices;
+  voxmap_t map_;
+  std::unordered_map<uint64_t, glvoxchunk_t> gpu_chunks_;
+  std::vector<voxvertex_t> vertices_;
+  size_t max_quads_ = 0;
+  size_t remesh_budget_ = 16;
 
-  glvoxels_t(const float voxel_size, const size_t max_voxels);
+  glvoxels_t(const float voxel_size);
   ~glvoxels_t();
+  void add(const glm::vec3 &p, const uint8_t material = 1);
+  void remove(const glm::vec3 &p);
+  size_t remesh(const size_t max_chunks = SIZE_MAX);
+  void draw(const glcamera_t &camera);
+};
+
+/**
+ * OctoMap renderer. Occupied leaves of an `octomap::OcTree` are drawn as
+ * instanced cubes, pruned leaves are kept as single larger boxes. Leaves are
+ * grouped into blocks of 2^block_bits_ finest voxels per side, `update()` uses
+ * the tree's change detection to rebuild only the blocks that changed.
+ *
+ * Boxes up to a block in size are listed under their block in `blocks_`.
+ * Coarser boxes are listed once under their own cell, the key shifted down
+ * by their level, in `coarse_[level]`. A block is covered by a coarse box if
+ * its key shifted up to one of the coarse levels is listed there, and
+ * dropping a block drops the coarse box covering it too.
+ */
+struct gloctomap_t {
+  glcubes_t cubes_;
+  glm::vec3 color_{0.9, 0.4, 0.2};
+  unsigned int block_bits_ = 4;
+  std::unordered_map<uint64_t, std::vector<size_t>> blocks_;
+  std::unordered_map<uint64_t, size_t> coarse_[17]; // Levels of 16 bit keys
+  std::vector<uint64_t> slot_keys_;
+  std::vector<uint8_t> slot_levels_;
+
+  gloctomap_t();
+  gloctomap_t(const octomap::OcTree &tree);
+
+  uint64_t cell_key(const octomap::OcTreeKey &key,
+                    const unsigned int level) const;
+  uint64_t block_key(const octomap::OcTreeKey &key) const;
+  uint64_t parent_key(const uint64_t block, const unsigned int level) const;
+  unsigned int covering_level(const uint64_t block) const;
+  void add_box(const uint64_t block,
+               const unsigned int level,
+               const glm::vec3 &center,
+               const float size);
+  void remove_slots(std::vector<size_t> &slots);
+  void remove_block(const uint64_t block);
+  void remove_within(const uint64_t cell, const unsigned int level);
+  void build_region(const octomap::OcTree &tree,
+                    const uint64_t cell,
+                    const unsigned int level);
+  void build_block(const octomap::OcTree &tree, const uint64_t block);
+  void load(const octomap::OcTree &tree);
+  size_t update(octomap::OcTree &tree);
+  void draw(const glcamera_t &camera);
+};
+
+/*****************************************************************************
+ *                              POINT CLOUDS
+ ****************************************************************************/
+
+/**
+ * Out-of-core point cloud file (`.pco`): a header, the points of every octree
+ * node stored contiguously as `glpoint_t`, then the node table as a footer.
+ *
+ * Nodes are additive, each holds a grid subsample (`spacing` apart) of the
+ * points not already held by its ancestors. Drawing a node together with all
+ * its ancestors therefore shows its region at the node's spacing. Node 0 is
+ * the root.
+ */
+struct pcloud_header_t {
+  char magic[8];
+  uint64_t nb_points;
+  uint64_t nb_nodes;
+  uint64_t nodes_offset;
+};
+
+struct pcloud_node_t {
+  float min[3];
+  float size;
+  float spacing;
+  uint32_t nb_points;
+  uint64_t offset;
+  int32_t children[8];
+};
+
+struct pcloud_build_config_t {
+  int grid_size = 128;                 // Subsampling cells per node side
+  size_t max_leaf_points = 20000;      // Smaller nodes are not subdivided
+  size_t max_bucket_points = 8000000;  // Points per in-memory subtree build
+  int max_depth = 20;
+};
+
+/**
+ * Point source of `pcloud_build()`. Replaces the contents of `points` with
+ * the next batch and returns the batch size, 0 at the end of the input.
+ */
+typedef std::function<size_t(std::vector<glpoint_t> &points)> pcloud_reader_t;
+
+/**
+ * Builds a `.pco` file without holding all points in memory. Points are
+ * spooled to disk, the top levels of the octree are subsampled while
+ * streaming and the remaining points are split into buckets of at most
+ * `max_bucket_points` (for evenly spread clouds), each built into a subtree
+ * in memory. Temporary files are written next to `output_path`.
+ */
+int pcloud_build(pcloud_reader_t reader,
+                 const std::string &output_path,
+                 const pcloud_build_config_t &config = pcloud_build_config_t());
+
+struct glpcloud_node_t {
+  GLuint VAO = 0;
+  GLuint VBO = 0;
+  size_t nb_bytes = 0;
+  size_t last_used = 0;
+  bool requested = false;
+};
+
+struct glpcloud_stats_t {
+  size_t nb_visible = 0;
+  size_t nb_drawn = 0;
+  size_t nb_points_drawn = 0;
+  size_t nb_loads = 0;
+  size_t nb_evictions = 0;
+  size_t gpu_bytes = 0;
+};
+
+/**
+ * Out-of-core point cloud renderer for `.pco` files. The file is memory
+ * mapped, each frame nodes are refined in order of their projected spacing
+ * in pixels until it drops below `max_error_` or `point_budget_` is reached.
+ * Missing nodes are read by a background thread and uploaded at most
+ * `upload_budget_` per frame, least recently drawn nodes are evicted to stay
+ * within `gpu_budget_` bytes.
+ */
+struct glpcloud_t : globj_t {
+  int fd_ = -1;
+  const uint8_t *data_ = nullptr;
+  size_t data_size_ = 0;
+  const pcloud_node_t *nodes_ = nullptr;
+  size_t nb_nodes_ = 0;
+  std::vector<glpcloud_node_t> gpu_nodes_;
+  std::vector<int> resident_;
+  size_t frame_ = 0;
+  gluniform_handle_t point_size_loc_;
+  gluniform_handle_t point_scale_loc_;
+
+  std::thread loader_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<int> requests_;
+  std::deque<std::pair<int, std::vector<glpoint_t>>> loaded_;
+  bool stop_ = false;
+
+  size_t gpu_budget_ = 512 * 1024 * 1024;
+  size_t point_budget_ = 10000000;
+  size_t upload_budget_ = 32;
+  float max_error_ = 1.5f;
+  float point_size_ = 2.0f;
+  glpcloud_stats_t stats_;
+
+  glpcloud_t(const std::string &path);
+  ~glpcloud_t();
+  void loader();
+  void evict(const size_t nb_bytes);
+  void upload();
   void draw(const glcamera_t &camera);
 };
 
@@ -593,6 +1743,7 @@ public:
   float dt;
   ImVec4 clear_color{0.45f, 0.55f, 0.60f, 1.00f};
   glcamera_t camera{width, height};
+  GLuint camera_ubo = 0;
 
 	// Mouse
 	bool right_click = false;
@@ -623,6 +1774,280 @@ public:
  *                               GUI IMSHOW
  ****************************************************************************/
 
+enum gui_colormap_t {
+  COLORMAP_GRAY = 0,
+  COLORMAP_JET = 1,
+  COLORMAP_TURBO = 2,
+  COLORMAP_VIRIDIS = 3,
+};
+
+namespace shaders {
+
+static const char *imshow_convert_vs = R"glsl(
+#version 330 core
+
+void main() {
+  // Full screen triangle
+  vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+  gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)glsl";
+
+static const char *imshow_convert_fs = R"glsl(
+#version 330 core
+out vec4 frag_color;
+
+uniform int format;
+uniform sampler2D plane0;
+uniform sampler2D plane1;
+uniform sampler2D plane2;
+uniform int colormap;
+uniform vec2 range;
+uniform float scale;
+
+vec3 yuv_to_rgb(float y, float u, float v) {
+  y = 1.1644 * (y - 0.0625);
+  u -= 0.5;
+  v -= 0.5;
+  vec3 rgb = vec3(y + 1.5960 * v, y - 0.3918 * u - 0.8130 * v, y + 2.0172 * u);
+  return clamp(rgb, 0.0, 1.0);
+}
+
+vec3 jet(float t) {
+  return clamp(vec3(1.5) - abs(4.0 * t - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+}
+
+// Polynomial fit of Turbo, Anton Mikhailov 2019
+vec3 turbo(float t) {
+  const vec4 r4 = vec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+  const vec4 g4 = vec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+  const vec4 b4 = vec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+  const vec2 r2 = vec2(-152.94239396, 59.28637943);
+  const vec2 g2 = vec2(4.27729857, 2.82956604);
+  const vec2 b2 = vec2(-89.90310912, 27.34824973);
+  vec4 v4 = vec4(1.0, t, t * t, t * t * t);
+  vec2 v2 = v4.zw * v4.z;
+  return vec3(dot(v4, r4) + dot(v2, r2),
+              dot(v4, g4) + dot(v2, g2),
+              dot(v4, b4) + dot(v2, b2));
+}
+
+// Polynomial fit of Viridis
+vec3 viridis(float t) {
+  const vec3 c0 = vec3(0.2777273272, 0.0054073445, 0.3340998053);
+  const vec3 c1 = vec3(0.1050930431, 1.4046135299, 1.3845901626);
+  const vec3 c2 = vec3(-0.3308618287, 0.2148475595, 0.0950951630);
+  const vec3 c3 = vec3(-4.6342304990, -5.7991009734, -19.3324409563);
+  const vec3 c4 = vec3(6.2282699363, 14.1799333668, 56.6905526007);
+  const vec3 c5 = vec3(4.7763849977, -13.7451453777, -65.3530326334);
+  const vec3 c6 = vec3(-5.4354558559, 4.6458526122, 26.3124352496);
+  return c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6)))));
+}
+
+float mosaic(ivec2 p) {
+  ivec2 size = textureSize(plane0, 0);
+  return texelFetch(plane0, clamp(p, ivec2(0), size - 1), 0).r;
+}
+
+void main() {
+  ivec2 p = ivec2(gl_FragCoord.xy);
+  vec3 rgb = vec3(0.0);
+
+  if (format == 1) {
+    // YUYV, one texel holds Y0 U Y1 V for two pixels
+    vec4 t = texelFetch(plane0, ivec2(p.x / 2, p.y), 0);
+    rgb = yuv_to_rgb((p.x % 2 == 0) ? t.r : t.b, t.g, t.a);
+  } else if (format == 2) {
+    // NV12
+    float y = texelFetch(plane0, p, 0).r;
+    vec2 uv = texelFetch(plane1, p / 2, 0).rg;
+    rgb = yuv_to_rgb(y, uv.x, uv.y);
+  } else if (format == 3) {
+    // I420
+    float y = texelFetch(plane0, p, 0).r;
+    float u = texelFetch(plane1, p / 2, 0).r;
+    float v = texelFetch(plane2, p / 2, 0).r;
+    rgb = yuv_to_rgb(y, u, v);
+  } else if (format == 6 || format == 7) {
+    // Depth / float, R16 samples are normalized so scale restores raw units
+    float v = texelFetch(plane0, p, 0).r * scale;
+    bool valid = !isnan(v) && !isinf(v) && (format == 7 || v > 0.0);
+    float t = clamp((v - range.x) / max(range.y - range.x, 1e-9), 0.0, 1.0);
+    if (colormap == 1) {
+      rgb = jet(t);
+    } else if (colormap == 2) {
+      rgb = turbo(t);
+    } else if (colormap == 3) {
+      rgb = viridis(t);
+    } else {
+      rgb = vec3(t);
+    }
+    rgb = (valid) ? clamp(rgb, 0.0, 1.0) : vec3(0.0);
+  } else {
+    // Bayer, BGGR is RGGB shifted by one pixel diagonally
+    float c = mosaic(p);
+    float h = (mosaic(p + ivec2(-1, 0)) + mosaic(p + ivec2(1, 0))) * 0.5;
+    float v = (mosaic(p + ivec2(0, -1)) + mosaic(p + ivec2(0, 1))) * 0.5;
+    float d = (mosaic(p + ivec2(-1, -1)) + mosaic(p + ivec2(1, -1)) +
+               mosaic(p + ivec2(-1, 1)) + mosaic(p + ivec2(1, 1))) * 0.25;
+    ivec2 site = (format == 5) ? 1 - p % 2 : p % 2;
+    if (site == ivec2(0, 0)) {
+      rgb = vec3(c, (h + v) * 0.5, d);
+    } else if (site == ivec2(1, 1)) {
+      rgb = vec3(d, (h + v) * 0.5, c);
+    } else if (site == ivec2(1, 0)) {
+      rgb = vec3(h, c, v);
+    } else {
+      rgb = vec3(v, c, h);
+    }
+  }
+
+  frag_color = vec4(rgb, 1.0);
+}
+)glsl";
+
+// Min / max of 8x8 blocks, the first pass reads the image and later ones
+// previous min / max levels
+static const char *imshow_minmax_fs = R"glsl(
+#version 330 core
+out vec2 frag_minmax;
+
+uniform sampler2D src;
+uniform int first;
+uniform int zero_invalid;
+uniform float scale;
+
+void main() {
+  ivec2 size = textureSize(src, 0);
+  ivec2 base = ivec2(gl_FragCoord.xy) * 8;
+  float lo = 1e30;
+  float hi = -1e30;
+  for (int y = 0; y < 8; y++) {
+    for (int x = 0; x < 8; x++) {
+      ivec2 p = base + ivec2(x, y);
+      if (p.x >= size.x || p.y >= size.y) {
+        continue;
+      }
+      vec2 t = texelFetch(src, p, 0).rg;
+      if (first == 1) {
+        float v = t.r * scale;
+        if (isnan(v) || isinf(v) || (zero_invalid == 1 && v == 0.0)) {
+          continue;
+        }
+        t = vec2(v);
+      }
+      lo = min(lo, t.x);
+      hi = max(hi, t.y);
+    }
+  }
+  frag_minmax = vec2(lo, hi);
+}
+)glsl";
+
+} // namespace shaders
+
+struct gui_imshow_pbo_t {
+  GLuint id = 0;
+  uint8_t *mapped = nullptr;
+  GLsync fence = nullptr;
+  GLuint query = 0;
+  bool query_pending = false;
+};
+
+struct gui_imshow_plane_t {
+  GLuint id = 0;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  size_t offset = 0;
+  GLenum internal_format = GL_R8;
+  GLenum type = GL_UNSIGNED_BYTE;
+};
+
+struct gui_imshow_stats_t {
+  size_t nb_frames = 0;
+  size_t nb_bytes = 0;
+  size_t nb_stalls = 0;
+  size_t nb_gpu_samples = 0;
+  double stall_time = 0.0;  // Waiting in map() for the GPU to free a buffer
+  double upload_time = 0.0; // In publish() submitting the texture copy
+  double latency = 0.0;     // From map() to the texture copy submitted
+  double gpu_time = 0.0;    // Copies and conversion on the GPU
+
+  // Last frame
+  double last_stall_time = 0.0;
+  double last_upload_time = 0.0;
+  double last_latency = 0.0;
+  double last_gpu_time = 0.0;
+
+  // Shared memory frames, producer timestamp to upload
+  double shm_latency = 0.0;
+  double last_shm_latency = 0.0;
+};
+
+/**
+ * Latest-wins triple buffer handing frames from one producer thread to the
+ * render thread without locks. The producer fills `write_frame()` and calls
+ * `publish()`, which swaps it with the shared middle buffer. `consume()` on
+ * the render thread swaps the middle buffer into `read_frame()` if a newer
+ * one was published. Frames published in between are dropped.
+ */
+struct gui_imshow_frame_t {
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  gui_imshow_format_t format = IMSHOW_DIRECT;
+  uint64_t seq = 0;
+  std::vector<uint8_t> data;
+};
+
+struct gui_imshow_frames_t {
+  static constexpr int FRESH = 4;
+
+  gui_imshow_frame_t buffers[3];
+  std::atomic<int> middle{1};
+  int write = 0; // Producer only
+  int read = 2;  // Consumer only
+
+  std::atomic<size_t> nb_published{0};
+  std::atomic<size_t> nb_dropped{0};
+  size_t nb_consumed = 0;
+
+  gui_imshow_frame_t &write_frame();
+  void publish();
+  bool consume();
+  const gui_imshow_frame_t &read_frame() const;
+};
+
+/**
+ * Image window. `update()` copies pixels into the texture synchronously
+ * until `stream()` switches it to a ring of pixel buffer objects: the
+ * producer writes a frame straight into the buffer returned by `map()`, or
+ * lets `update()` memcpy it there, and `publish()` queues the texture copy
+ * from that buffer without waiting for the GPU. Buffers are persistently
+ * mapped with `ARB_buffer_storage` and fenced, otherwise orphaned on every
+ * map. Stall time, latency and the GPU copy time from timer queries are
+ * kept per frame in `stats_`.
+ *
+ * `submit()` may be called from any one producer thread, it copies the frame
+ * into `frames_` and never blocks. `show()` uploads the newest submitted
+ * frame, initializing the window from the first one if needed.
+ *
+ * Windows initialized with a `gui_imshow_format_t` other than
+ * `IMSHOW_DIRECT` take raw camera frames. Their planes are uploaded as is
+ * into `planes_` and converted to RGBA into `img_id_` through `FBO_`.
+ *
+ * Depth and float images map `range_min_` to `range_max_` onto `colormap_`.
+ * With `auto_range_` the range follows the valid min / max of the image,
+ * reduced on the GPU and read back through a pixel pack buffer a frame
+ * later so the render thread never waits on it.
+ *
+ * `attach()` takes frames from a `shm_producer_t` in another process by
+ * name. `show()` uploads the newest one straight from the shared mapping,
+ * without the PBO ring, and counts frames the producer overwrote during the
+ * upload as torn in `shm_`. Segments whose frames differ from an initialized
+ * window are refused, and a restarted producer is re-attached.
+ */
 class gui_imshow_t {
 public:
   bool ok_ = false;
@@ -637,6 +2062,38 @@ public:
   int img_channels_ = 0;
   GLuint img_id_;
 
+  // Raw camera formats
+  gui_imshow_format_t format_ = IMSHOW_DIRECT;
+  std::vector<gui_imshow_plane_t> planes_;
+  glprog_t *convert_program_ = nullptr;
+  GLuint convert_VAO_ = 0;
+
+  // Depth and float images
+  gui_colormap_t colormap_ = COLORMAP_TURBO;
+  bool auto_range_ = true;
+  float range_min_ = 0.0f;
+  float range_max_ = 1.0f;
+  glprog_t *minmax_program_ = nullptr;
+  GLuint minmax_FBO_ = 0;
+  GLuint minmax_PBO_ = 0;
+  GLsync minmax_fence_ = nullptr;
+  std::vector<gui_imshow_plane_t> minmax_levels_;
+
+  // Streaming upload
+  bool persistent_ = false;
+  size_t pbo_size_ = 0;
+  size_t pbo_index_ = 0;
+  std::vector<gui_imshow_pbo_t> pbos_;
+  uint8_t *writing_ = nullptr;
+  double map_time_ = 0.0;
+  gui_imshow_stats_t stats_;
+
+  // Frames from a producer thread
+  gui_imshow_frames_t frames_;
+
+  // Frames from a producer process
+  shm_consumer_t shm_;
+
   gui_imshow_t(const std::string &title);
   gui_imshow_t(const std::string &title, const std::string &img_path);
   gui_imshow_t(const std::string &title,
@@ -644,20 +2101,53 @@ public:
                const int img_height,
                const int img_channels,
                const unsigned char *data);
+  gui_imshow_t(const std::string &title,
+               const int img_width,
+               const int img_height,
+               const gui_imshow_format_t format,
+               const unsigned char *data);
+  gui_imshow_t(const gui_imshow_t &) = delete;
+  gui_imshow_t &operator=(const gui_imshow_t &) = delete;
+  ~gui_imshow_t();
 
   void init(const std::string &title,
             const int img_width,
             const int img_height,
             const int img_channels,
             const unsigned char *data);
+  void init(const std::string &title,
+            const int img_width,
+            const int img_height,
+            const gui_imshow_format_t format,
+            const unsigned char *data);
 
   bool ok();
+  int attach(const std::string &name);
+  void stream(const size_t nb_buffers = 2);
+  uint8_t *map();
+  void publish();
+  void upload(const uint8_t *pixels);
+  void convert();
+  void reduce_range();
   void update(void *pixels);
+  void submit(const int img_width,
+              const int img_height,
+              const int img_channels,
+              const unsigned char *data);
+  void submit(const int img_width,
+              const int img_height,
+              const gui_imshow_format_t format,
+              const unsigned char *data);
+  void print_stats() const;
   void show();
   void show(const int img_width,
             const int img_height,
             const int img_channels,
             const unsigned char *data);
+  void show(const int img_width,
+            const int img_height,
+            const gui_imshow_format_t format,
+            const unsigned char *data);
 };
 
 } // namespace show
@@ -0,0 +1,34 @@
+#include "show.hpp"
+
+// Bakes any model Assimp can read into a .showm file that glmodel_t loads
+// by mmap, with vertices and indices already in the GPU layout. Texture
+// paths stay relative, keep the output next to the model's textures.
+
+static void print_usage() {
+  printf("Usage: show_bake <input model> <output.showm> "
+         "[full|compact|qpos]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3 && argc != 4) {
+    print_usage();
+    return -1;
+  }
+  const std::string input_path = argv[1];
+  const std::string output_path = argv[2];
+  const std::string layout_name = (argc == 4) ? argv[3] : "qpos";
+
+  show::glvertex_layout_t layout;
+  if (layout_name == "full") {
+    layout = show::GLVERTEX_FULL;
+  } else if (layout_name == "compact") {
+    layout = show::GLVERTEX_COMPACT;
+  } else if (layout_name == "qpos") {
+    layout = show::GLVERTEX_COMPACT_QPOS;
+  } else {
+    print_usage();
+    return -1;
+  }
+
+  return show::glmodel_bake(input_path, output_path, layout);
+}
@@ -0,0 +1,72 @@
+#include "show.hpp"
+
+// Builds an out-of-core point cloud (.pco) from either an ASCII file with
+// one `x y z [r g b [intensity]]` point per line (colors 0-255), or a raw
+// binary file of `show::glpoint_t` (.bin).
+
+static void print_usage() {
+  printf("Usage: show_pcbuild <input.xyz|input.bin> <output.pco>\n");
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    print_usage();
+    return -1;
+  }
+  const std::string input_path = argv[1];
+  const std::string output_path = argv[2];
+
+  const bool binary = ends_with(input_path, ".bin");
+  FILE *fp = fopen(input_path.c_str(), (binary) ? "rb" : "r");
+  if (fp == NULL) {
+    LOG_ERROR("Failed to open [%s]!", input_path.c_str());
+    return -1;
+  }
+
+  const size_t batch_size = 65536;
+  show::pcloud_reader_t reader;
+  if (binary) {
+    reader = [&](std::vector<show::glpoint_t> &points) {
+      points.resize(batch_size);
+      const size_t n =
+          fread(points.data(), sizeof(show::glpoint_t), batch_size, fp);
+      points.resize(n);
+      return n;
+    };
+
+  } else {
+    reader = [&](std::vector<show::glpoint_t> &points) {
+      points.clear();
+      char line[1024];
+      while (points.size() < batch_size && fgets(line, sizeof(line), fp)) {
+        float x, y, z;
+        int r = 255, g = 255, b = 255;
+        float intensity = 1.0f;
+        const char *fmt = "%f %f %f %d %d %d %f";
+        if (sscanf(line, fmt, &x, &y, &z, &r, &g, &b, &intensity) < 3) {
+          continue;
+        }
+
+        show::glpoint_t p;
+        p.pos = glm::vec3{x, y, z};
+        p.color[0] = r;
+        p.color[1] = g;
+        p.color[2] = b;
+        p.color[3] = 255;
+        p.intensity = intensity;
+        points.push_back(p);
+      }
+      return points.size();
+    };
+  }
+
+  const int retval = show::pcloud_build(reader, output_path);
+  fclose(fp);
+
+  return retval;
+}
@@ -0,0 +1,167 @@
+#include "show.hpp"
+
+#define STB_DXT_IMPLEMENTATION
+#include "stb_dxt.h"
+
+// Encodes an image into a block compressed DDS with a full mip chain. The
+// output is written next to the input, e.g. `diffuse.png` ->
+// `diffuse.png.dds`, where the texture loaders pick it up in place of the
+// original until the original is modified.
+
+static void print_usage() {
+  printf("Usage: show_texc <input image> [auto|bc1|bc3|bc4|bc5]\n");
+}
+
+// Box filter one level down, edges clamp for odd sizes
+static std::vector<uint8_t> downsample(const std::vector<uint8_t> &src,
+                                       const int width,
+                                       const int height,
+                                       const int channels) {
+  const int w = std::max(width / 2, 1);
+  const int h = std::max(height / 2, 1);
+  std::vector<uint8_t> dst(w * h * channels);
+
+  for (int y = 0; y < h; y++) {
+    const int y0 = std::min(y * 2, height - 1);
+    const int y1 = std::min(y * 2 + 1, height - 1);
+    for (int x = 0; x < w; x++) {
+      const int x0 = std::min(x * 2, width - 1);
+      const int x1 = std::min(x * 2 + 1, width - 1);
+      for (int c = 0; c < channels; c++) {
+        const int sum = src[(y0 * width + x0) * channels + c] +
+                        src[(y0 * width + x1) * channels + c] +
+                        src[(y1 * width + x0) * channels + c] +
+                        src[(y1 * width + x1) * channels + c];
+        dst[(y * w + x) * channels + c] = (sum + 2) / 4;
+      }
+    }
+  }
+
+  return dst;
+}
+
+// Encode one level, blocks past the edge repeat the last row / column
+static void encode_level(const std::vector<uint8_t> &rgba,
+                         const int width,
+                         const int height,
+                         const GLenum format,
+                         std::vector<uint8_t> &out) {
+  const size_t block_size = show::texture_block_size(format);
+  uint8_t block[16 * 4];
+  uint8_t encoded[16];
+
+  for (int by = 0; by < height; by += 4) {
+    for (int bx = 0; bx < width; bx += 4) {
+      for (int i = 0; i < 16; i++) {
+        const int x = std::min(bx + i % 4, width - 1);
+        const int y = std::min(by + i / 4, height - 1);
+        const uint8_t *px = &rgba[(y * width + x) * 4];
+
+        switch (format) {
+        case GL_COMPRESSED_RED_RGTC1:
+          block[i] = px[0];
+          break;
+        case GL_COMPRESSED_RG_RGTC2:
+          block[i * 2 + 0] = px[0];
+          block[i * 2 + 1] = px[1];
+          break;
+        default:
+          memcpy(&block[i * 4], px, 4);
+          break;
+        }
+      }
+
+      switch (format) {
+      case GL_COMPRESSED_RED_RGTC1:
+        stb_compress_bc4_block(encoded, block);
+        break;
+      case GL_COMPRESSED_RG_RGTC2:
+        stb_compress_bc5_block(encoded, block);
+        break;
+      case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        stb_compress_dxt_block(encoded, block, 1, STB_DXT_HIGHQUAL);
+        break;
+      default:
+        stb_compress_dxt_block(encoded, block, 0, STB_DXT_HIGHQUAL);
+        break;
+      }
+      out.insert(out.end(), encoded, encoded + block_size);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2 && argc != 3) {
+    print_usage();
+    return -1;
+  }
+  const std::string input_path = argv[1];
+  const std::string format_name = (argc == 3) ? argv[2] : "auto";
+
+  // Load image, expanded to RGBA
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  uint8_t *data = stbi_load(input_path.c_str(), &width, &height, &channels, 4);
+  if (data == nullptr) {
+    LOG_ERROR("Failed to load [%s]!", input_path.c_str());
+    return -1;
+  }
+  std::vector<uint8_t> rgba(data, data + width * height * 4);
+  stbi_image_free(data);
+
+  // Pick format, auto goes by the channels in the source
+  GLenum format = 0;
+  if (format_name == "bc1") {
+    format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  } else if (format_name == "bc3") {
+    format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  } else if (format_name == "bc4") {
+    format = GL_COMPRESSED_RED_RGTC1;
+  } else if (format_name == "bc5") {
+    format = GL_COMPRESSED_RG_RGTC2;
+  } else if (format_name == "auto") {
+    switch (channels) {
+    case 1: format = GL_COMPRESSED_RED_RGTC1; break;
+    case 2: format = GL_COMPRESSED_RG_RGTC2; break;
+    case 3: format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+    default: format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+    }
+  } else {
+    print_usage();
+    return -1;
+  }
+
+  // Encode mip chain down to 1x1
+  show::gltexture_compressed_t texture;
+  texture.format = format;
+  texture.width = width;
+  texture.height = height;
+  while (true) {
+    const size_t offset = texture.data.size();
+    encode_level(rgba, width, height, format, texture.data);
+    texture.level_offsets.push_back(offset);
+    texture.level_sizes.push_back(texture.data.size() - offset);
+    if (width == 1 && height == 1) {
+      break;
+    }
+
+    rgba = downsample(rgba, width, height, 4);
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+
+  const std::string output_path = show::texture_compressed_path(input_path);
+  if (output_path == input_path) {
+    LOG_ERROR("Input [%s] is already a DDS file!", input_path.c_str());
+    return -1;
+  }
+  if (show::dds_save(output_path, texture) != 0) {
+    return -1;
+  }
+  LOG_INFO("Wrote [%s] with %zu levels",
+           output_path.c_str(),
+           texture.level_sizes.size());
+
+  return 0;
+}
@@ -1,20 +1,939 @@
 #include "munit.hpp"
 #include "show.hpp"
 
+#include <sys/time.h>
+
 int test_gui_imshow() {
   show::gui_t gui{"Show"};
   show::gui_imshow_t imshow{"Image", "assets/container.jpg"};
 
   gui.loop([&]() {
-		imshow.draw(gui.camera);
+		imshow.show();
     return 0;
 	});
 
   return 0;
 }
 
+int test_glpoints_regions() {
+  show::gui_t gui{"Show"};
+
+  // Streaming appends and replaces the GPU is done with keep one region
+  std::vector<show::glpoint_t> batch(1000);
+  for (size_t i = 0; i < batch.size(); i++) {
+    batch[i].pos = glm::vec3{(float) i, 0.0f, 0.0f};
+    memset(batch[i].color, 255, 4);
+    batch[i].intensity = 1.0f;
+  }
+  show::glpoints_t points;
+  for (int i = 0; i < 4; i++) {
+    points.append(batch.data(), batch.size());
+    points.draw(gui.camera);
+  }
+  MU_CHECK(points.size() == 4000);
+  MU_CHECK(points.nb_regions_ == 1);
+  glFinish();
+  points.set(batch.data(), batch.size());
+  MU_CHECK(points.size() == 1000);
+  MU_CHECK(points.nb_regions_ == 1);
+
+  return 0;
+}
+
+int test_glprog_uniform() {
+  show::gui_t gui{"Show"};
+
+  const char *vs = R"(
+#version 330 core
+layout (location = 0) in vec3 in_pos;
+void main() { gl_Position = vec4(in_pos, 1.0); }
+)";
+  const char *fs = R"(
+#version 330 core
+struct light_t {
+  vec3 color;
+  vec3 pos;
+};
+uniform float arr[3];
+uniform light_t lights[2];
+out vec4 frag_color;
+void main() {
+  vec3 c = lights[0].color + lights[1].color + lights[0].pos + lights[1].pos;
+  frag_color = vec4(c * (arr[0] + arr[1] + arr[2]), 1.0);
+}
+)";
+  show::glprog_t prog{vs, fs};
+
+  // No duplicate names from struct array members
+  for (size_t i = 1; i < prog.uniforms.size(); i++) {
+    MU_CHECK(prog.uniforms[i - 1].name < prog.uniforms[i].name);
+  }
+  MU_CHECK(prog.uniform("arr").valid());
+  MU_CHECK(prog.uniform("lights[0].color").valid());
+
+  // Elements past the first resolve through GL and are cached
+  const size_t nb_uniforms = prog.uniforms.size();
+  const show::gluniform_handle_t arr2 = prog.uniform("arr[2]");
+  MU_CHECK(arr2.valid());
+  MU_CHECK(arr2.location != prog.uniform("arr").location);
+  MU_CHECK(prog.uniform("lights[1].color").valid());
+  MU_CHECK(prog.uniform("missing").valid() == false);
+  MU_CHECK(prog.uniforms.size() == nb_uniforms + 3);
+  MU_CHECK(prog.uniform("arr[2]").location == arr2.location);
+  MU_CHECK(prog.uniforms.size() == nb_uniforms + 3);
+
+  prog.use();
+  MU_CHECK(prog.set("arr[2]", 1.0f) == 0);
+
+  return 0;
+}
+
+int test_voxmap_mesh() {
+  std::vector<show::voxvertex_t> vertices;
+
+  // Single voxel -> 6 faces
+  show::voxmap_t map{0.1};
+  map.set(0, 0, 0, 1);
+  map.mesh(*map.chunk(0, 0, 0), vertices);
+  MU_CHECK(vertices.size() == 6 * 4);
+
+  // 2x2x2 block -> faces merged into 6 quads
+  for (int x = 0; x < 2; x++) {
+    for (int y = 0; y < 2; y++) {
+      for (int z = 0; z < 2; z++) {
+        map.set(x, y, z, 1);
+      }
+    }
+  }
+  vertices.clear();
+  map.mesh(*map.chunk(0, 0, 0), vertices);
+  MU_CHECK(vertices.size() == 6 * 4);
+  MU_CHECK(map.nb_voxels == 8);
+
+  // Voxels either side of a chunk boundary hide each other's faces
+  show::voxmap_t map2{0.1};
+  map2.set(31, 0, 0, 1);
+  map2.set(32, 0, 0, 1);
+  MU_CHECK(map2.chunks.size() == 2);
+  vertices.clear();
+  map2.mesh(*map2.chunk(0, 0, 0), vertices);
+  map2.mesh(*map2.chunk(1, 0, 0), vertices);
+  MU_CHECK(vertices.size() == 10 * 4);
+
+  // Negative coordinates
+  map2.set(-1, -1, -1, 2);
+  MU_CHECK(map2.get(-1, -1, -1) == 2);
+  MU_CHECK(map2.chunk(-1, -1, -1) != nullptr);
+
+  return 0;
+}
+
+int test_glvertices_pack() {
+  // Vertices with random unit normals and tangents, both bitangent signs
+  std::vector<show::glvertex_t> vertices;
+  srand(1);
+  for (int i = 0; i < 1000; i++) {
+    auto rnd = []() { return (rand() / (float) RAND_MAX) * 2.0f - 1.0f; };
+    show::glvertex_t v;
+    v.position = glm::vec3{rnd() * 10.0f, rnd() * 5.0f, rnd()};
+    v.normal = glm::normalize(glm::vec3{rnd(), rnd(), rnd()});
+    const glm::vec3 r{rnd(), rnd(), rnd()};
+    v.tangent = glm::normalize(glm::cross(v.normal, r));
+    v.bitangent = glm::cross(v.normal, v.tangent) * ((i % 2) ? 1.0f : -1.0f);
+    v.texcoords = glm::vec2{rnd(), rnd()};
+    vertices.push_back(v);
+  }
+
+  const show::glvertex_layout_t layouts[2] = {show::GLVERTEX_COMPACT,
+                                              show::GLVERTEX_COMPACT_QPOS};
+  for (const auto layout : layouts) {
+    show::glvertices_t packed;
+    show::glvertices_pack(vertices, layout, packed);
+    MU_CHECK(packed.size == vertices.size());
+    const size_t full_size = vertices.size() * sizeof(show::glvertex_t);
+    MU_CHECK(packed.data.size() <= full_size / 2);
+
+    std::vector<show::glvertex_t> unpacked;
+    show::glvertices_unpack(packed, unpacked);
+    for (size_t i = 0; i < vertices.size(); i++) {
+      const auto &a = vertices[i];
+      const auto &b = unpacked[i];
+      MU_CHECK(glm::length(a.position - b.position) < 1e-3);
+      MU_CHECK(glm::length(a.normal - b.normal) < 1e-3);
+      MU_CHECK(glm::length(a.tangent - b.tangent) < 1e-3);
+      MU_CHECK(glm::length(a.bitangent - b.bitangent) < 2e-3);
+      MU_CHECK(glm::length(a.texcoords - b.texcoords) < 1e-3);
+    }
+  }
+
+  return 0;
+}
+
+int test_glmesh_optimize() {
+  // Unwelded 32x32 quad grid, triangles in random order
+  const int n = 32;
+  std::vector<show::glvertex_t> vertices;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      const int corners[6][2] = {{0, 0}, {1, 0}, {1, 1},
+                                 {0, 0}, {1, 1}, {0, 1}};
+      for (const auto &c : corners) {
+        show::glvertex_t v = {};
+        v.position = glm::vec3(i + c[0], j + c[1], 0.0f);
+        v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        vertices.push_back(v);
+      }
+    }
+  }
+  std::vector<unsigned int> indices(vertices.size());
+  for (size_t i = 0; i < indices.size(); i++) {
+    indices[i] = i;
+  }
+  srand(1);
+  for (size_t t = indices.size() / 3 - 1; t > 0; t--) {
+    const size_t k = rand() % (t + 1);
+    for (int j = 0; j < 3; j++) {
+      std::swap(indices[t * 3 + j], indices[k * 3 + j]);
+    }
+  }
+  const std::vector<show::glvertex_t> vertices_before = vertices;
+  const std::vector<unsigned int> indices_before = indices;
+
+  const auto stats = show::glmesh_optimize(vertices, indices);
+  MU_CHECK(stats.nb_triangles == (size_t) (n * n * 2));
+  MU_CHECK(stats.nb_vertices_after == (size_t) ((n + 1) * (n + 1)));
+  MU_CHECK(stats.acmr_before == 3.0f);
+  MU_CHECK(stats.acmr_after < 1.0f);
+
+  // Same triangles before and after
+  auto triangles = [](const std::vector<show::glvertex_t> &v,
+                      const std::vector<unsigned int> &idx) {
+    std::vector<std::vector<float>> tris;
+    for (size_t t = 0; t < idx.size(); t += 3) {
+      std::vector<float> tri;
+      for (int j = 0; j < 3; j++) {
+        tri.push_back(v[idx[t + j]].position.x);
+        tri.push_back(v[idx[t + j]].position.y);
+      }
+      tris.push_back(tri);
+    }
+    std::sort(tris.begin(), tris.end());
+    return tris;
+  };
+  MU_CHECK(triangles(vertices, indices) ==
+           triangles(vertices_before, indices_before));
+
+  return 0;
+}
+
+int test_glindices_pack() {
+  // Small mesh, 16-bit indices in a single range
+  std::vector<unsigned int> indices = {0, 1, 2, 2, 1, 3};
+  show::glindices_t packed;
+  show::glindices_pack(indices, 4, false, packed);
+  MU_CHECK(packed.type == GL_UNSIGNED_SHORT);
+  MU_CHECK(packed.data.size() == indices.size() * sizeof(GLushort));
+  MU_CHECK(packed.ranges.size() == 1);
+
+  // Triangle strip over 200k vertices, 32-bit unless split
+  const unsigned int nb_vertices = 200000;
+  indices.clear();
+  for (unsigned int i = 0; i + 2 < nb_vertices; i++) {
+    indices.push_back(i);
+    indices.push_back(i + 1);
+    indices.push_back(i + 2);
+  }
+  show::glindices_pack(indices, nb_vertices, false, packed);
+  MU_CHECK(packed.type == GL_UNSIGNED_INT);
+  MU_CHECK(packed.ranges.size() == 1);
+
+  show::glindices_pack(indices, nb_vertices, true, packed);
+  MU_CHECK(packed.type == GL_UNSIGNED_SHORT);
+  MU_CHECK(packed.ranges.size() == 4);
+  size_t nb_indices = 0;
+  for (const auto &range : packed.ranges) {
+    MU_CHECK(range.offset == nb_indices);
+    MU_CHECK(range.count % 3 == 0);
+    nb_indices += range.count;
+  }
+  MU_CHECK(nb_indices == indices.size());
+
+  std::vector<unsigned int> unpacked;
+  show::glindices_unpack(packed, unpacked);
+  MU_CHECK(unpacked == indices);
+
+  // A triangle spanning more than 16 bits cannot be split, 32-bit fallback
+  const std::vector<unsigned int> wide = {0, 1, 2, 0, 70000, 1};
+  show::glindices_pack(wide, 70001, true, packed);
+  MU_CHECK(packed.type == GL_UNSIGNED_INT);
+  MU_CHECK(packed.ranges.size() == 1);
+  show::glindices_unpack(packed, unpacked);
+  MU_CHECK(unpacked == wide);
+
+  // And is rejected by the arena
+  std::vector<show::glvertex_t> vertices(70001);
+  show::glarena_t arena;
+  MU_CHECK(show::glarena_add(arena, vertices, wide, {}) == -1);
+  MU_CHECK(arena.nb_indices == 0);
+
+  return 0;
+}
+
+int test_glarena_add() {
+  // Quad, 70k vertex strip and a second quad sharing the first's texture
+  std::vector<show::glvertex_t> quad(4);
+  std::vector<unsigned int> quad_indices = {0, 1, 2, 2, 1, 3};
+  const unsigned int nb_strip = 70000;
+  std::vector<show::glvertex_t> strip(nb_strip);
+  std::vector<unsigned int> strip_indices;
+  for (unsigned int i = 0; i + 2 < nb_strip; i++) {
+    strip_indices.push_back(i);
+    strip_indices.push_back(i + 1);
+    strip_indices.push_back(i + 2);
+  }
+  const std::vector<show::gltexture_t> tex_a = {{1, "texture_diffuse", "a"}};
+  const std::vector<show::gltexture_t> tex_b = {{2, "texture_diffuse", "b"}};
+
+  show::glarena_t arena{show::GLVERTEX_COMPACT_QPOS,
+                        glm::vec3(-1.0f),
+                        glm::vec3(1.0f)};
+  show::glarena_add(arena, quad, quad_indices, tex_a);
+  show::glarena_add(arena, strip, strip_indices, tex_b);
+  show::glarena_add(arena, quad, quad_indices, tex_a);
+  MU_CHECK(arena.nb_vertices == nb_strip + 8);
+  MU_CHECK(arena.nb_indices == strip_indices.size() + 12);
+  MU_CHECK(arena.index_data.size() == arena.nb_indices * sizeof(GLushort));
+  MU_CHECK(arena.batches.size() == 2);
+
+  // Draws index into the shared buffers
+  const auto &a = arena.batches[0].commands;
+  MU_CHECK(a.size() == 2);
+  MU_CHECK(a[1].first_index == strip_indices.size() + 6);
+  MU_CHECK(a[1].base_vertex == (GLint) (nb_strip + 4));
+
+  // The strip does not fit 16 bits and is split
+  const auto &b = arena.batches[1].commands;
+  MU_CHECK(b.size() == 2);
+  MU_CHECK(b[0].first_index == 6 && b[0].base_vertex == 4);
+  MU_CHECK(b[0].count + b[1].count == strip_indices.size());
+
+  return 0;
+}
+
+int test_thread_pool() {
+  // Every index is visited exactly once
+  show::thread_pool_t pool{4};
+  std::vector<int> visits(10000, 0);
+  pool.parallel_for(visits.size(), [&](const size_t i) { visits[i]++; });
+  for (const auto v : visits) {
+    MU_CHECK(v == 1);
+  }
+
+  // Fewer indices than workers and none at all
+  std::atomic<int> sum{0};
+  pool.parallel_for(2, [&](const size_t i) { sum += i + 1; });
+  MU_CHECK(sum == 3);
+  pool.parallel_for(0, [&](const size_t) { sum = -1; });
+  MU_CHECK(sum == 3);
+
+  return 0;
+}
+
+int test_glmodel_bake() {
+  const char *model_path = "assets/nanosuit/nanosuit.obj";
+  const char *baked_path = "/tmp/test_nanosuit.showm";
+  MU_CHECK(show::glmodel_bake(model_path, baked_path) == 0);
+  MU_CHECK(show::glmodel_is_baked(baked_path));
+  MU_CHECK(show::glmodel_is_baked(model_path) == false);
+
+  // Header and sections fit the file
+  FILE *fp = fopen(baked_path, "rb");
+  MU_CHECK(fp != NULL);
+  show::glmodel_bake_header_t header;
+  MU_CHECK(fread(&header, sizeof(header), 1, fp) == 1);
+  fseek(fp, 0, SEEK_END);
+  const size_t file_size = ftell(fp);
+  fclose(fp);
+  remove(baked_path);
+
+  MU_CHECK(header.vertex_layout == show::GLVERTEX_COMPACT_QPOS);
+  MU_CHECK(header.nb_vertices > 0);
+  MU_CHECK(header.nb_indices % 3 == 0);
+  MU_CHECK(header.nb_batches > 0);
+  MU_CHECK(header.nb_commands >= header.nb_batches);
+  MU_CHECK(header.vertex_offset % 16 == 0);
+  const size_t textures_size =
+      header.nb_textures * sizeof(show::glmodel_bake_texture_t);
+  MU_CHECK(header.textures_offset + textures_size == file_size);
+
+  return 0;
+}
+
+int test_pcloud_build() {
+  // Three batches of points in a unit cube, split into 8 buckets
+  show::pcloud_build_config_t config;
+  config.grid_size = 8;
+  config.max_leaf_points = 500;
+  config.max_bucket_points = 10000;
+  const size_t batch_size = 20000;
+  int nb_batches = 3;
+  srand(42);
+  auto reader = [&](std::vector<show::glpoint_t> &points) {
+    if (nb_batches-- == 0) {
+      return (size_t) 0;
+    }
+    points.resize(batch_size);
+    for (auto &p : points) {
+      p.pos = glm::vec3{rand() / (float) RAND_MAX,
+                        rand() / (float) RAND_MAX,
+                        rand() / (float) RAND_MAX};
+      p.intensity = 1.0f;
+    }
+    return batch_size;
+  };
+  const std::string path = "/tmp/test_pcloud.pco";
+  MU_CHECK(show::pcloud_build(reader, path, config) == 0);
+
+  // Every point lands in exactly one node
+  std::string data;
+  MU_CHECK(show::file_read(path, data) == 0);
+  show::pcloud_header_t header;
+  memcpy(&header, data.data(), sizeof(header));
+  MU_CHECK(memcmp(header.magic, "SHOWPCO1", 8) == 0);
+  MU_CHECK(header.nb_points == batch_size * 3);
+  const size_t nodes_size = header.nb_nodes * sizeof(show::pcloud_node_t);
+  MU_CHECK(header.nodes_offset + nodes_size == data.size());
+  std::vector<show::pcloud_node_t> nodes(header.nb_nodes);
+  memcpy(nodes.data(),
+         data.data() + header.nodes_offset,
+         nodes.size() * sizeof(show::pcloud_node_t));
+  uint64_t nb_points = 0;
+  for (const auto &node : nodes) {
+    nb_points += node.nb_points;
+  }
+  MU_CHECK(nb_points == header.nb_points);
+  MU_CHECK(nodes.size() > 9);
+
+  // Temporary files are gone
+  MU_CHECK(access((path + ".spool").c_str(), F_OK) != 0);
+  for (int b = 0; b < 8; b++) {
+    const std::string bucket = path + ".bucket" + std::to_string(b);
+    MU_CHECK(access(bucket.c_str(), F_OK) != 0);
+  }
+  remove(path.c_str());
+
+  return 0;
+}
+
+int test_dds_save_load() {
+  // 10x6 BC1 texture with a full mip chain, 10x6, 5x3, 2x1, 1x1
+  show::gltexture_compressed_t src;
+  src.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  src.width = 10;
+  src.height = 6;
+  int width = src.width;
+  int height = src.height;
+  for (int i = 0; i < 4; i++) {
+    const size_t size = show::texture_level_size(src.format, width, height);
+    src.level_offsets.push_back(src.data.size());
+    src.level_sizes.push_back(size);
+    for (size_t j = 0; j < size; j++) {
+      src.data.push_back((i * 31 + j) & 0xFF);
+    }
+    width = std::max(width / 2, 1);
+    height = std::max(height / 2, 1);
+  }
+  MU_CHECK(src.level_sizes[0] == 3 * 2 * 8);
+  MU_CHECK(src.level_sizes[3] == 8);
+
+  const char *dds_path = "/tmp/test_texture.dds";
+  show::gltexture_compressed_t dst;
+  MU_CHECK(show::dds_save(dds_path, src) == 0);
+  MU_CHECK(show::dds_load(dds_path, dst) == 0);
+  remove(dds_path);
+
+  MU_CHECK(dst.format == src.format);
+  MU_CHECK(dst.width == src.width);
+  MU_CHECK(dst.height == src.height);
+  MU_CHECK(dst.level_sizes == src.level_sizes);
+  MU_CHECK(dst.level_offsets == src.level_offsets);
+  MU_CHECK(dst.data == src.data);
+
+  // BC7 goes through the DX10 header
+  src.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+  src.width = 4;
+  src.height = 4;
+  src.level_offsets = {0};
+  src.level_sizes = {16};
+  src.data.resize(16);
+  MU_CHECK(show::dds_save(dds_path, src) == 0);
+  MU_CHECK(show::dds_load(dds_path, dst) == 0);
+  remove(dds_path);
+  MU_CHECK(dst.format == GL_COMPRESSED_RGBA_BPTC_UNORM);
+  MU_CHECK(dst.data == src.data);
+
+  // Mip count past 1x1 is clamped, 4x4 -> 2x2 -> 1x1
+  src.level_offsets.assign(20, 0);
+  src.level_sizes.assign(20, 16);
+  src.data.resize(20 * 16);
+  MU_CHECK(show::dds_save(dds_path, src) == 0);
+  MU_CHECK(show::dds_load(dds_path, dst) == 0);
+  MU_CHECK(dst.level_sizes.size() == 3);
+  MU_CHECK(dst.data.size() == 3 * 16);
+
+  // Levels missing from the file
+  src.level_offsets = {0};
+  src.level_sizes = {16};
+  src.data.resize(8);
+  MU_CHECK(show::dds_save(dds_path, src) == 0);
+  MU_CHECK(show::dds_load(dds_path, dst) == -1);
+  remove(dds_path);
+
+  MU_CHECK(show::texture_compressed_path("a/b.png") == "a/b.png.dds");
+  MU_CHECK(show::texture_compressed_path("a/b.jpg") == "a/b.jpg.dds");
+  MU_CHECK(show::texture_compressed_path("a.b/c") == "a.b/c.dds");
+  MU_CHECK(show::texture_compressed_path("a/b.dds") == "a/b.dds");
+
+  // Sibling only used while not older than its source
+  const char *src_path = "/tmp/test_sibling.png";
+  const char *sibling_path = "/tmp/test_sibling.png.dds";
+  MU_CHECK(show::texture_compressed_sibling(src_path) == "");
+  FILE *fp = fopen(src_path, "wb");
+  MU_CHECK(fp != NULL);
+  fclose(fp);
+  MU_CHECK(show::dds_save(sibling_path, src) == 0);
+  MU_CHECK(show::texture_compressed_sibling(src_path) == sibling_path);
+  struct timeval times[2] = {{1000, 0}, {1000, 0}};
+  MU_CHECK(utimes(sibling_path, times) == 0);
+  MU_CHECK(show::texture_compressed_sibling(src_path) == "");
+  remove(src_path);
+  remove(sibling_path);
+
+  return 0;
+}
+
+int test_texture_mip_chain_size() {
+  // 4x2 -> 2x1 -> 1x1
+  MU_CHECK(show::texture_mip_chain_size(4, 2, 4) == (8 + 2 + 1) * 4);
+  MU_CHECK(show::texture_mip_chain_size(1, 1, 3) == 3);
+
+  // Square power of two chains converge on 4/3 of the top level
+  const size_t top = 1024 * 1024 * 4;
+  const size_t chain = show::texture_mip_chain_size(1024, 1024, 4);
+  MU_CHECK(chain > top);
+  MU_CHECK(chain < top * 4 / 3 + 4);
+
+  return 0;
+}
+
+int test_gui_imshow_frames() {
+  show::gui_imshow_frames_t frames;
+  MU_CHECK(frames.consume() == false);
+
+  // Latest wins, the skipped frame counts as dropped
+  for (int i = 1; i <= 2; i++) {
+    frames.write_frame().data.assign(4, i);
+    frames.publish();
+  }
+  MU_CHECK(frames.consume());
+  MU_CHECK(frames.read_frame().seq == 2);
+  MU_CHECK(frames.read_frame().data[0] == 2);
+  MU_CHECK(frames.consume() == false);
+  MU_CHECK(frames.nb_dropped == 1);
+
+  // Producer thread, frames arrive in order and intact
+  const uint64_t nb_frames = 100000;
+  std::thread producer([&]() {
+    for (uint64_t i = 0; i < nb_frames; i++) {
+      // Sequence numbers continue from 3
+      frames.write_frame().data.assign(64, (uint8_t) (i + 3));
+      frames.publish();
+    }
+  });
+
+  bool ok = true;
+  uint64_t last = 2;
+  while (last < nb_frames + 2) {
+    if (frames.consume() == false) {
+      continue;
+    }
+    const show::gui_imshow_frame_t &frame = frames.read_frame();
+    ok = ok && frame.seq > last;
+    for (const auto v : frame.data) {
+      ok = ok && v == (uint8_t) frame.seq;
+    }
+    last = frame.seq;
+  }
+  producer.join();
+  MU_CHECK(ok);
+  MU_CHECK(frames.nb_published == nb_frames + 2);
+  MU_CHECK(frames.nb_consumed + frames.nb_dropped == nb_frames + 2);
+
+  return 0;
+}
+
+// RGBA pixels of an imshow window's converted image
+static std::vector<uint8_t> imshow_readback(const show::gui_imshow_t &imshow) {
+  std::vector<uint8_t> rgba(imshow.img_width_ * imshow.img_height_ * 4);
+  glBindTexture(GL_TEXTURE_2D, imshow.img_id_);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return rgba;
+}
+
+int test_gui_imshow_convert() {
+  show::gui_t gui{"Show"};
+  const int w = 8;
+  const int h = 8;
+
+  // Caller state survives the conversion
+  GLuint VAO;
+  glGenVertexArrays(1, &VAO);
+  glBindVertexArray(VAO);
+  glUseProgram(0);
+
+  // NV12 red, BT.601 limited range
+  std::vector<uint8_t> nv12(w * h * 3 / 2);
+  memset(nv12.data(), 81, w * h);
+  for (size_t i = w * h; i < nv12.size(); i += 2) {
+    nv12[i + 0] = 90;
+    nv12[i + 1] = 240;
+  }
+  show::gui_imshow_t yuv{"NV12", w, h, show::IMSHOW_NV12, nv12.data()};
+  GLint program = -1;
+  GLint bound_VAO = 0;
+  GLint FBO = -1;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bound_VAO);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &FBO);
+  MU_CHECK(program == 0);
+  MU_CHECK(bound_VAO == (GLint) VAO);
+  MU_CHECK(FBO == 0);
+
+  std::vector<uint8_t> rgba = imshow_readback(yuv);
+  for (int i = 0; i < w * h; i++) {
+    MU_CHECK(rgba[i * 4 + 0] >= 252);
+    MU_CHECK(rgba[i * 4 + 1] <= 3);
+    MU_CHECK(rgba[i * 4 + 2] <= 3);
+    MU_CHECK(rgba[i * 4 + 3] == 255);
+  }
+
+  // RGGB mosaic of constant R, G and B sites, inner pixels see all three
+  std::vector<uint8_t> bayer(w * h);
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      const bool r = (x % 2 == 0 && y % 2 == 0);
+      const bool b = (x % 2 == 1 && y % 2 == 1);
+      bayer[y * w + x] = (r) ? 200 : (b) ? 50 : 100;
+    }
+  }
+  show::gui_imshow_t raw{"Bayer", w, h, show::IMSHOW_BAYER_RGGB, bayer.data()};
+  rgba = imshow_readback(raw);
+  for (int y = 1; y < h - 1; y++) {
+    for (int x = 1; x < w - 1; x++) {
+      const uint8_t *px = &rgba[(y * w + x) * 4];
+      MU_CHECK(abs(px[0] - 200) <= 1);
+      MU_CHECK(abs(px[1] - 100) <= 1);
+      MU_CHECK(abs(px[2] - 50) <= 1);
+    }
+  }
+
+  glBindVertexArray(0);
+  glDeleteVertexArrays(1, &VAO);
+
+  return 0;
+}
+
+int test_gui_imshow_depth_range() {
+  show::gui_t gui{"Show"};
+
+  // Depths from 1000 to 3000 with invalid zeros, 20x10 reduces in two levels
+  const int w = 20;
+  const int h = 10;
+  std::vector<uint16_t> depth(w * h);
+  for (int i = 0; i < w * h; i++) {
+    depth[i] = (i % 7 == 3) ? 0 : 1000 + (i * 37) % 2001;
+  }
+  depth[5] = 1000;
+  depth[w * h - 1] = 3000;
+  const uint8_t *data = (const uint8_t *) depth.data();
+
+  // The range lands a frame after the reduction was queued
+  show::gui_imshow_t imshow{"Depth", w, h, show::IMSHOW_DEPTH16, data};
+  imshow.colormap_ = show::COLORMAP_GRAY;
+  glFinish();
+  imshow.update((void *) data);
+  MU_CHECK(fabs(imshow.range_min_ - 1000.0f) < 0.5f);
+  MU_CHECK(fabs(imshow.range_max_ - 3000.0f) < 0.5f);
+
+  // Range ends map to black and white, invalid depths to black
+  const std::vector<uint8_t> rgba = imshow_readback(imshow);
+  MU_CHECK(rgba[5 * 4] <= 1);
+  MU_CHECK(rgba[(w * h - 1) * 4] >= 254);
+  MU_CHECK(rgba[3 * 4] == 0 && rgba[3 * 4 + 3] == 255);
+
+  return 0;
+}
+
+int test_gui_imshow_frame_size() {
+  const auto frame_size = show::gui_imshow_frame_size;
+  const size_t w = 640;
+  const size_t h = 480;
+  MU_CHECK(frame_size(show::IMSHOW_DIRECT, w, h, 3) == w * h * 3);
+  MU_CHECK(frame_size(show::IMSHOW_YUYV, w, h, 0) == w * h * 2);
+  MU_CHECK(frame_size(show::IMSHOW_NV12, w, h, 0) == w * h * 3 / 2);
+  MU_CHECK(frame_size(show::IMSHOW_I420, w, h, 0) == w * h * 3 / 2);
+  MU_CHECK(frame_size(show::IMSHOW_BAYER_RGGB, w, h, 0) == w * h);
+  MU_CHECK(frame_size(show::IMSHOW_DEPTH16, w, h, 0) == w * h * 2);
+  MU_CHECK(frame_size(show::IMSHOW_FLOAT32, w, h, 0) == w * h * 4);
+
+  // Odd sizes round chroma up
+  MU_CHECK(frame_size(show::IMSHOW_I420, 3, 3, 0) == 9 + 2 * 4);
+  MU_CHECK(frame_size(show::IMSHOW_YUYV, 3, 1, 0) == 8);
+
+  return 0;
+}
+
+int test_shm_ring() {
+  const int size = 8 * 8;
+  show::shm_producer_t producer{"test_show_shm", 8, 8, 1, 0, size, 4};
+  MU_CHECK(producer.ok());
+
+  show::shm_consumer_t consumer;
+  show::shm_frame_t frame;
+  MU_CHECK(consumer.open("test_show_shm") == 0);
+  MU_CHECK(consumer.header_->width == 8);
+  MU_CHECK(consumer.poll(frame) == false);
+  MU_CHECK(consumer.wait(1) == false);
+
+  // Frames are read in place
+  std::vector<uint8_t> pixels(size, 7);
+  producer.write(pixels.data());
+  MU_CHECK(consumer.wait(1));
+  MU_CHECK(consumer.poll(frame));
+  MU_CHECK(frame.seq == 1);
+  MU_CHECK(memcmp(frame.data, pixels.data(), size) == 0);
+  MU_CHECK(consumer.valid(frame));
+  MU_CHECK(consumer.poll(frame) == false);
+
+  // Only the newest frame is returned
+  for (int i = 0; i < 3; i++) {
+    producer.write(pixels.data());
+  }
+  MU_CHECK(consumer.poll(frame));
+  MU_CHECK(frame.seq == 4);
+  MU_CHECK(consumer.nb_skipped_ == 2);
+
+  // Lapped while in use
+  for (int i = 0; i < 4; i++) {
+    producer.write(pixels.data());
+  }
+  MU_CHECK(consumer.valid(frame) == false);
+  MU_CHECK(consumer.nb_torn_ == 1);
+
+  // A frame being written leaves the last complete one readable
+  producer.begin();
+  MU_CHECK(consumer.poll(frame));
+  MU_CHECK(frame.seq == 8);
+  producer.publish();
+  MU_CHECK(consumer.poll(frame));
+  MU_CHECK(frame.seq == 9);
+  MU_CHECK(consumer.restarted() == false);
+
+  return 0;
+}
+
+int test_shm_restart() {
+  // Frame size must match the format
+  show::shm_producer_t bad{"test_show_shm", 8, 8, 1, 0, 8 * 8 * 3, 4};
+  MU_CHECK(bad.ok() == false);
+
+  const int size = 8 * 8;
+  std::vector<uint8_t> pixels(size, 7);
+  show::shm_consumer_t consumer;
+  show::shm_frame_t frame;
+  {
+    show::shm_producer_t producer{"test_show_shm", 8, 8, 1, 0, size, 4};
+    MU_CHECK(producer.ok());
+
+    // Slots too small for the frames in the header, or a frame size not
+    // matching the format
+    producer.header_->slot_stride = size - 1;
+    MU_CHECK(consumer.open("test_show_shm") != 0);
+    producer.header_->slot_stride = 4096;
+    producer.header_->frame_size = size * 3;
+    MU_CHECK(consumer.open("test_show_shm") != 0);
+    producer.header_->frame_size = size;
+    MU_CHECK(consumer.open("test_show_shm") == 0);
+    producer.write(pixels.data());
+    MU_CHECK(consumer.poll(frame));
+  }
+
+  // A new producer under the same name is a new segment, checked at most
+  // once per period
+  show::shm_producer_t producer{"test_show_shm", 8, 8, 1, 0, size, 4};
+  MU_CHECK(consumer.restarted());
+  MU_CHECK(consumer.restarted() == false);
+  MU_CHECK(consumer.open(consumer.name_) == 0);
+  consumer.check_time_ = 0;
+  MU_CHECK(consumer.restarted() == false);
+
+  // Frames come from the new segment
+  producer.write(pixels.data());
+  MU_CHECK(consumer.poll(frame));
+  MU_CHECK(frame.seq == 1);
+
+  return 0;
+}
+
+int test_gloctomap_load() {
+  show::gui_t gui{"Show"};
+
+  // Occupied 32^3 voxel cube spanning 2x2x2 blocks, pruned to a single leaf
+  octomap::OcTree tree{0.1};
+  tree.enableChangeDetection(true);
+  const octomap::OcTreeKey origin = tree.coordToKey({0.0f, 0.0f, 0.0f});
+  for (int x = 0; x < 32; x++) {
+    for (int y = 0; y < 32; y++) {
+      for (int z = 0; z < 32; z++) {
+        const octomap::OcTreeKey key{(octomap::key_type) (origin[0] + x),
+                                     (octomap::key_type) (origin[1] + y),
+                                     (octomap::key_type) (origin[2] + z)};
+        tree.updateNode(key, true);
+      }
+    }
+  }
+  tree.prune();
+  tree.resetChangeDetection();
+
+  auto nb_occupied = [&]() {
+    size_t nb_leaves = 0;
+    for (auto it = tree.begin_leafs(); it != tree.end_leafs(); ++it) {
+      nb_leaves += tree.isNodeOccupied(*it);
+    }
+    return nb_leaves;
+  };
+
+  show::gloctomap_t map{tree};
+  MU_CHECK(nb_occupied() == 1);
+  MU_CHECK(map.cubes_.size() == 1);
+  MU_CHECK(map.blocks_.size() == 0);
+  MU_CHECK(map.coarse_[5].size() == 1);
+
+  // Freeing one voxel splits the leaf, 7 siblings per level down to voxels
+  tree.updateNode(origin, -2.0f);
+  map.update(tree);
+  MU_CHECK(nb_occupied() == 35);
+  MU_CHECK(map.cubes_.size() == 35);
+  MU_CHECK(map.slot_keys_.size() == 35);
+  MU_CHECK(map.coarse_[5].size() == 0);
+  MU_CHECK(map.blocks_.size() == 8);
+
+  return 0;
+}
+
+int test_gltexture_cache_trim() {
+  show::gui_t gui{"Show"};
+
+  // Two copies of one image so that the cache holds two textures
+  std::string image;
+  MU_CHECK(show::file_read("assets/container.jpg", image) == 0);
+  const std::string paths[2] = {"/tmp/test_texture_a.jpg",
+                                "/tmp/test_texture_b.jpg"};
+  for (const auto &path : paths) {
+    FILE *fp = fopen(path.c_str(), "wb");
+    MU_CHECK(fp != NULL);
+    fwrite(image.data(), 1, image.size(), fp);
+    fclose(fp);
+  }
+
+  show::gltexture_cache_t &cache = show::gltexture_cache();
+  const unsigned int a = show::gltexture_acquire(paths[0], false);
+  const unsigned int b = show::gltexture_acquire(paths[1], false);
+  const size_t full = cache.entries[a].bytes;
+  const size_t reloads = cache.reloads;
+  MU_CHECK(cache.entries[b].bytes == full);
+
+  // Room for one full texture, the one not bound this frame is reduced
+  cache.budget = cache.resident_bytes - full / 2;
+  show::gltexture_cache_trim();
+  show::gltexture_bind(a);
+  show::gltexture_cache_trim();
+  MU_CHECK(cache.entries[a].dropped == 0);
+  MU_CHECK(cache.entries[b].dropped == cache.evict_levels);
+  MU_CHECK(cache.entries[b].bytes < full);
+  MU_CHECK(cache.resident_bytes <= cache.budget);
+
+  // No reload while the full texture would not fit
+  show::gltexture_bind(b);
+  MU_CHECK(cache.entries[b].loading == false);
+  MU_CHECK(cache.reloads == reloads);
+
+  // Releasing the other texture makes room
+  show::gltexture_release(a);
+  show::gltexture_bind(b);
+  MU_CHECK(cache.entries[b].loading);
+  MU_CHECK(cache.reloads == reloads + 1);
+  show::gltexture_loader_finish();
+  MU_CHECK(cache.entries[b].dropped == 0);
+  MU_CHECK(cache.entries[b].bytes == full);
+  MU_CHECK(cache.reload_bytes == 0);
+
+  // A failed reload keeps the reduced texture and stops reloading it
+  cache.budget = full / 2;
+  show::gltexture_cache_trim();
+  show::gltexture_cache_trim();
+  const size_t reduced = cache.entries[b].bytes;
+  MU_CHECK(cache.entries[b].dropped == cache.evict_levels);
+  remove(paths[1].c_str());
+  cache.budget = 0;
+  show::gltexture_bind(b);
+  show::gltexture_loader_finish();
+  MU_CHECK(cache.entries[b].failed);
+  MU_CHECK(cache.entries[b].dropped == cache.evict_levels);
+  MU_CHECK(cache.entries[b].bytes == reduced);
+  MU_CHECK(cache.reload_bytes == 0);
+  show::gltexture_bind(b);
+  MU_CHECK(cache.entries[b].loading == false);
+  MU_CHECK(cache.reloads == reloads + 2);
+
+  // Still evicted from its actual size
+  cache.budget = reduced / 2;
+  show::gltexture_cache_trim();
+  show::gltexture_cache_trim();
+  MU_CHECK(cache.entries[b].bytes < reduced);
+
+  show::gltexture_release(b);
+  cache.budget = 0;
+  for (const auto &path : paths) {
+    remove(path.c_str());
+  }
+
+  return 0;
+}
+
 void test_suite() {
   MU_ADD_TEST(test_gui_imshow);
+  MU_ADD_TEST(test_glprog_uniform);
+  MU_ADD_TEST(test_glpoints_regions);
+  MU_ADD_TEST(test_voxmap_mesh);
+  MU_ADD_TEST(test_glvertices_pack);
+  MU_ADD_TEST(test_glmesh_optimize);
+  MU_ADD_TEST(test_glindices_pack);
+  MU_ADD_TEST(test_glarena_add);
+  MU_ADD_TEST(test_thread_pool);
+  MU_ADD_TEST(test_glmodel_bake);
+  MU_ADD_TEST(test_pcloud_build);
+  MU_ADD_TEST(test_dds_save_load);
+  MU_ADD_TEST(test_texture_mip_chain_size);
+  MU_ADD_TEST(test_gltexture_cache_trim);
+  MU_ADD_TEST(test_gui_imshow_frames);
+  MU_ADD_TEST(test_gui_imshow_frame_size);
+  MU_ADD_TEST(test_gui_imshow_convert);
+  MU_ADD_TEST(test_gui_imshow_depth_range);
+  MU_ADD_TEST(test_shm_ring);
+  MU_ADD_TEST(test_shm_restart);
+  MU_ADD_TEST(test_gloctomap_load);
 }
 
 MU_RUN_TESTS(test_suite);